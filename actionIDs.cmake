@@ -6,11 +6,13 @@
 set(MUMBLE_STREAMDECK_TOGGLE_LOCAL_USER_MUTE_ACTION_UUID "info.mumble.mumble.actions.toggle-local-user-mute")
 set(MUMBLE_STREAMDECK_TOGGLE_LOCAL_USER_DEAF_ACTION_UUID "info.mumble.mumble.actions.toggle-local-user-deaf")
 set(MUMBLE_STREAMDECK_JOIN_CHANNEL_ACTION_UUID "info.mumble.mumble.actions.join-channel")
+set(MUMBLE_STREAMDECK_PUSH_TO_TALK_ACTION_UUID "info.mumble.mumble.actions.push-to-talk")
 
 set(MUBMLE_STREAMDECK_ACTION_UUIDS "")
 list(APPEND MUBMLE_STREAMDECK_ACTION_UUIDS "MUMBLE_STREAMDECK_TOGGLE_LOCAL_USER_MUTE_ACTION_UUID")
 list(APPEND MUBMLE_STREAMDECK_ACTION_UUIDS "MUMBLE_STREAMDECK_TOGGLE_LOCAL_USER_DEAF_ACTION_UUID")
 list(APPEND MUBMLE_STREAMDECK_ACTION_UUIDS "MUMBLE_STREAMDECK_JOIN_CHANNEL_ACTION_UUID")
+list(APPEND MUBMLE_STREAMDECK_ACTION_UUIDS "MUMBLE_STREAMDECK_PUSH_TO_TALK_ACTION_UUID")
 
 
 # create include file for CXX code
@@ -0,0 +1,67 @@
+# Copyright 2021 The Mumble Developers. All rights reserved.
+# Use of this source code is governed by a BSD-style license
+# that can be found in the LICENSE file at the root of the
+# source tree.
+
+# Embeds the images the plugin shows on the buttons into a header, so that the plugin never has to read
+# them at runtime. This is run as a build step (see CMakeLists.txt) and expects the following variables:
+#   ACTION_IMAGES_DIR               Directory containing the PNGs of the images
+#   ACTION_IMAGES_SVG_DIR           Directory containing SVG sources (an image with an SVG source is rasterized
+#                                   from it instead of using its PNG, provided RSVG_CONVERT is set)
+#   ACTION_IMAGES_WORK_DIR          Directory for the rasterized images
+#   RSVG_CONVERT                    Path to rsvg-convert (optional)
+#   CXX_ACTION_IMAGES_INCLUDE_FILE  The header to create
+
+set(MUMBLE_STREAMDECK_ACTION_IMAGES "")
+list(APPEND MUMBLE_STREAMDECK_ACTION_IMAGES "muted_icon")
+list(APPEND MUMBLE_STREAMDECK_ACTION_IMAGES "muted_icon_inactive")
+list(APPEND MUMBLE_STREAMDECK_ACTION_IMAGES "deafened_icon")
+list(APPEND MUMBLE_STREAMDECK_ACTION_IMAGES "deafened_icon_inactive")
+list(APPEND MUMBLE_STREAMDECK_ACTION_IMAGES "joinChannel_icon")
+list(APPEND MUMBLE_STREAMDECK_ACTION_IMAGES "joinChannel_icon_active")
+list(APPEND MUMBLE_STREAMDECK_ACTION_IMAGES "pushToTalk_icon")
+
+# The size of a key in pixels (the high DPI variant is twice as large)
+set(MUMBLE_STREAMDECK_KEY_SIZE 72)
+
+
+file(MAKE_DIRECTORY "${ACTION_IMAGES_WORK_DIR}")
+
+# create include file for CXX code
+set(IMAGE_LIST "")
+file(WRITE "${CXX_ACTION_IMAGES_INCLUDE_FILE}" "#ifndef ACTION_IMAGES_H_\n#define ACTION_IMAGES_H_\n")
+foreach(CURRENT_IMAGE IN LISTS MUMBLE_STREAMDECK_ACTION_IMAGES)
+	foreach(CURRENT_SCALE 1 2)
+		if(CURRENT_SCALE EQUAL 1)
+			set(CURRENT_NAME "${CURRENT_IMAGE}")
+		else()
+			set(CURRENT_NAME "${CURRENT_IMAGE}@${CURRENT_SCALE}x")
+		endif()
+
+		set(CURRENT_SOURCE "${ACTION_IMAGES_DIR}/${CURRENT_NAME}.png")
+		if(RSVG_CONVERT AND EXISTS "${ACTION_IMAGES_SVG_DIR}/${CURRENT_IMAGE}.svg")
+			math(EXPR CURRENT_SIZE "${MUMBLE_STREAMDECK_KEY_SIZE} * ${CURRENT_SCALE}")
+			set(CURRENT_SOURCE "${ACTION_IMAGES_WORK_DIR}/${CURRENT_NAME}.png")
+
+			execute_process(
+				COMMAND "${RSVG_CONVERT}" --width ${CURRENT_SIZE} --height ${CURRENT_SIZE} --keep-aspect-ratio
+					--output "${CURRENT_SOURCE}" "${ACTION_IMAGES_SVG_DIR}/${CURRENT_IMAGE}.svg"
+				RESULT_VARIABLE RSVG_RESULT
+			)
+			if(NOT RSVG_RESULT EQUAL 0)
+				message(FATAL_ERROR "Failed to rasterize ${CURRENT_IMAGE}.svg")
+			endif()
+		endif()
+
+		string(MAKE_C_IDENTIFIER "MUMBLE_STREAMDECK_IMAGE_${CURRENT_NAME}" CURRENT_ID)
+
+		file(READ "${CURRENT_SOURCE}" CURRENT_CONTENT HEX)
+		string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," CURRENT_CONTENT "${CURRENT_CONTENT}")
+		file(APPEND "${CXX_ACTION_IMAGES_INCLUDE_FILE}" "constexpr unsigned char ${CURRENT_ID}[] = {${CURRENT_CONTENT}};\n")
+
+		string(APPEND IMAGE_LIST " \\\n\tX(\"${CURRENT_NAME}\", ${CURRENT_ID})")
+	endforeach()
+endforeach()
+# Invokes X(name, content) for every image
+file(APPEND "${CXX_ACTION_IMAGES_INCLUDE_FILE}" "#define MUMBLE_STREAMDECK_ACTION_IMAGES(X)${IMAGE_LIST}\n")
+file(APPEND "${CXX_ACTION_IMAGES_INCLUDE_FILE}" "#endif\n")
@@ -0,0 +1,57 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#include "Benchmark.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+
+namespace {
+	std::atomic< std::size_t > allocations(0);
+} // namespace
+
+// Count all allocations made through the global allocation functions (the array versions forward to these)
+void *operator new(std::size_t size) {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+
+	if (void *ptr = std::malloc(size == 0 ? 1 : size)) {
+		return ptr;
+	}
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+	std::free(ptr);
+}
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+	namespace Benchmark {
+
+		std::size_t allocationCount() { return allocations.load(std::memory_order_relaxed); }
+
+		void printHeader() {
+			std::cout << std::left << std::setw(56) << "Benchmark" << std::right << std::setw(14) << "mean ns/op"
+					  << std::setw(14) << "p50 ns" << std::setw(14) << "p99 ns" << std::setw(12) << "allocs/op"
+					  << std::endl;
+		}
+
+		void print(const std::string &name, const Result &result) {
+			std::cout << std::left << std::setw(56) << name << std::right << std::fixed << std::setprecision(1)
+					  << std::setw(14) << result.meanNs << std::setw(14) << result.p50Ns << std::setw(14)
+					  << result.p99Ns << std::setw(12) << std::setprecision(2) << result.allocationsPerOp << std::endl;
+		}
+
+	}; // namespace Benchmark
+};     // namespace StreamDeckIntegration
+};     // namespace Mumble
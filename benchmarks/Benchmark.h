@@ -0,0 +1,115 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#ifndef MUMBLE_STREAMDECK_INTEGRATION_BENCHMARK_H_
+#define MUMBLE_STREAMDECK_INTEGRATION_BENCHMARK_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+	namespace Benchmark {
+
+		/**
+		 * Prevents the compiler from optimizing away the computation of the given value
+		 */
+		template< typename T > void doNotOptimize(const T &value) {
+#if defined(__GNUC__) || defined(__clang__)
+			asm volatile("" : : "r,m"(value) : "memory");
+#else
+			static volatile const T *sink;
+			sink = &value;
+#endif
+		}
+
+		/**
+		 * @returns The number of heap allocations that have been performed by this process so far
+		 */
+		std::size_t allocationCount();
+
+		struct Result {
+			double meanNs;
+			double p50Ns;
+			double p99Ns;
+			double allocationsPerOp;
+		};
+
+		/**
+		 * Prints the header of the table that the results are printed as
+		 */
+		void printHeader();
+
+		/**
+		 * Prints the given result as a row of the results table
+		 */
+		void print(const std::string &name, const Result &result);
+
+		/**
+		 * Runs the given function the given amount of times and prints the time and the number of
+		 * allocations per call. The percentiles are computed over batches of calls (single calls for
+		 * benchmarks with few iterations), so that the overhead of the clock doesn't dominate them.
+		 *
+		 * @param name The name of the benchmark
+		 * @param iterations How often the function shall be called
+		 * @param func The function to benchmark
+		 * @returns The result of the benchmark
+		 */
+		template< typename Func > Result run(const std::string &name, std::size_t iterations, Func &&func) {
+			constexpr std::size_t maxSamples = 1000;
+
+			// Warm up caches
+			for (std::size_t i = 0; i < iterations / 10 + 1; ++i) {
+				func();
+			}
+
+			const std::size_t batchSize = std::max< std::size_t >(1, iterations / maxSamples);
+			const std::size_t batches   = (iterations + batchSize - 1) / batchSize;
+
+			std::vector< double > samples;
+			samples.reserve(batches);
+
+			const std::size_t allocationsBefore = allocationCount();
+
+			for (std::size_t batch = 0; batch < batches; ++batch) {
+				const auto start = std::chrono::steady_clock::now();
+				for (std::size_t i = 0; i < batchSize; ++i) {
+					func();
+				}
+				const auto end = std::chrono::steady_clock::now();
+
+				samples.push_back(std::chrono::duration< double, std::nano >(end - start).count() / batchSize);
+			}
+
+			const std::size_t allocations = allocationCount() - allocationsBefore;
+			const std::size_t calls       = batches * batchSize;
+
+			Result result;
+
+			double total = 0;
+			for (double sample : samples) {
+				total += sample;
+			}
+			result.meanNs = total / samples.size();
+
+			std::sort(samples.begin(), samples.end());
+			result.p50Ns = samples[samples.size() / 2];
+			result.p99Ns = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+
+			result.allocationsPerOp = static_cast< double >(allocations) / calls;
+
+			print(name, result);
+
+			return result;
+		}
+
+	}; // namespace Benchmark
+};     // namespace StreamDeckIntegration
+};     // namespace Mumble
+
+#endif // MUMBLE_STREAMDECK_INTEGRATION_BENCHMARK_H_
@@ -0,0 +1,49 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#ifndef MUMBLE_STREAMDECK_INTEGRATION_RECORDEDEVENTS_H_
+#define MUMBLE_STREAMDECK_INTEGRATION_RECORDEDEVENTS_H_
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+	namespace RecordedEvents {
+
+		// Events as they have been received from the Stream Deck software (the IDs have been anonymized)
+
+		constexpr const char *keyDown =
+			R"({"action":"info.mumble.mumble.actions.toggle-local-user-mute","event":"keyDown",)"
+			R"("context":"B1F4C1E16C2C4A0DA5C0B3E5A2A7F1D0","device":"7C2D3AE5F63A4E6A9D3B1C8E5F0A2B4C",)"
+			R"("payload":{"settings":{},"coordinates":{"column":0,"row":0},"state":0,"userDesiredState":1,)"
+			R"("isInMultiAction":false}})";
+
+		constexpr const char *keyUp =
+			R"({"action":"info.mumble.mumble.actions.toggle-local-user-mute","event":"keyUp",)"
+			R"("context":"B1F4C1E16C2C4A0DA5C0B3E5A2A7F1D0","device":"7C2D3AE5F63A4E6A9D3B1C8E5F0A2B4C",)"
+			R"("payload":{"settings":{},"coordinates":{"column":0,"row":0},"state":1,"isInMultiAction":false}})";
+
+		constexpr const char *willAppear =
+			R"({"action":"info.mumble.mumble.actions.join-channel","event":"willAppear",)"
+			R"("context":"E93A0C4B2D1F4E8A8B7C6D5E4F3A2B1C","device":"7C2D3AE5F63A4E6A9D3B1C8E5F0A2B4C",)"
+			R"("payload":{"settings":{"channelJoin_channelName":"Lobby","channelJoin_channelPassword":"hunter2"},)"
+			R"("coordinates":{"column":2,"row":1},"state":0,"isInMultiAction":false}})";
+
+		constexpr const char *sendToPlugin =
+			R"({"action":"info.mumble.mumble.actions.join-channel","event":"sendToPlugin",)"
+			R"("context":"E93A0C4B2D1F4E8A8B7C6D5E4F3A2B1C",)"
+			R"("payload":{"settingsDelta":{"channelJoin_channelName":"Games"}}})";
+
+		constexpr const char *deviceDidConnect =
+			R"({"event":"deviceDidConnect","device":"7C2D3AE5F63A4E6A9D3B1C8E5F0A2B4C",)"
+			R"("deviceInfo":{"name":"Stream Deck","type":0,"size":{"columns":5,"rows":3}}})";
+
+		constexpr const char *didReceiveGlobalSettings =
+			R"({"event":"didReceiveGlobalSettings","payload":{"settings":)"
+			R"({"global_cliPath":"C:\\Program Files\\Mumble\\mumble_json_bridge_cli.exe"}}})";
+
+	}; // namespace RecordedEvents
+};     // namespace StreamDeckIntegration
+};     // namespace Mumble
+
+#endif // MUMBLE_STREAMDECK_INTEGRATION_RECORDEDEVENTS_H_
@@ -0,0 +1,475 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#include "Base64.h"
+#include "Benchmark.h"
+#include "BridgeCLI.h"
+#include "BridgeClient.h"
+#include "CLIPathCache.h"
+#include "ConnectionManager.h"
+#include "ESDSDKDefines.h"
+#include "EncodedImage.h"
+#include "FrameScheduler.h"
+#include "ImageCache.h"
+#include "InFlightTable.h"
+#include "InboundMessage.h"
+#include "KeyRenderer.h"
+#include "MessageWriter.h"
+#include "MumbleActionIDs.h"
+#include "MumblePlugin.h"
+#include "MumbleSettingIDs.h"
+#include "OutboundQueue.h"
+#include "PNGEncoder.h"
+#include "RecordedEvents.h"
+#include "StreamDeckPlugin.h"
+#include "Utils.h"
+
+#include <boost/asio/io_service.hpp>
+#include <boost/process/environment.hpp>
+#include <boost/process/search_path.hpp>
+
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace Mumble::StreamDeckIntegration;
+
+namespace {
+	/**
+	 * A plugin that doesn't do anything, so that only the ConnectionManager's part of processing an
+	 * event is measured
+	 */
+	class NullPlugin : public StreamDeckPlugin {
+	public:
+		void keyDownForAction(ActionHandle, ContextHandle, const LazyJSON &, DeviceHandle) override {}
+		void keyUpForAction(ActionHandle, ContextHandle, const LazyJSON &, DeviceHandle) override {}
+		void willAppearForAction(ActionHandle, ContextHandle, const LazyJSON &payload, DeviceHandle) override {
+			// Every real plugin needs the settings of an appearing button
+			Benchmark::doNotOptimize(payload.get());
+		}
+		void willDisappearForAction(ActionHandle, ContextHandle, const LazyJSON &, DeviceHandle) override {}
+		void didReceiveSettings(ActionHandle, ContextHandle, const LazyJSON &payload, DeviceHandle) override {
+			Benchmark::doNotOptimize(payload.get());
+		}
+		void propertyInspectorDidDisappear(ActionHandle, ContextHandle, DeviceHandle) override {}
+		void deviceDidConnect(DeviceHandle, const LazyJSON &) override {}
+		void deviceDidDisconnect(DeviceHandle) override {}
+		void sendToPlugin(ActionHandle, ContextHandle, const LazyJSON &, DeviceHandle) override {}
+		void receivedGlobalSettings(const nlohmann::json &settings) override { Benchmark::doNotOptimize(settings); }
+		void receivedData(const nlohmann::json &data, ContextHandle) override { Benchmark::doNotOptimize(data); }
+		void systemDidWakeUp() override {}
+		void didReconnect() override {}
+	};
+
+	/// What the executable prints when it is used as a stand-in for the bridge's CLI
+	constexpr const char *stubCLIResponse = R"({"response_type":"operation_result","response":{}})";
+
+	void benchmarkCLIResolution(const boost::filesystem::path &executable) {
+		// Make sure the executable we are looking for is located in the last PATH entry, which is the
+		// worst case for a PATH scan.
+		boost::process::native_environment env = boost::this_process::environment();
+		env["PATH"] += executable.parent_path().string();
+
+		const std::string name = executable.filename().string();
+
+		Benchmark::run("CLI resolution: PATH scan per press", 10000,
+					   [&]() { Benchmark::doNotOptimize(boost::process::search_path(name)); });
+
+		CLIPathCache cache(name);
+		Benchmark::run("CLI resolution: cached", 10000000, [&]() { Benchmark::doNotOptimize(cache.get()); });
+	}
+
+	void benchmarkMessageSerialization() {
+		const std::string context = "2F1B8A6C3D7E4F5A9B0C1D2E3F4A5B6C";
+		const std::string device  = "7C2D3AE5F63A4E6A9D3B1C8E5F0A2B4C";
+		const std::string uuid    = "A1B2C3D4E5F60718293A4B5C6D7E8F90";
+		const std::string action  = MUMBLE_STREAMDECK_JOIN_CHANNEL_ACTION_UUID;
+		const std::string title   = "Channel \"Lobby\"\n12 users";
+		const std::string message = "Successfully executed action info.mumble.mumble.actions.toggle-local-user-mute";
+		// Roughly the size of a 144x144 key image
+		const std::string image(12 * 1024, 'A');
+		const nlohmann::json settings = { { MUMBLE_STREAMDECK_CHANNEL_JOIN_ACTION_CHANNEL_NAME_SETTING, "Lobby" },
+										  { MUMBLE_STREAMDECK_CHANNEL_JOIN_ACTION_CHANNEL_PASSWORD_SETTING, "" } };
+
+		// The way messages were assembled before there was a MessageWriter
+		Benchmark::run("setTitle: JSON DOM + dump", 200000, [&]() {
+			nlohmann::json jsonObject;
+			jsonObject[kESDSDKCommonEvent]   = kESDSDKEventSetTitle;
+			jsonObject[kESDSDKCommonContext] = context;
+
+			nlohmann::json payload;
+			payload[kESDSDKPayloadTarget]    = kESDSDKTarget_HardwareAndSoftware;
+			payload[kESDSDKPayloadTitle]     = title;
+			jsonObject[kESDSDKCommonPayload] = payload;
+
+			Benchmark::doNotOptimize(jsonObject.dump());
+		});
+		Benchmark::run("setImage: JSON DOM + dump", 20000, [&]() {
+			nlohmann::json jsonObject;
+			jsonObject[kESDSDKCommonEvent]   = kESDSDKEventSetImage;
+			jsonObject[kESDSDKCommonContext] = context;
+
+			nlohmann::json payload;
+			payload[kESDSDKPayloadTarget]    = kESDSDKTarget_HardwareAndSoftware;
+			payload[kESDSDKPayloadImage]     = "data:image/png;base64," + image;
+			jsonObject[kESDSDKCommonPayload] = payload;
+
+			Benchmark::doNotOptimize(jsonObject.dump());
+		});
+		Benchmark::run("setState: JSON DOM + dump", 200000, [&]() {
+			nlohmann::json jsonObject;
+
+			nlohmann::json payload;
+			payload[kESDSDKPayloadState] = 1;
+
+			jsonObject[kESDSDKCommonEvent]   = kESDSDKEventSetState;
+			jsonObject[kESDSDKCommonContext] = context;
+			jsonObject[kESDSDKCommonPayload] = payload;
+
+			Benchmark::doNotOptimize(jsonObject.dump());
+		});
+		Benchmark::run("logMessage: JSON DOM + dump", 200000, [&]() {
+			nlohmann::json jsonObject;
+			jsonObject[kESDSDKCommonEvent] = kESDSDKEventLogMessage;
+
+			nlohmann::json payload;
+			payload[kESDSDKPayloadMessage]   = message;
+			jsonObject[kESDSDKCommonPayload] = payload;
+
+			Benchmark::doNotOptimize(jsonObject.dump());
+		});
+
+		// What the api_* functions use nowadays
+		MessageWriter writer;
+		Benchmark::run("registerPlugin: MessageWriter", 2000000,
+					   [&]() { Benchmark::doNotOptimize(writer.registerPlugin("registerPlugin", uuid)); });
+		Benchmark::run("setTitle: MessageWriter", 2000000, [&]() {
+			Benchmark::doNotOptimize(writer.setTitle(title, context, kESDSDKTarget_HardwareAndSoftware));
+		});
+		Benchmark::run("setImage: MessageWriter", 200000, [&]() {
+			Benchmark::doNotOptimize(writer.setImage(image, context, kESDSDKTarget_HardwareAndSoftware));
+		});
+		Benchmark::run("showAlert: MessageWriter", 2000000,
+					   [&]() { Benchmark::doNotOptimize(writer.showAlert(context)); });
+		Benchmark::run("showOK: MessageWriter", 2000000, [&]() { Benchmark::doNotOptimize(writer.showOK(context)); });
+		Benchmark::run("setSettings: MessageWriter", 200000,
+					   [&]() { Benchmark::doNotOptimize(writer.setSettings(settings, context)); });
+		Benchmark::run("getGlobalSettings: MessageWriter", 2000000,
+					   [&]() { Benchmark::doNotOptimize(writer.getGlobalSettings(uuid)); });
+		Benchmark::run("setState: MessageWriter", 2000000,
+					   [&]() { Benchmark::doNotOptimize(writer.setState(1, context)); });
+		Benchmark::run("sendToPropertyInspector: MessageWriter", 200000, [&]() {
+			Benchmark::doNotOptimize(writer.sendToPropertyInspector(action, context, settings));
+		});
+		Benchmark::run("switchToProfile: MessageWriter", 2000000,
+					   [&]() { Benchmark::doNotOptimize(writer.switchToProfile(uuid, device, "Mumble")); });
+		Benchmark::run("logMessage: MessageWriter", 2000000,
+					   [&]() { Benchmark::doNotOptimize(writer.logMessage(message)); });
+	}
+
+	/**
+	 * @param needsPayload Whether the event's handler looks at the payload
+	 */
+	void benchmarkInboundEvent(const std::string &name, const std::string &message, bool needsPayload) {
+		// The way events were processed before there was an InboundMessage
+		Benchmark::run(name + ": JSON DOM", 200000, [&]() {
+			std::string copy = message;
+
+			nlohmann::json receivedJson = nlohmann::json::parse(copy);
+
+			std::string event      = Utils::getStringByName(receivedJson, kESDSDKCommonEvent);
+			std::string context    = Utils::getStringByName(receivedJson, kESDSDKCommonContext);
+			std::string action     = Utils::getStringByName(receivedJson, kESDSDKCommonAction);
+			std::string deviceID   = Utils::getStringByName(receivedJson, kESDSDKCommonDevice);
+			nlohmann::json payload = Utils::getObjectByName(receivedJson, kESDSDKCommonPayload);
+
+			Benchmark::doNotOptimize(event);
+			Benchmark::doNotOptimize(context);
+			Benchmark::doNotOptimize(action);
+			Benchmark::doNotOptimize(deviceID);
+			Benchmark::doNotOptimize(payload);
+		});
+
+		Benchmark::run(name + ": on demand", 2000000, [&]() {
+			const InboundMessage inbound(message);
+
+			Benchmark::doNotOptimize(inbound.event());
+			Benchmark::doNotOptimize(inbound.context());
+			Benchmark::doNotOptimize(inbound.action());
+			Benchmark::doNotOptimize(inbound.device());
+
+			if (needsPayload) {
+				Benchmark::doNotOptimize(inbound.payload().get());
+			}
+		});
+	}
+
+	void benchmarkInboundParsing() {
+		benchmarkInboundEvent("keyDown", RecordedEvents::keyDown, false);
+		benchmarkInboundEvent("keyUp", RecordedEvents::keyUp, false);
+		benchmarkInboundEvent("willAppear", RecordedEvents::willAppear, true);
+		benchmarkInboundEvent("sendToPlugin", RecordedEvents::sendToPlugin, true);
+		benchmarkInboundEvent("deviceDidConnect", RecordedEvents::deviceDidConnect, false);
+		benchmarkInboundEvent("didReceiveGlobalSettings", RecordedEvents::didReceiveGlobalSettings, true);
+	}
+
+	void benchmarkDispatch() {
+		NullPlugin plugin;
+		ConnectionManager connectionManager(0, "A1B2C3D4E5F60718293A4B5C6D7E8F90", "registerPlugin", "{}", plugin);
+
+		const std::pair< const char *, const char * > events[] = {
+			{ "keyDown", RecordedEvents::keyDown },
+			{ "keyUp", RecordedEvents::keyUp },
+			{ "willAppear", RecordedEvents::willAppear },
+			{ "sendToPlugin", RecordedEvents::sendToPlugin },
+			{ "deviceDidConnect", RecordedEvents::deviceDidConnect },
+			{ "didReceiveGlobalSettings", RecordedEvents::didReceiveGlobalSettings },
+		};
+
+		for (const auto &current : events) {
+			const std::string message = current.second;
+
+			Benchmark::run(std::string("onMessage parse + dispatch: ") + current.first, 1000000,
+						   [&]() { connectionManager.dispatch(message); });
+		}
+	}
+
+	void benchmarkActionCompilation() {
+		const nlohmann::json noSettings;
+		const nlohmann::json joinSettings = {
+			{ MUMBLE_STREAMDECK_CHANNEL_JOIN_ACTION_CHANNEL_NAME_SETTING, "Lobby" },
+			{ MUMBLE_STREAMDECK_CHANNEL_JOIN_ACTION_CHANNEL_PASSWORD_SETTING, "hunter2" }
+		};
+
+		Benchmark::run("getJSONForAction: toggle mute", 200000, [&]() {
+			Benchmark::doNotOptimize(
+				MumblePlugin::getJSONForAction(MUMBLE_STREAMDECK_TOGGLE_LOCAL_USER_MUTE_ACTION_UUID, noSettings));
+		});
+		Benchmark::run("getJSONForAction: toggle deaf", 200000, [&]() {
+			Benchmark::doNotOptimize(
+				MumblePlugin::getJSONForAction(MUMBLE_STREAMDECK_TOGGLE_LOCAL_USER_DEAF_ACTION_UUID, noSettings));
+		});
+		Benchmark::run("getJSONForAction: join channel", 200000, [&]() {
+			Benchmark::doNotOptimize(
+				MumblePlugin::getJSONForAction(MUMBLE_STREAMDECK_JOIN_CHANNEL_ACTION_UUID, joinSettings));
+		});
+		Benchmark::run("getJSONForAction + dump: join channel", 200000, [&]() {
+			Benchmark::doNotOptimize(
+				MumblePlugin::getJSONForAction(MUMBLE_STREAMDECK_JOIN_CHANNEL_ACTION_UUID, joinSettings).dump());
+		});
+	}
+
+	void benchmarkAccessors() {
+		const nlohmann::json event = nlohmann::json::parse(RecordedEvents::willAppear);
+
+		Benchmark::run("Utils::getStringByName", 2000000,
+					   [&]() { Benchmark::doNotOptimize(Utils::getStringByName(event, kESDSDKCommonContext)); });
+		Benchmark::run("Utils::getObjectByName", 2000000,
+					   [&]() { Benchmark::doNotOptimize(Utils::getObjectByName(event, kESDSDKCommonPayload)); });
+
+		const nlohmann::json &payload = Utils::getObjectByName(event, kESDSDKCommonPayload);
+		Benchmark::run("Utils::getIntByName", 2000000,
+					   [&]() { Benchmark::doNotOptimize(Utils::getIntByName(payload, kESDSDKPayloadState)); });
+		Benchmark::run("Utils::getBoolByName", 2000000,
+					   [&]() { Benchmark::doNotOptimize(Utils::getBoolByName(payload, "isInMultiAction")); });
+	}
+
+	void benchmarkKeyMashing() {
+		InFlightTable table;
+		const auto toggle = std::make_shared< const std::string >(
+			MumblePlugin::getJSONForAction(MUMBLE_STREAMDECK_TOGGLE_LOCAL_USER_MUTE_ACTION_UUID, {}).dump());
+
+		ContextHandle context;
+		context.value = 1;
+
+		// Five presses per request that is running: only the net effect of the last four is executed afterwards
+		std::size_t presses = 0;
+		std::size_t started = 0;
+		Benchmark::run("InFlightTable: 5 toggle presses + finish", 1000000, [&]() {
+			for (int i = 0; i < 5; ++i) {
+				presses++;
+				if (table.press(context, InFlightTable::Kind::Toggle, toggle) == InFlightTable::PressResult::Start) {
+					started++;
+				}
+			}
+			while (InFlightTable::Request next = table.finish(context)) {
+				started++;
+				Benchmark::doNotOptimize(next);
+			}
+		});
+
+		std::cout << "  -> " << started << " requests for " << presses << " presses" << std::endl;
+	}
+
+	void benchmarkImageCache() {
+		// Roughly the size of a 144x144 key image
+		const std::string png(9 * 1024, '\x89');
+
+		ImageCache cache;
+		const EncodedImage &image = cache.add("icon", png);
+
+		ContextHandle context;
+		context.value = 1;
+
+		const OutboundQueue::Value cached = { kESDSDKTarget_HardwareAndSoftware, 0, {}, image.dataURI, image.hash };
+
+		// The button displays the image already -> every further update has to be recognized as unchanged
+		OutboundQueue byText;
+		OutboundQueue byHash;
+		byText.push(context, OutboundQueue::Kind::Image, { kESDSDKTarget_HardwareAndSoftware, 0, *image.dataURI });
+		byHash.push(context, OutboundQueue::Kind::Image, cached);
+		byText.flush([](ContextHandle, OutboundQueue::Kind, const OutboundQueue::Value &) {});
+		byHash.flush([](ContextHandle, OutboundQueue::Kind, const OutboundQueue::Value &) {});
+
+		Benchmark::run("setImage: unchanged image, compared in full", 200000, [&]() {
+			Benchmark::doNotOptimize(byText.push(context, OutboundQueue::Kind::Image,
+												 { kESDSDKTarget_HardwareAndSoftware, 0, *image.dataURI }));
+		});
+		Benchmark::run("setImage: unchanged cached image, compared by hash", 2000000,
+					   [&]() { Benchmark::doNotOptimize(byHash.push(context, OutboundQueue::Kind::Image, cached)); });
+	}
+
+	void benchmarkKeyRendering() {
+		const std::pair< const char *, PNGEncoder::Compression > compressions[] = {
+			{ "stored", PNGEncoder::Compression::Stored },
+			{ "run-length", PNGEncoder::Compression::RunLength },
+		};
+
+		// Roughly the size of a 144x144 key image
+		const std::string png(9 * 1024, '\x89');
+		Benchmark::run("Base64: encode 9 KB", 20000, [&]() { Benchmark::doNotOptimize(Base64::encode(png)); });
+
+		for (unsigned int size : { KeyRenderer::keySize, 2 * KeyRenderer::keySize }) {
+			for (const auto &compression : compressions) {
+				KeyRenderer renderer(size, compression.second);
+				const Color background  = { 30, 30, 40, 255 };
+				const Color highlight   = { 40, 200, 90, 255 };
+				const Color badge       = { 230, 40, 40, 255 };
+				const Color text        = { 255, 255, 255, 255 };
+				std::size_t frame       = 0;
+				std::size_t encodedSize = 0;
+
+				// Every frame shows a different number, so that none of them can be skipped as unchanged
+				const Benchmark::Result result = Benchmark::run(
+					"KeyRenderer: " + std::to_string(size) + "px badge frame, " + compression.first, 2000, [&]() {
+						renderer.canvas().clear(background);
+						renderer.drawBorder(3, highlight);
+						renderer.drawBadge(std::to_string(frame++ % 1000), badge, text);
+
+						encodedSize = renderer.finish().dataURI->size();
+					});
+
+				std::cout << "  -> " << static_cast< std::size_t >(1e9 / result.meanNs)
+						  << " frames per second per key on one core (" << encodedSize << " bytes per setImage)"
+						  << std::endl;
+			}
+		}
+	}
+
+	void benchmarkAnimation() {
+		KeyRenderer renderer(2 * KeyRenderer::keySize);
+		renderer.canvas().clear({ 40, 200, 90, 255 });
+		renderer.drawBadge("42", { 230, 40, 40, 255 }, { 255, 255, 255, 255 });
+		const EncodedImage &image = renderer.finish();
+
+		MessageWriter writer;
+		const std::string context = "8C2A4A5E4F9B4D9A8E2D3B1C0F6A7E91";
+		const FrameScheduler::Frame prepared =
+			std::make_shared< const std::string >(writer.setImage(*image.dataURI, context, kESDSDKTarget_HardwareOnly));
+
+		Benchmark::run("animation frame: serialize setImage per frame", 200000, [&]() {
+			Benchmark::doNotOptimize(writer.setImage(*image.dataURI, context, kESDSDKTarget_HardwareOnly));
+		});
+		Benchmark::run("animation frame: pre-serialized", 2000000, [&]() {
+			FrameScheduler::Frame frame = prepared;
+			Benchmark::doNotOptimize(frame);
+		});
+
+		// A full Stream Deck XL with every button animated at 10 frames per second (8 times the budget)
+		const FrameScheduler::Budget budget = { 40, 256 * 1024 };
+		const std::chrono::seconds duration(2);
+
+		boost::asio::io_service ioService;
+		std::size_t sentBytes = 0;
+		FrameScheduler scheduler(ioService, budget, [&](ContextHandle, const FrameScheduler::Frame &frame) {
+			sentBytes += frame->size();
+			return true;
+		});
+
+		for (unsigned int i = 0; i < 32; ++i) {
+			ContextHandle handle;
+			handle.value = i;
+
+			// Every frame is a different object, so that none of them is skipped as unchanged
+			std::vector< FrameScheduler::Frame > frames;
+			for (int j = 0; j < 8; ++j) {
+				frames.push_back(std::make_shared< const std::string >(*prepared));
+			}
+			scheduler.start(handle, std::move(frames), std::chrono::milliseconds(100));
+		}
+
+		const std::clock_t cpuStart = std::clock();
+		ioService.run_for(duration);
+		const double cpuSeconds = static_cast< double >(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+
+		std::cout << "FrameScheduler: 32 buttons at 10 fps, budget " << budget.framesPerSecond << " fps / "
+				  << budget.bytesPerSecond / 1024 << " KiB/s" << std::endl;
+		std::cout << "  -> " << scheduler.sentCount() / duration.count() << " frames/s ("
+				  << sentBytes / 1024 / duration.count() << " KiB/s), " << scheduler.postponedCount()
+				  << " postponements, " << cpuSeconds * 1000.0 / duration.count() << " ms CPU per second"
+				  << std::endl;
+	}
+
+	void benchmarkActionExecution(const boost::filesystem::path &executable) {
+		// This executable acts as the CLI (see main())
+		CLIPathCache cache(executable.filename().string());
+		cache.setOverride(executable);
+
+		BridgeCLI cli(cache);
+		const std::string request =
+			MumblePlugin::getJSONForAction(MUMBLE_STREAMDECK_TOGGLE_LOCAL_USER_MUTE_ACTION_UUID, {}).dump();
+
+		Benchmark::run("executeAction: stub CLI", 200, [&]() { Benchmark::doNotOptimize(cli.execute(request)); });
+
+		// This is what happens for every press if the bridge doesn't support direct connections
+		BridgeClient bridge((boost::filesystem::temp_directory_path() / "mumble-streamdeck-bench-no-bridge").string());
+		Benchmark::run("executeAction: bridge unreachable + stub CLI", 200, [&]() {
+			try {
+				Benchmark::doNotOptimize(bridge.execute(request));
+			} catch (const BridgeException &) {
+				Benchmark::doNotOptimize(cli.execute(request));
+			}
+		});
+	}
+} // namespace
+
+int main(int argc, const char **argv) {
+	if (argc == 3 && std::string(argv[1]) == "--json") {
+		// We are being used as a stand-in for the bridge's CLI
+		std::cout << stubCLIResponse << std::endl;
+
+		return 0;
+	}
+
+	const boost::filesystem::path executable = boost::filesystem::absolute(argv[0]);
+
+	Benchmark::printHeader();
+
+	benchmarkCLIResolution(executable);
+	benchmarkMessageSerialization();
+	benchmarkInboundParsing();
+	benchmarkDispatch();
+	benchmarkActionCompilation();
+	benchmarkAccessors();
+	benchmarkKeyMashing();
+	benchmarkImageCache();
+	benchmarkKeyRendering();
+	benchmarkAnimation();
+	benchmarkActionExecution(executable);
+
+	return 0;
+}
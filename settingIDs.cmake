@@ -5,10 +5,16 @@
 
 set(MUMBLE_STREAMDECK_CHANNEL_JOIN_ACTION_CHANNEL_NAME_SETTING "channelJoin_channelName")
 set(MUMBLE_STREAMDECK_CHANNEL_JOIN_ACTION_CHANNEL_PASSWORD_SETTING "channelJoin_channelPassword")
+set(MUMBLE_STREAMDECK_GLOBAL_CLI_PATH_SETTING "global_cliPath")
+set(MUMBLE_STREAMDECK_GLOBAL_LOG_LEVEL_SETTING "global_logLevel")
+set(MUMBLE_STREAMDECK_GLOBAL_LOG_FILE_SETTING "global_logFile")
 
 set(MUBMLE_STREAMDECK_SETTINGS "")
 list(APPEND MUBMLE_STREAMDECK_SETTINGS "MUMBLE_STREAMDECK_CHANNEL_JOIN_ACTION_CHANNEL_NAME_SETTING")
 list(APPEND MUBMLE_STREAMDECK_SETTINGS "MUMBLE_STREAMDECK_CHANNEL_JOIN_ACTION_CHANNEL_PASSWORD_SETTING")
+list(APPEND MUBMLE_STREAMDECK_SETTINGS "MUMBLE_STREAMDECK_GLOBAL_CLI_PATH_SETTING")
+list(APPEND MUBMLE_STREAMDECK_SETTINGS "MUMBLE_STREAMDECK_GLOBAL_LOG_LEVEL_SETTING")
+list(APPEND MUBMLE_STREAMDECK_SETTINGS "MUMBLE_STREAMDECK_GLOBAL_LOG_FILE_SETTING")
 
 # create include file for CXX code
 file(WRITE "${CXX_SETTINGS_INCLUDE_FILE}" "#ifndef SETTING_IDS_H_\n#define SETTING_IDS_H_\n")
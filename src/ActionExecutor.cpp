@@ -0,0 +1,79 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#include "ActionExecutor.h"
+
+#include <boost/asio/post.hpp>
+
+#include <exception>
+#include <utility>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	ActionExecutor::ActionExecutor(ErrorHandler onError, std::size_t threadCount)
+		: m_onError(std::move(onError)), m_pool(threadCount) {}
+
+	ActionExecutor::~ActionExecutor() { shutdown(); }
+
+	void ActionExecutor::execute(Key key, Job job) {
+		std::lock_guard< std::mutex > guard(m_strandMutex);
+
+		auto it = m_strands.find(key);
+		if (it == m_strands.end()) {
+			it = m_strands.emplace(key, KeyState{ boost::asio::make_strand(m_pool.get_executor()) }).first;
+		}
+
+		// A key that is used again keeps its strand, so that the new job runs after the ones still queued
+		it->second.released = false;
+		it->second.unfinished++;
+
+		boost::asio::post(it->second.strand, [this, key, job = std::move(job)]() {
+			run(job);
+			// Even if the job has failed, as the key's strand would never be dropped otherwise
+			finished(key);
+		});
+	}
+
+	void ActionExecutor::release(Key key) {
+		std::lock_guard< std::mutex > guard(m_strandMutex);
+
+		auto it = m_strands.find(key);
+		if (it == m_strands.end()) {
+			return;
+		}
+
+		if (it->second.unfinished == 0) {
+			m_strands.erase(it);
+		} else {
+			// Dropping the strand now would let jobs scheduled for the key later overtake the queued ones
+			it->second.released = true;
+		}
+	}
+
+	void ActionExecutor::run(const Job &job) {
+		// An exception escaping into the thread pool would terminate the whole plugin
+		try {
+			job();
+		} catch (const std::exception &e) {
+			m_onError(e.what());
+		} catch (...) {
+			m_onError("Unknown error");
+		}
+	}
+
+	void ActionExecutor::finished(Key key) {
+		std::lock_guard< std::mutex > guard(m_strandMutex);
+
+		auto it = m_strands.find(key);
+		if (it != m_strands.end() && --it->second.unfinished == 0 && it->second.released) {
+			m_strands.erase(it);
+		}
+	}
+
+	void ActionExecutor::shutdown() { m_pool.join(); }
+
+}; // namespace StreamDeckIntegration
+}; // namespace Mumble
@@ -0,0 +1,93 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#ifndef MUMBLE_STREAMDECK_INTEGRATION_ACTIONEXECUTOR_H_
+#define MUMBLE_STREAMDECK_INTEGRATION_ACTIONEXECUTOR_H_
+
+#include <boost/asio/strand.hpp>
+#include <boost/asio/thread_pool.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	/**
+	 * Runs (potentially blocking) jobs on a pool of worker threads. Every job is associated with a key
+	 * (usually the handle of the Stream Deck button's context that triggered it). Jobs with the same key are
+	 * executed one after the other in the order they have been submitted, whereas jobs with different
+	 * keys may run concurrently.
+	 */
+	class ActionExecutor {
+	public:
+		using Job = std::function< void() >;
+		using Key = std::uint32_t;
+		/**
+		 * Reports that a job has thrown an exception. Called on the job's worker thread.
+		 */
+		using ErrorHandler = std::function< void(const std::string &error) >;
+
+		/**
+		 * @param onError Reports jobs that have thrown an exception (the job's key carries on regardless)
+		 * @param threadCount The number of worker threads
+		 */
+		ActionExecutor(ErrorHandler onError, std::size_t threadCount = 4);
+		~ActionExecutor();
+
+		ActionExecutor(const ActionExecutor &) = delete;
+		ActionExecutor &operator=(const ActionExecutor &) = delete;
+
+		/**
+		 * Schedules the given job for execution
+		 *
+		 * @param key The key to serialize the job on
+		 * @param job The job to execute
+		 */
+		void execute(Key key, Job job);
+
+		/**
+		 * Forgets about the given key. Jobs that are already scheduled for it will still be executed (and
+		 * jobs that are scheduled for it afterwards only after these).
+		 *
+		 * @param key The key to forget about
+		 */
+		void release(Key key);
+
+		/**
+		 * Waits for all scheduled jobs to finish and stops the worker threads afterwards
+		 */
+		void shutdown();
+
+	private:
+		using Strand = boost::asio::strand< boost::asio::thread_pool::executor_type >;
+
+		struct KeyState {
+			Strand strand;
+			/// The number of jobs that have been scheduled for the key but haven't finished yet
+			std::size_t unfinished = 0;
+			/// Whether the key has been released. Its strand is dropped once all of its jobs have finished.
+			bool released = false;
+		};
+
+		ErrorHandler m_onError;
+		boost::asio::thread_pool m_pool;
+		std::mutex m_strandMutex;
+		std::unordered_map< Key, KeyState > m_strands;
+
+		/**
+		 * Runs the given job, reporting anything it throws
+		 */
+		void run(const Job &job);
+		void finished(Key key);
+	};
+
+};     // namespace StreamDeckIntegration
+};     // namespace Mumble
+#endif // MUMBLE_STREAMDECK_INTEGRATION_ACTIONEXECUTOR_H_
@@ -0,0 +1,138 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#include "Base64.h"
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#	define MUMBLE_STREAMDECK_BASE64_SSSE3
+#	include <immintrin.h>
+#	if defined(_MSC_VER) && !defined(__clang__)
+#		include <intrin.h>
+// MSVC allows using any intrinsic without enabling the instruction set for the whole file
+#		define MUMBLE_STREAMDECK_TARGET_SSSE3
+#	else
+#		define MUMBLE_STREAMDECK_TARGET_SSSE3 __attribute__((target("ssse3")))
+#	endif
+#endif
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+	namespace Base64 {
+
+		namespace {
+			constexpr char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+			/**
+			 * Encodes the given bytes one group of three at a time (this also takes care of the padding)
+			 */
+			void encodeScalar(const unsigned char *in, std::size_t size, char *out) {
+				for (; size >= 3; size -= 3, in += 3) {
+					const std::uint32_t group = (in[0] << 16) | (in[1] << 8) | in[2];
+
+					*out++ = alphabet[(group >> 18) & 0x3F];
+					*out++ = alphabet[(group >> 12) & 0x3F];
+					*out++ = alphabet[(group >> 6) & 0x3F];
+					*out++ = alphabet[group & 0x3F];
+				}
+
+				if (size > 0) {
+					const std::uint32_t group = (in[0] << 16) | (size == 2 ? in[1] << 8 : 0);
+
+					*out++ = alphabet[(group >> 18) & 0x3F];
+					*out++ = alphabet[(group >> 12) & 0x3F];
+					*out++ = size == 2 ? alphabet[(group >> 6) & 0x3F] : '=';
+					*out++ = '=';
+				}
+			}
+
+#ifdef MUMBLE_STREAMDECK_BASE64_SSSE3
+			bool supportsSSSE3() {
+#	if defined(_MSC_VER) && !defined(__clang__)
+				int info[4];
+				__cpuid(info, 1);
+
+				return (info[2] & (1 << 9)) != 0;
+#	else
+				return __builtin_cpu_supports("ssse3");
+#	endif
+			}
+
+			const bool useSSSE3 = supportsSSSE3();
+
+			/**
+			 * Encodes blocks of 12 bytes into 16 characters (see Wojciech Muła and Daniel Lemire, "Faster Base64
+			 * Encoding and Decoding Using AVX2 Instructions"). As every block is loaded as 16 bytes, this stops once
+			 * there are less than 16 bytes left.
+			 *
+			 * @returns The number of bytes that have been encoded
+			 */
+			MUMBLE_STREAMDECK_TARGET_SSSE3 std::size_t encodeSSSE3(const unsigned char *in, std::size_t size,
+																   char *out) {
+				// Spreads every three bytes over four 32-bit lanes, so that each 6-bit index can be shifted into
+				// a byte of its own
+				const __m128i spread = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+				// Maps the ranges of the indices (A-Z, a-z, 0-9, +, /) to the offset of their characters
+				const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+													  '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+													  '/' - 63, 'A', 0, 0);
+
+				std::size_t encoded = 0;
+				for (; size - encoded >= 16; encoded += 12, out += 16) {
+					__m128i input = _mm_loadu_si128(reinterpret_cast< const __m128i * >(in + encoded));
+					input         = _mm_shuffle_epi8(input, spread);
+
+					const __m128i highBits = _mm_and_si128(input, _mm_set1_epi32(0x0FC0FC00));
+					const __m128i lowBits  = _mm_and_si128(input, _mm_set1_epi32(0x003F03F0));
+					const __m128i indices  = _mm_or_si128(_mm_mulhi_epu16(highBits, _mm_set1_epi32(0x04000040)),
+														  _mm_mullo_epi16(lowBits, _mm_set1_epi32(0x01000010)));
+
+					// Reduce the indices to the range they are in: 0 for 0-25, 1-10 for 52-61, 11 and 12 for 62 and
+					// 63 and 13 for 26-51
+					__m128i range         = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+					const __m128i isUpper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+					range                 = _mm_or_si128(range, _mm_and_si128(isUpper, _mm_set1_epi8(13)));
+
+					const __m128i result = _mm_add_epi8(_mm_shuffle_epi8(offsets, range), indices);
+					_mm_storeu_si128(reinterpret_cast< __m128i * >(out), result);
+				}
+
+				return encoded;
+			}
+#endif
+		} // namespace
+
+		void encode(std::string_view data, std::string &out) {
+			const std::size_t offset = out.size();
+			out.resize(offset + encodedSize(data.size()));
+
+			const unsigned char *in = reinterpret_cast< const unsigned char * >(data.data());
+			char *dest              = &out[offset];
+			std::size_t remaining   = data.size();
+
+#ifdef MUMBLE_STREAMDECK_BASE64_SSSE3
+			if (useSSSE3) {
+				const std::size_t encoded = encodeSSSE3(in, remaining, dest);
+
+				in += encoded;
+				dest += encoded / 3 * 4;
+				remaining -= encoded;
+			}
+#endif
+
+			encodeScalar(in, remaining, dest);
+		}
+
+		std::string encode(std::string_view data) {
+			std::string encoded;
+			encode(data, encoded);
+
+			return encoded;
+		}
+
+	}; // namespace Base64
+};     // namespace StreamDeckIntegration
+};     // namespace Mumble
@@ -0,0 +1,42 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#ifndef MUMBLE_STREAMDECK_INTEGRATION_BASE64_H_
+#define MUMBLE_STREAMDECK_INTEGRATION_BASE64_H_
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+	namespace Base64 {
+
+		/**
+		 * @param size The number of bytes to encode
+		 * @returns The number of characters the encoded bytes take up (including padding)
+		 */
+		constexpr std::size_t encodedSize(std::size_t size) { return (size + 2) / 3 * 4; }
+
+		/**
+		 * Base64-encodes the given data (using the standard alphabet and padding) and appends the result to
+		 * the given string. On x86 CPUs supporting SSSE3, 12 bytes are encoded at once.
+		 *
+		 * @param data The data to encode
+		 * @param out The string to append to
+		 */
+		void encode(std::string_view data, std::string &out);
+
+		/**
+		 * @param data The data to encode
+		 * @returns The encoded data
+		 */
+		std::string encode(std::string_view data);
+
+	}; // namespace Base64
+};     // namespace StreamDeckIntegration
+};     // namespace Mumble
+
+#endif // MUMBLE_STREAMDECK_INTEGRATION_BASE64_H_
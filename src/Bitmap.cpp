@@ -0,0 +1,201 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#include "Bitmap.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	namespace {
+		constexpr int glyphWidth   = 5;
+		constexpr int glyphHeight  = 7;
+		constexpr int glyphSpacing = 1;
+
+		/// Every row of a glyph is stored in the lower 5 bits of a byte, the leftmost pixel being the highest bit
+		using Glyph = std::array< std::uint8_t, glyphHeight >;
+
+		constexpr Glyph digitGlyphs[] = {
+			{ 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E }, { 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E },
+			{ 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F }, { 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E },
+			{ 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 }, { 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E },
+			{ 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E }, { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 },
+			{ 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E }, { 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C },
+		};
+
+		constexpr Glyph letterGlyphs[] = {
+			{ 0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 }, { 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E },
+			{ 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E }, { 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C },
+			{ 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F }, { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 },
+			{ 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F }, { 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 },
+			{ 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E }, { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C },
+			{ 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 }, { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F },
+			{ 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 }, { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 },
+			{ 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E }, { 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 },
+			{ 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D }, { 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 },
+			{ 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E }, { 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 },
+			{ 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E }, { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 },
+			{ 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A }, { 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 },
+			{ 0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04 }, { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F },
+		};
+
+		const Glyph &glyphFor(char c) {
+			static constexpr Glyph space       = {};
+			static constexpr Glyph plus        = { 0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00 };
+			static constexpr Glyph minus       = { 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 };
+			static constexpr Glyph exclamation = { 0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04 };
+			static constexpr Glyph question    = { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 };
+			static constexpr Glyph period      = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C };
+			static constexpr Glyph colon       = { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 };
+			static constexpr Glyph slash       = { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 };
+			static constexpr Glyph unknown     = { 0x1F, 0x11, 0x11, 0x11, 0x11, 0x11, 0x1F };
+
+			if (c >= '0' && c <= '9') {
+				return digitGlyphs[c - '0'];
+			} else if (c >= 'A' && c <= 'Z') {
+				return letterGlyphs[c - 'A'];
+			} else if (c >= 'a' && c <= 'z') {
+				return letterGlyphs[c - 'a'];
+			}
+
+			switch (c) {
+				case ' ':
+					return space;
+				case '+':
+					return plus;
+				case '-':
+					return minus;
+				case '!':
+					return exclamation;
+				case '?':
+					return question;
+				case '.':
+					return period;
+				case ':':
+					return colon;
+				case '/':
+					return slash;
+				default:
+					return unknown;
+			}
+		}
+	} // namespace
+
+	Bitmap::Bitmap(unsigned int width, unsigned int height)
+		: m_width(width), m_height(height), m_pixels(width * height * bytesPerPixel) {}
+
+	void Bitmap::clear(Color color) {
+		const std::uint8_t pixel[bytesPerPixel] = { color.r, color.g, color.b, color.a };
+
+		std::uint8_t *data = m_pixels.data();
+		for (std::size_t i = 0; i < m_pixels.size(); i += bytesPerPixel) {
+			std::memcpy(data + i, pixel, bytesPerPixel);
+		}
+	}
+
+	void Bitmap::fillRect(int x, int y, int width, int height, Color color) {
+		const int left   = std::max(x, 0);
+		const int top    = std::max(y, 0);
+		const int right  = std::min(x + width, static_cast< int >(m_width));
+		const int bottom = std::min(y + height, static_cast< int >(m_height));
+
+		for (int row = top; row < bottom; ++row) {
+			for (int column = left; column < right; ++column) {
+				blend(static_cast< unsigned int >(column), static_cast< unsigned int >(row), color, 255);
+			}
+		}
+	}
+
+	void Bitmap::fillCircle(float centerX, float centerY, float radius, Color color) {
+		const int width  = static_cast< int >(m_width);
+		const int height = static_cast< int >(m_height);
+		const int left   = std::max(static_cast< int >(std::floor(centerX - radius - 0.5f)), 0);
+		const int top    = std::max(static_cast< int >(std::floor(centerY - radius - 0.5f)), 0);
+		const int right  = std::min(static_cast< int >(std::ceil(centerX + radius + 0.5f)), width);
+		const int bottom = std::min(static_cast< int >(std::ceil(centerY + radius + 0.5f)), height);
+
+		// Pixels within half a pixel of the circle's edge are partially covered. Only those need a square root.
+		const float inner = radius > 0.5f ? (radius - 0.5f) * (radius - 0.5f) : 0.0f;
+		const float outer = (radius + 0.5f) * (radius + 0.5f);
+
+		for (int y = top; y < bottom; ++y) {
+			const float dy = static_cast< float >(y) + 0.5f - centerY;
+
+			for (int x = left; x < right; ++x) {
+				const float dx       = static_cast< float >(x) + 0.5f - centerX;
+				const float distance = dx * dx + dy * dy;
+
+				if (distance >= outer) {
+					continue;
+				}
+
+				unsigned int coverage = 255;
+				if (distance > inner) {
+					coverage = static_cast< unsigned int >((radius + 0.5f - std::sqrt(distance)) * 255.0f);
+				}
+
+				blend(static_cast< unsigned int >(x), static_cast< unsigned int >(y), color, std::min(coverage, 255u));
+			}
+		}
+	}
+
+	void Bitmap::drawText(int x, int y, std::string_view text, int scale, Color color) {
+		for (char c : text) {
+			const Glyph &glyph = glyphFor(c);
+
+			for (int row = 0; row < glyphHeight; ++row) {
+				for (int column = 0; column < glyphWidth; ++column) {
+					if (glyph[row] & (1 << (glyphWidth - 1 - column))) {
+						fillRect(x + column * scale, y + row * scale, scale, scale, color);
+					}
+				}
+			}
+
+			x += (glyphWidth + glyphSpacing) * scale;
+		}
+	}
+
+	int Bitmap::textWidth(std::string_view text, int scale) {
+		if (text.empty()) {
+			return 0;
+		}
+
+		return (static_cast< int >(text.size()) * (glyphWidth + glyphSpacing) - glyphSpacing) * scale;
+	}
+
+	int Bitmap::textHeight(int scale) { return glyphHeight * scale; }
+
+	void Bitmap::blend(unsigned int x, unsigned int y, Color color, unsigned int coverage) {
+		std::uint8_t *pixel = m_pixels.data() + (y * m_width + x) * bytesPerPixel;
+
+		const unsigned int alpha = color.a * coverage / 255;
+		if (alpha == 0) {
+			return;
+		} else if (alpha == 255) {
+			pixel[0] = color.r;
+			pixel[1] = color.g;
+			pixel[2] = color.b;
+			pixel[3] = 255;
+
+			return;
+		}
+
+		// Source over destination with straight alpha
+		const unsigned int destinationAlpha = pixel[3] * (255 - alpha) / 255;
+		const unsigned int resultAlpha      = alpha + destinationAlpha;
+
+		pixel[0] = static_cast< std::uint8_t >((color.r * alpha + pixel[0] * destinationAlpha) / resultAlpha);
+		pixel[1] = static_cast< std::uint8_t >((color.g * alpha + pixel[1] * destinationAlpha) / resultAlpha);
+		pixel[2] = static_cast< std::uint8_t >((color.b * alpha + pixel[2] * destinationAlpha) / resultAlpha);
+		pixel[3] = static_cast< std::uint8_t >(resultAlpha);
+	}
+
+}; // namespace StreamDeckIntegration
+}; // namespace Mumble
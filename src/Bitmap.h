@@ -0,0 +1,99 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#ifndef MUMBLE_STREAMDECK_INTEGRATION_BITMAP_H_
+#define MUMBLE_STREAMDECK_INTEGRATION_BITMAP_H_
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	/**
+	 * A color with straight (not premultiplied) alpha
+	 */
+	struct Color {
+		std::uint8_t r = 0;
+		std::uint8_t g = 0;
+		std::uint8_t b = 0;
+		std::uint8_t a = 255;
+	};
+
+	/**
+	 * An RGBA image (8 bits per channel, rows stored top to bottom) along with the few drawing operations
+	 * needed to render badges and overlays onto a key. Everything that is drawn is blended over what is
+	 * there already, with the edges of circles being anti-aliased.
+	 */
+	class Bitmap {
+	public:
+		static constexpr unsigned int bytesPerPixel = 4;
+
+		Bitmap(unsigned int width, unsigned int height);
+
+		unsigned int width() const { return m_width; }
+		unsigned int height() const { return m_height; }
+		/**
+		 * @returns The pixels, row by row
+		 */
+		const std::uint8_t *data() const { return m_pixels.data(); }
+		const std::uint8_t *row(unsigned int y) const { return m_pixels.data() + y * m_width * bytesPerPixel; }
+
+		/**
+		 * Sets every pixel to the given color (without blending)
+		 */
+		void clear(Color color);
+
+		/**
+		 * Fills the given rectangle (clipped to the bitmap)
+		 */
+		void fillRect(int x, int y, int width, int height, Color color);
+
+		/**
+		 * Fills the given circle (clipped to the bitmap)
+		 *
+		 * @param centerX The horizontal position of the center (pixel centers are at .5)
+		 * @param centerY The vertical position of the center
+		 * @param radius The radius in pixels
+		 * @param color The color to fill the circle with
+		 */
+		void fillCircle(float centerX, float centerY, float radius, Color color);
+
+		/**
+		 * Draws the given text using a built-in 5x7 pixel font that covers digits, upper case letters and a
+		 * few symbols (anything else is drawn as a box)
+		 *
+		 * @param x The left edge of the text
+		 * @param y The top edge of the text
+		 * @param text The text to draw
+		 * @param scale How many pixels wide and high every pixel of the font shall be
+		 * @param color The color of the text
+		 */
+		void drawText(int x, int y, std::string_view text, int scale, Color color);
+
+		/**
+		 * @returns The width of the given text when drawn with drawText
+		 */
+		static int textWidth(std::string_view text, int scale);
+		/**
+		 * @returns The height of text when drawn with drawText
+		 */
+		static int textHeight(int scale);
+
+	private:
+		unsigned int m_width;
+		unsigned int m_height;
+		std::vector< std::uint8_t > m_pixels;
+
+		/**
+		 * Blends the given color with the given coverage (0 to 255) over the pixel at the given position
+		 */
+		void blend(unsigned int x, unsigned int y, Color color, unsigned int coverage);
+	};
+
+};     // namespace StreamDeckIntegration
+};     // namespace Mumble
+#endif // MUMBLE_STREAMDECK_INTEGRATION_BITMAP_H_
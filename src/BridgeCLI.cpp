@@ -0,0 +1,212 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#include "BridgeCLI.h"
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/process.hpp>
+
+#include <array>
+#include <chrono>
+#include <functional>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	namespace {
+		using Clock = std::chrono::steady_clock;
+
+		/// The bridge's responses are tiny - anything larger than this can't be a proper response
+		constexpr std::size_t maxResponseSize = 1024 * 1024;
+		/// Only this much of the CLI's error output is kept (the rest is read but discarded)
+		constexpr std::size_t maxErrorOutputSize = 4096;
+
+		/**
+		 * Drains a pipe on the event loop, keeping at most a fixed amount of what has been read
+		 */
+		class PipeReader {
+		public:
+			/**
+			 * @param pipe The pipe to read from
+			 * @param maxSize The maximum number of bytes to keep
+			 * @param onOverflow Called (once) when more than maxSize bytes have been read
+			 * @param onDone Called once the pipe has been closed
+			 */
+			PipeReader(boost::process::async_pipe &pipe, std::size_t maxSize, std::function< void() > onOverflow,
+					   std::function< void() > onDone)
+				: m_pipe(pipe), m_maxSize(maxSize), m_onOverflow(std::move(onOverflow)), m_onDone(std::move(onDone)) {
+				readChunk();
+			}
+
+			std::string &content() { return m_content; }
+			bool overflowed() const { return m_overflowed; }
+
+		private:
+			boost::process::async_pipe &m_pipe;
+			std::size_t m_maxSize;
+			std::function< void() > m_onOverflow;
+			std::function< void() > m_onDone;
+			std::array< char, 4096 > m_chunk;
+			std::string m_content;
+			bool m_overflowed = false;
+
+			void readChunk() {
+				m_pipe.async_read_some(boost::asio::buffer(m_chunk),
+									   [this](const boost::system::error_code &ec, std::size_t size) {
+										   append(size);
+
+										   if (ec) {
+											   // EOF (or the pipe has been closed because the CLI has been killed)
+											   m_onDone();
+										   } else {
+											   readChunk();
+										   }
+									   });
+			}
+
+			void append(std::size_t size) {
+				const std::size_t kept = std::min(size, m_maxSize - m_content.size());
+				m_content.append(m_chunk.data(), kept);
+
+				if (kept < size && !m_overflowed) {
+					m_overflowed = true;
+					m_onOverflow();
+				}
+			}
+		};
+	} // namespace
+
+	BridgeCLI::BridgeCLI(CLIPathCache &pathCache) : m_pathCache(pathCache) {}
+
+	nlohmann::json BridgeCLI::execute(const std::string &request, const Metrics::Recorder &recorder,
+									  std::chrono::milliseconds timeout) {
+		Clock::time_point start          = Clock::now();
+		const Clock::time_point deadline = start + timeout;
+
+		// The path is only searched for once and then cached until launching the CLI fails
+		boost::filesystem::path cliPath = m_pathCache.get();
+
+		recorder.record(Metrics::Stage::CLIResolve, Clock::now() - start);
+		if (cliPath.empty()) {
+			// Not found
+			throw BridgeException("Unable to locate \"" + m_pathCache.executableName()
+								  + "\" binary. Are you sure it's in PATH?");
+		}
+
+		start = Clock::now();
+
+		// Both of the CLI's outputs are drained concurrently (on an event loop of our own), so that the CLI can't
+		// get stuck writing to one of them while we are waiting for the other
+		boost::asio::io_context ioContext;
+		boost::process::async_pipe stdoutPipe(ioContext);
+		boost::process::async_pipe stderrPipe(ioContext);
+		boost::asio::steady_timer deadlineTimer(ioContext, deadline);
+		unsigned int openPipes = 2;
+		bool exited            = false;
+		int processExitCode    = 0;
+
+		const auto checkDone = [&openPipes, &exited, &deadlineTimer]() {
+			if (openPipes == 0 && exited) {
+				deadlineTimer.cancel();
+			}
+		};
+
+		std::error_code launchErrorCode;
+		boost::process::child c(
+			cliPath, "--json", request, boost::process::std_out > stdoutPipe, boost::process::std_err > stderrPipe,
+			boost::process::std_in.close(), ioContext,
+			boost::process::on_exit =
+				[&exited, &processExitCode, &checkDone](int exitCode, const std::error_code &) {
+					exited          = true;
+					processExitCode = exitCode;
+					checkDone();
+				},
+			launchErrorCode);
+
+		if (launchErrorCode) {
+			if (launchErrorCode == std::errc::no_such_file_or_directory) {
+				// The CLI is no longer where we expected it to be
+				m_pathCache.invalidate();
+			} else {
+				m_pathCache.invalidateIfChanged();
+			}
+
+			throw BridgeException("Trying to launch external process resulted in non-zero exit code: "
+								  + std::to_string(launchErrorCode.value()));
+		}
+
+		recorder.record(Metrics::Stage::Spawn, Clock::now() - start);
+		start = Clock::now();
+
+		const auto kill = [&c, &exited, &ioContext]() {
+			if (!exited) {
+				std::error_code ec;
+				c.terminate(ec);
+			}
+
+			// Don't wait for anything else that might still be pending
+			ioContext.stop();
+		};
+
+		bool timedOut = false;
+		deadlineTimer.async_wait([&timedOut, &kill](const boost::system::error_code &ec) {
+			if (!ec) {
+				timedOut = true;
+				kill();
+			}
+		});
+
+		const auto pipeDone = [&openPipes, &checkDone]() {
+			openPipes--;
+			checkDone();
+		};
+
+		// A response that is too large is never going to be valid -> no point in waiting for the rest of it
+		PipeReader stdoutReader(stdoutPipe, maxResponseSize, kill, pipeDone);
+		PipeReader stderrReader(stderrPipe, maxErrorOutputSize, []() {}, pipeDone);
+
+		ioContext.run();
+
+		recorder.record(Metrics::Stage::BridgeWait, Clock::now() - start);
+
+		if (timedOut) {
+			throw BridgeException("The CLI didn't answer within " + std::to_string(timeout.count()) + " ms");
+		} else if (stdoutReader.overflowed()) {
+			throw BridgeException("The CLI's response exceeds " + std::to_string(maxResponseSize) + " bytes");
+		}
+
+		if (processExitCode) {
+			std::string errorMsg = "Calling the CLI returned non-zero exit code: " + std::to_string(processExitCode);
+
+			std::string &stderr_content = stderrReader.content();
+			const std::size_t first     = stderr_content.find_first_not_of(" \t\r\n");
+			if (first != std::string::npos) {
+				stderr_content.erase(stderr_content.find_last_not_of(" \t\r\n") + 1);
+				errorMsg += " (\"" + stderr_content.substr(first) + (stderrReader.overflowed() ? "..." : "") + "\")";
+			}
+
+			throw BridgeException(errorMsg);
+		}
+
+		const std::string &stdout_content = stdoutReader.content();
+		try {
+			start = Clock::now();
+
+			// Leading and trailing whitespace is skipped by the parser, so the response is parsed right out of
+			// the buffer it has been read into
+			nlohmann::json response = nlohmann::json::parse(stdout_content.begin(), stdout_content.end());
+
+			recorder.record(Metrics::Stage::ResponseParse, Clock::now() - start);
+
+			return response;
+		} catch (const nlohmann::json::parse_error &e) {
+			throw BridgeException(std::string("CLI returned malformed JSON: ") + e.what() + " (JSON: \""
+								  + stdout_content + "\")");
+		}
+	}
+
+}; // namespace StreamDeckIntegration
+}; // namespace Mumble
@@ -0,0 +1,52 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#ifndef MUMBLE_STREAMDECK_INTEGRATION_BRIDGECLI_H_
+#define MUMBLE_STREAMDECK_INTEGRATION_BRIDGECLI_H_
+
+#include "BridgeClient.h"
+#include "CLIPathCache.h"
+#include "Metrics.h"
+
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <string>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	/**
+	 * Talks to the Mumble JSON bridge by spawning the bridge's CLI once per request. This is the fallback
+	 * for when the bridge can't be contacted directly (see BridgeClient).
+	 */
+	class BridgeCLI {
+	public:
+		/**
+		 * @param pathCache The cache used to locate the CLI executable
+		 */
+		BridgeCLI(CLIPathCache &pathCache);
+
+		/**
+		 * Sends the given request to the CLI and processes the resulting output
+		 *
+		 * @param request The serialized JSON describing the request
+		 * @param recorder Records how long locating, launching and waiting for the CLI as well as parsing
+		 * 	its response takes
+		 * @param timeout How long the CLI may take in total. If it takes any longer, it is killed.
+		 * @returns The JSON response from the CLI
+		 *
+		 * @throws BridgeException If anything goes wrong
+		 */
+		nlohmann::json execute(const std::string &request, const Metrics::Recorder &recorder = {},
+							   std::chrono::milliseconds timeout = std::chrono::milliseconds(5000));
+
+	private:
+		CLIPathCache &m_pathCache;
+	};
+
+};     // namespace StreamDeckIntegration
+};     // namespace Mumble
+#endif // MUMBLE_STREAMDECK_INTEGRATION_BRIDGECLI_H_
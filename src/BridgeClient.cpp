@@ -0,0 +1,673 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#ifdef _WIN32
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <poll.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+#include "BridgeClient.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	namespace {
+		/**
+		 * Finds the end of the JSON document (object or array) that starts at the given position
+		 *
+		 * @param buffer The buffer to search in
+		 * @param start The index of the document's opening bracket
+		 * @returns The index one past the document's closing bracket or std::string::npos if the
+		 * 	document is not yet complete
+		 */
+		std::size_t findDocumentEnd(const std::string &buffer, std::size_t start) {
+			int depth     = 0;
+			bool inString = false;
+			bool escaped  = false;
+
+			for (std::size_t i = start; i < buffer.size(); ++i) {
+				const char c = buffer[i];
+
+				if (inString) {
+					if (escaped) {
+						escaped = false;
+					} else if (c == '\\') {
+						escaped = true;
+					} else if (c == '"') {
+						inString = false;
+					}
+
+					continue;
+				}
+
+				switch (c) {
+					case '"':
+						inString = true;
+						break;
+					case '{':
+					case '[':
+						depth++;
+						break;
+					case '}':
+					case ']':
+						if (--depth == 0) {
+							return i + 1;
+						}
+						break;
+					default:
+						break;
+				}
+			}
+
+			return std::string::npos;
+		}
+
+		/// How long to wait before trying to connect again after an attempt has failed
+		constexpr std::chrono::milliseconds reconnectBackoff(500);
+		/// How long writing a message to the bridge's pipe may take at most
+		constexpr std::chrono::milliseconds writeTimeout(1000);
+	} // namespace
+
+	BridgeClient::BridgeClient(const std::string &bridgePipePath)
+		: m_bridgePipePath(bridgePipePath.empty() ? defaultBridgePipePath() : bridgePipePath) {}
+
+	BridgeClient::~BridgeClient() { disconnect(); }
+
+	std::string BridgeClient::defaultBridgePipePath() {
+#ifdef _WIN32
+		return "\\\\.\\pipe\\.mumble-json-bridge";
+#else
+		return "/tmp/.mumble-json-bridge";
+#endif
+	}
+
+	nlohmann::json BridgeClient::execute(const std::string &message, std::chrono::milliseconds timeout) {
+		const std::uint64_t receivedBefore = m_receivedCount;
+
+		std::future< nlohmann::json > response;
+		const std::uint64_t messageID = submit(message, response);
+
+		if (response.wait_for(timeout) != std::future_status::ready) {
+			dropPending(messageID);
+			handleTimeout(receivedBefore);
+
+			throw BridgeException("Timed out waiting for the bridge's response");
+		}
+
+		return response.get();
+	}
+
+	std::vector< nlohmann::json > BridgeClient::executeAll(const std::vector< std::string > &messages,
+														   std::chrono::milliseconds timeout) {
+		const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + timeout;
+		const std::uint64_t receivedBefore                   = m_receivedCount;
+
+		std::vector< std::uint64_t > messageIDs;
+		std::vector< std::future< nlohmann::json > > futures(messages.size());
+		messageIDs.reserve(messages.size());
+
+		const auto dropAll = [this, &messageIDs]() {
+			for (std::uint64_t messageID : messageIDs) {
+				dropPending(messageID);
+			}
+		};
+
+		try {
+			for (std::size_t i = 0; i < messages.size(); ++i) {
+				messageIDs.push_back(submit(messages[i], futures[i]));
+			}
+		} catch (const BridgeException &) {
+			dropAll();
+			throw;
+		}
+
+		std::vector< nlohmann::json > responses;
+		responses.reserve(messages.size());
+
+		for (std::future< nlohmann::json > &future : futures) {
+			if (future.wait_until(deadline) != std::future_status::ready) {
+				dropAll();
+				handleTimeout(receivedBefore);
+
+				throw BridgeException("Timed out waiting for the bridge's responses");
+			}
+
+			responses.push_back(future.get());
+		}
+
+		return responses;
+	}
+
+	std::uint64_t BridgeClient::submit(const std::string &message, std::future< nlohmann::json > &response) {
+		const std::size_t bodyStart = message.find_first_not_of(" \t\r\n");
+		if (bodyStart == std::string::npos || message[bodyStart] != '{') {
+			throw BridgeException("Bridge messages have to be JSON objects");
+		}
+
+		// Splice our session's credentials and the message ID into the given message object
+		std::uint64_t messageID;
+		std::string envelope;
+		std::unique_lock< std::mutex > writeLock;
+		{
+			// The request has to belong to the session it is sent with. Otherwise a concurrent reconnect
+			// could leave it waiting for a response that never arrives.
+			std::unique_lock< std::mutex > lock(m_sessionMutex);
+
+			if (!m_connected) {
+				connect(lock);
+			}
+
+			writeLock = std::unique_lock< std::mutex >(m_writeMutex);
+			response  = enqueue(messageID);
+			envelope  = "{\"client_id\":" + std::to_string(m_clientID) + ",\"secret\":" + m_secret
+					   + ",\"message_id\":" + std::to_string(messageID);
+		}
+		const std::size_t firstMember = message.find_first_not_of(" \t\r\n", bodyStart + 1);
+		if (firstMember != std::string::npos && message[firstMember] != '}') {
+			envelope += ',';
+		}
+		envelope.append(message, bodyStart + 1, std::string::npos);
+
+		try {
+			writeToBridge(envelope);
+		} catch (const BridgeException &) {
+			// Taking m_sessionMutex while still holding m_writeMutex could deadlock
+			writeLock.unlock();
+
+			dropPending(messageID);
+			disconnect();
+			throw;
+		}
+
+		return messageID;
+	}
+
+	bool BridgeClient::isConnected() const { return m_connected; }
+
+	void BridgeClient::disconnect() {
+		std::lock_guard< std::mutex > guard(m_sessionMutex);
+
+		disconnectLocked();
+	}
+
+	void BridgeClient::connect(std::unique_lock< std::mutex > &sessionLock) {
+		if (m_connecting) {
+			throw BridgeException("The registration with the bridge is still in progress");
+		}
+
+		disconnectLocked();
+
+		if (std::chrono::steady_clock::now() < m_retryAfter) {
+			throw BridgeException("The bridge couldn't be reached a moment ago");
+		}
+		if (!bridgePipeExists()) {
+			m_retryAfter = std::chrono::steady_clock::now() + reconnectBackoff;
+			throw BridgeException("The bridge's pipe doesn't exist (is the bridge running?)");
+		}
+
+		std::future< nlohmann::json > future;
+		try {
+			openClientPipe();
+
+			m_stopReader   = false;
+			m_readerThread = std::thread(&BridgeClient::readerLoop, this);
+
+			nlohmann::json registration;
+			registration["message_type"]         = "registration";
+			registration["message"]["pipe_path"] = m_clientPipePath;
+
+			{
+				std::lock_guard< std::mutex > guard(m_pendingMutex);
+
+				m_registration = std::promise< nlohmann::json >();
+				m_registering  = true;
+				future         = m_registration.get_future();
+			}
+
+			try {
+				std::lock_guard< std::mutex > guard(m_writeMutex);
+
+				writeToBridge(registration.dump());
+			} catch (const BridgeException &) {
+				endRegistration();
+				throw;
+			}
+		} catch (const BridgeException &) {
+			disconnectLocked();
+			m_retryAfter = std::chrono::steady_clock::now() + reconnectBackoff;
+			throw;
+		} catch (const std::exception &e) {
+			// E.g. a std::system_error from starting the reader thread. Callers only expect BridgeExceptions.
+			disconnectLocked();
+			m_retryAfter = std::chrono::steady_clock::now() + reconnectBackoff;
+			throw BridgeException(std::string("Unable to connect to the bridge: ") + e.what());
+		}
+
+		// Don't keep everybody else waiting for the bridge's answer. They fail right away in the meantime
+		// (see above).
+		const std::uint64_t session = m_session;
+		m_connecting                = true;
+
+		sessionLock.unlock();
+		const bool answered = future.wait_for(std::chrono::milliseconds(2000)) == std::future_status::ready;
+		sessionLock.lock();
+
+		if (session != m_session) {
+			// The session has been closed (and possibly replaced by a new one) in the meantime
+			throw BridgeException("The session with the bridge has been closed during the registration");
+		}
+
+		m_connecting = false;
+
+		try {
+			if (!answered) {
+				endRegistration();
+				throw BridgeException("Timed out waiting for the bridge to accept the registration");
+			}
+
+			nlohmann::json response = future.get();
+
+			if (response.value("response_type", "") != "registration" || !response.contains("response")) {
+				throw BridgeException("Bridge rejected the registration: " + response.dump());
+			}
+
+			m_clientID = response["response"].at("client_id").get< std::uint64_t >();
+			// Store the secret in its serialized form as that is what we need for every request
+			m_secret = response["response"].at("secret").dump();
+		} catch (const nlohmann::json::exception &e) {
+			disconnectLocked();
+			m_retryAfter = std::chrono::steady_clock::now() + reconnectBackoff;
+			throw BridgeException(std::string("Malformed registration response: ") + e.what());
+		} catch (const BridgeException &) {
+			disconnectLocked();
+			m_retryAfter = std::chrono::steady_clock::now() + reconnectBackoff;
+			throw;
+		} catch (const std::exception &e) {
+			disconnectLocked();
+			m_retryAfter = std::chrono::steady_clock::now() + reconnectBackoff;
+			throw BridgeException(std::string("Unable to register with the bridge: ") + e.what());
+		}
+
+		m_connected = true;
+	}
+
+	void BridgeClient::disconnectLocked() {
+		m_connected  = false;
+		m_connecting = false;
+		m_session++;
+
+		closeClientPipe();
+		failAllPending("Session with the bridge has been closed");
+
+		{
+			// Wake up a registration that is still waiting for its response
+			std::lock_guard< std::mutex > guard(m_pendingMutex);
+
+			if (m_registering) {
+				m_registering = false;
+				m_registration.set_exception(
+					std::make_exception_ptr(BridgeException("Session with the bridge has been closed")));
+			}
+		}
+
+		m_clientID = 0;
+		m_secret.clear();
+	}
+
+	void BridgeClient::endRegistration() {
+		std::lock_guard< std::mutex > guard(m_pendingMutex);
+
+		m_registering = false;
+	}
+
+	std::future< nlohmann::json > BridgeClient::enqueue(std::uint64_t &messageID) {
+		std::lock_guard< std::mutex > guard(m_pendingMutex);
+
+		messageID = m_nextMessageID++;
+
+		m_pending.push_back({ messageID, std::promise< nlohmann::json >() });
+
+		return m_pending.back().response.get_future();
+	}
+
+	void BridgeClient::dropPending(std::uint64_t messageID) {
+		std::lock_guard< std::mutex > guard(m_pendingMutex);
+
+		auto it = std::find_if(m_pending.begin(), m_pending.end(),
+							   [messageID](const PendingRequest &request) { return request.id == messageID; });
+
+		if (it != m_pending.end()) {
+			it->abandoned = true;
+		}
+	}
+
+	void BridgeClient::handleTimeout(std::uint64_t receivedBefore) {
+		if (m_receivedCount == receivedBefore) {
+			// The bridge (or Mumble) has probably gone away - start from scratch next time
+			disconnect();
+		}
+	}
+
+	void BridgeClient::failAllPending(const std::string &reason) {
+		std::deque< PendingRequest > pending;
+		{
+			std::lock_guard< std::mutex > guard(m_pendingMutex);
+			pending.swap(m_pending);
+		}
+
+		for (PendingRequest &current : pending) {
+			current.response.set_exception(std::make_exception_ptr(BridgeException(reason)));
+		}
+	}
+
+	void BridgeClient::processIncoming(std::string &buffer) {
+		std::size_t consumed = 0;
+
+		while (true) {
+			const std::size_t start = buffer.find_first_of("{[", consumed);
+			if (start == std::string::npos) {
+				// Only whitespace or garbage left
+				consumed = buffer.size();
+				break;
+			}
+
+			const std::size_t end = findDocumentEnd(buffer, start);
+			if (end == std::string::npos) {
+				// Wait for the rest of this document to arrive
+				consumed = start;
+				break;
+			}
+
+			try {
+				dispatchResponse(nlohmann::json::parse(buffer.begin() + start, buffer.begin() + end));
+			} catch (const nlohmann::json::parse_error &) {
+				// Skip malformed documents
+			}
+
+			consumed = end;
+		}
+
+		buffer.erase(0, consumed);
+	}
+
+	void BridgeClient::dispatchResponse(nlohmann::json response) {
+		std::promise< nlohmann::json > promise;
+		{
+			std::lock_guard< std::mutex > guard(m_pendingMutex);
+
+			auto idIt        = response.find("message_id");
+			const bool hasID = idIt != response.end() && idIt->is_number_unsigned();
+
+			if (!hasID && m_registering) {
+				m_registering = false;
+				m_registration.set_value(std::move(response));
+
+				return;
+			}
+
+			// The registration doesn't count, as it doesn't involve Mumble
+			m_receivedCount++;
+
+			if (m_pending.empty()) {
+				// Nobody is waiting for this
+				return;
+			}
+
+			// Responses without an ID are answered in the order the requests have been sent
+			auto it = m_pending.begin();
+
+			if (hasID) {
+				const std::uint64_t messageID = idIt->get< std::uint64_t >();
+
+				it = std::find_if(m_pending.begin(), m_pending.end(),
+								  [messageID](const PendingRequest &request) { return request.id == messageID; });
+
+				if (it == m_pending.end()) {
+					return;
+				}
+			}
+
+			const bool abandoned = it->abandoned;
+			promise              = std::move(it->response);
+			m_pending.erase(it);
+
+			if (abandoned) {
+				// The request has timed out already
+				return;
+			}
+		}
+
+		promise.set_value(std::move(response));
+	}
+
+#ifdef _WIN32
+	bool BridgeClient::bridgePipeExists() const {
+		// Only fails with ERROR_FILE_NOT_FOUND if there is no pipe at all (as opposed to all of its instances
+		// being busy)
+		return WaitNamedPipeA(m_bridgePipePath.c_str(), 1) || GetLastError() != ERROR_FILE_NOT_FOUND;
+	}
+
+	void BridgeClient::openClientPipe() {
+		m_clientPipePath = "\\\\.\\pipe\\.mumble-streamdeck-integration-" + std::to_string(GetCurrentProcessId());
+
+		// FILE_FLAG_FIRST_PIPE_INSTANCE makes sure that nobody else has created the pipe before us
+		HANDLE pipe =
+			CreateNamedPipeA(m_clientPipePath.c_str(), PIPE_ACCESS_INBOUND | FILE_FLAG_FIRST_PIPE_INSTANCE,
+							 PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT, 1, 0, 4096, 0, NULL);
+
+		if (pipe == INVALID_HANDLE_VALUE) {
+			throw BridgeException("Unable to create response pipe (error " + std::to_string(GetLastError()) + ")");
+		}
+
+		m_clientPipe = pipe;
+	}
+
+	void BridgeClient::closeClientPipe() {
+		if (m_readerThread.joinable()) {
+			m_stopReader = true;
+
+			// Wake up the reader in case it is waiting for the bridge to connect
+			HANDLE wakeUp = CreateFileA(m_clientPipePath.c_str(), GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+			if (wakeUp != INVALID_HANDLE_VALUE) {
+				CloseHandle(wakeUp);
+			}
+
+			m_readerThread.join();
+		}
+
+		if (m_clientPipe) {
+			CloseHandle(static_cast< HANDLE >(m_clientPipe));
+			m_clientPipe = nullptr;
+		}
+	}
+
+	void BridgeClient::writeToBridge(const std::string &message) {
+		HANDLE pipe = CreateFileA(m_bridgePipePath.c_str(), GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+
+		if (pipe == INVALID_HANDLE_VALUE) {
+			throw BridgeException("Unable to open the bridge's pipe (error " + std::to_string(GetLastError()) + ")");
+		}
+
+		DWORD written   = 0;
+		const BOOL done = WriteFile(pipe, message.data(), static_cast< DWORD >(message.size()), &written, NULL);
+		CloseHandle(pipe);
+
+		if (!done || written != message.size()) {
+			throw BridgeException("Unable to write to the bridge's pipe");
+		}
+	}
+
+	void BridgeClient::readerLoop() {
+		HANDLE pipe = static_cast< HANDLE >(m_clientPipe);
+		std::string buffer;
+		char chunk[4096];
+
+		while (!m_stopReader) {
+			const bool connected = ConnectNamedPipe(pipe, NULL) || GetLastError() == ERROR_PIPE_CONNECTED;
+
+			if (m_stopReader) {
+				break;
+			}
+			if (!connected) {
+				Sleep(10);
+				continue;
+			}
+
+			DWORD readBytes = 0;
+			while (ReadFile(pipe, chunk, sizeof(chunk), &readBytes, NULL) && readBytes > 0) {
+				buffer.append(chunk, readBytes);
+				processIncoming(buffer);
+			}
+
+			DisconnectNamedPipe(pipe);
+		}
+	}
+#else
+	bool BridgeClient::bridgePipeExists() const {
+		struct stat info;
+
+		return stat(m_bridgePipePath.c_str(), &info) == 0 && S_ISFIFO(info.st_mode);
+	}
+
+	void BridgeClient::openClientPipe() {
+		if (pipe(m_wakeUpPipe) != 0) {
+			throw BridgeException("Unable to create wake-up pipe: " + std::string(std::strerror(errno)));
+		}
+
+		// A predictable path in /tmp could be taken over by anybody, so the pipe lives in a directory of its own
+		// that only we can access
+		std::string directory = "/tmp/.mumble-streamdeck-integration-XXXXXX";
+		if (!mkdtemp(directory.data())) {
+			throw BridgeException("Unable to create the response pipe's directory: "
+								  + std::string(std::strerror(errno)));
+		}
+
+		m_clientPipeDirectory = directory;
+		m_clientPipePath      = directory + "/response";
+
+		if (mkfifo(m_clientPipePath.c_str(), 0600) != 0) {
+			throw BridgeException("Unable to create response pipe: " + std::string(std::strerror(errno)));
+		}
+
+		// Opening for reading and writing prevents both, blocking in open and seeing EOF every time the
+		// bridge closes its end after having written a response.
+		m_clientPipe = open(m_clientPipePath.c_str(), O_RDWR | O_NONBLOCK);
+
+		if (m_clientPipe < 0) {
+			throw BridgeException("Unable to open response pipe: " + std::string(std::strerror(errno)));
+		}
+	}
+
+	void BridgeClient::closeClientPipe() {
+		if (m_readerThread.joinable()) {
+			m_stopReader = true;
+
+			const char wakeUp = 0;
+			while (write(m_wakeUpPipe[1], &wakeUp, 1) < 0 && errno == EINTR) {
+			}
+
+			m_readerThread.join();
+		}
+
+		if (m_clientPipe >= 0) {
+			close(m_clientPipe);
+			m_clientPipe = -1;
+		}
+
+		if (!m_clientPipeDirectory.empty()) {
+			unlink(m_clientPipePath.c_str());
+			rmdir(m_clientPipeDirectory.c_str());
+			m_clientPipeDirectory.clear();
+		}
+
+		for (int &descriptor : m_wakeUpPipe) {
+			if (descriptor >= 0) {
+				close(descriptor);
+				descriptor = -1;
+			}
+		}
+	}
+
+	void BridgeClient::writeToBridge(const std::string &message) {
+		// Opening non-blocking fails immediately (instead of hanging) if nobody is listening on the pipe
+		int pipe = open(m_bridgePipePath.c_str(), O_WRONLY | O_NONBLOCK);
+		if (pipe < 0) {
+			throw BridgeException("Unable to open the bridge's pipe: " + std::string(std::strerror(errno)));
+		}
+
+		// The pipe stays non-blocking, so that a bridge that has stopped reading can't block us forever
+		const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + writeTimeout;
+
+		std::size_t offset = 0;
+		while (offset < message.size()) {
+			const ssize_t written = write(pipe, message.data() + offset, message.size() - offset);
+
+			if (written >= 0) {
+				offset += static_cast< std::size_t >(written);
+				continue;
+			}
+			if (errno == EINTR) {
+				continue;
+			}
+
+			std::string reason;
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				// The pipe is full - wait for the bridge to read from it
+				const auto remaining = std::chrono::duration_cast< std::chrono::milliseconds >(
+					deadline - std::chrono::steady_clock::now());
+				pollfd descriptor = { pipe, POLLOUT, 0 };
+
+				if (remaining.count() > 0) {
+					const int ready = poll(&descriptor, 1, static_cast< int >(remaining.count()));
+					if (ready > 0 || (ready < 0 && errno == EINTR)) {
+						continue;
+					}
+				}
+
+				reason = "the bridge doesn't read from it";
+			} else {
+				reason = std::strerror(errno);
+			}
+
+			close(pipe);
+
+			throw BridgeException("Unable to write to the bridge's pipe: " + reason);
+		}
+
+		close(pipe);
+	}
+
+	void BridgeClient::readerLoop() {
+		std::string buffer;
+		char chunk[4096];
+
+		while (!m_stopReader) {
+			pollfd descriptors[] = { { m_clientPipe, POLLIN, 0 }, { m_wakeUpPipe[0], POLLIN, 0 } };
+
+			// Sleeps until there is something to read or we are asked to stop (see closeClientPipe)
+			if (poll(descriptors, 2, -1) <= 0 || (descriptors[0].revents & POLLIN) == 0) {
+				continue;
+			}
+
+			const ssize_t readBytes = read(m_clientPipe, chunk, sizeof(chunk));
+			if (readBytes > 0) {
+				buffer.append(chunk, static_cast< std::size_t >(readBytes));
+				processIncoming(buffer);
+			}
+		}
+	}
+#endif
+
+}; // namespace StreamDeckIntegration
+}; // namespace Mumble
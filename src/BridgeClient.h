@@ -0,0 +1,210 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#ifndef MUMBLE_STREAMDECK_INTEGRATION_BRIDGECLIENT_H_
+#define MUMBLE_STREAMDECK_INTEGRATION_BRIDGECLIENT_H_
+
+#include <nlohmann/json.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	class BridgeException : public std::exception {
+	private:
+		std::string m_errorMsg;
+
+	public:
+		BridgeException(const std::string &errorMsg) : m_errorMsg(errorMsg) {}
+		BridgeException(const std::string &&errorMsg) : m_errorMsg(std::move(errorMsg)) {}
+
+		const char *what() const noexcept override { return m_errorMsg.c_str(); }
+	};
+
+	/**
+	 * A client for the Mumble JSON bridge that talks to the bridge directly (instead of going through
+	 * the bridge's CLI). The client registers itself with the bridge once and then keeps its session
+	 * (client ID, secret and response pipe) alive for as long as the bridge keeps answering.
+	 *
+	 * Every request is tagged with a unique message ID, which is used to match the bridge's responses
+	 * to the waiting callers. This allows multiple threads to use the same client concurrently. Responses
+	 * that don't carry the message ID are matched to the requests in the order these have been sent.
+	 *
+	 * On POSIX systems, the process has to ignore SIGPIPE (see main.cpp). Otherwise writing to the pipe of
+	 * a bridge that has just gone away terminates the process instead of failing the request.
+	 */
+	class BridgeClient {
+	public:
+		/**
+		 * @param bridgePipePath The path to the named pipe the bridge is listening on. If empty, the
+		 * 	bridge's default location for the current platform is used.
+		 */
+		BridgeClient(const std::string &bridgePipePath = "");
+		~BridgeClient();
+
+		BridgeClient(const BridgeClient &) = delete;
+		BridgeClient &operator=(const BridgeClient &) = delete;
+
+		/**
+		 * Sends the given message to the bridge and waits for the corresponding response. If there
+		 * is no active session yet, this function will register with the bridge first (or fail right away if
+		 * another thread is doing so already).
+		 *
+		 * @param message The serialized JSON message (a JSON object) that shall be sent
+		 * @param timeout How long to wait for the bridge's response
+		 * @returns The bridge's response
+		 *
+		 * @throws BridgeException If the bridge can't be reached or doesn't answer in time. A request that
+		 * 	times out only ends the session if nothing at all has been received from the bridge since it
+		 * 	has been sent (a single slow request must not fail everybody else's).
+		 */
+		nlohmann::json execute(const std::string &message,
+							   std::chrono::milliseconds timeout = std::chrono::milliseconds(2000));
+
+		/**
+		 * Sends all of the given messages to the bridge right away (one after the other, without waiting
+		 * for responses in between) and then waits for all of their responses. Thus the whole batch only
+		 * costs a single round trip.
+		 *
+		 * @param messages The serialized JSON messages (JSON objects) that shall be sent
+		 * @param timeout How long to wait for all of the bridge's responses
+		 * @returns The bridge's responses in the order of the messages
+		 *
+		 * @throws BridgeException If the bridge can't be reached or doesn't answer all messages in time
+		 */
+		std::vector< nlohmann::json > executeAll(const std::vector< std::string > &messages,
+												 std::chrono::milliseconds timeout = std::chrono::milliseconds(2000));
+
+		/**
+		 * @returns Whether there currently is a registered session with the bridge
+		 */
+		bool isConnected() const;
+
+		/**
+		 * Ends the current session (if any). All requests still waiting for a response will fail.
+		 */
+		void disconnect();
+
+		/**
+		 * @returns The path of the bridge's pipe on the current platform
+		 */
+		static std::string defaultBridgePipePath();
+
+	private:
+		struct PendingRequest {
+			std::uint64_t id;
+			std::promise< nlohmann::json > response;
+			/// Whether the request has timed out. Its entry stays until its response arrives, so that responses
+			/// without a message ID are still matched to the right request.
+			bool abandoned = false;
+		};
+
+		std::string m_bridgePipePath;
+		/// The pipe the bridge sends its responses to (created anew for every session, see openClientPipe)
+		std::string m_clientPipePath;
+
+		// Serializes session setup and teardown. It isn't held while waiting for the bridge to accept the
+		// registration.
+		std::mutex m_sessionMutex;
+		std::atomic_bool m_connected = { false };
+		/// Whether a registration is waiting for the bridge's answer (guarded by m_sessionMutex)
+		bool m_connecting = false;
+		/// Changes whenever a session ends (guarded by m_sessionMutex)
+		std::uint64_t m_session = 0;
+		std::uint64_t m_clientID     = 0;
+		std::string m_secret;
+		/// After a failed attempt to connect, no new attempt is made before this point in time
+		std::chrono::steady_clock::time_point m_retryAfter;
+
+		// Requests that are waiting for their response (in the order they have been sent), including the ones
+		// that have timed out but whose response is still outstanding
+		std::mutex m_pendingMutex;
+		std::deque< PendingRequest > m_pending;
+		std::uint64_t m_nextMessageID = 1;
+		// The registration's response doesn't carry a message ID, so it is kept apart from the requests
+		// (guarded by m_pendingMutex as well)
+		bool m_registering = false;
+		std::promise< nlohmann::json > m_registration;
+		/// The number of responses to requests that have been received (used to tell a slow bridge from a dead one)
+		std::atomic< std::uint64_t > m_receivedCount = { 0 };
+		// Held from queuing a request until it has been written to the bridge's pipe, so that the requests reach
+		// the bridge in the order of m_pending (which is what responses without a message ID rely on). It is
+		// always taken after m_sessionMutex.
+		std::mutex m_writeMutex;
+
+		std::thread m_readerThread;
+		std::atomic_bool m_stopReader = { false };
+#ifdef _WIN32
+		void *m_clientPipe = nullptr;
+#else
+		int m_clientPipe = -1;
+		/// The private directory the response pipe lives in
+		std::string m_clientPipeDirectory;
+		/// Written to in order to wake up the reader thread when it is asked to stop
+		int m_wakeUpPipe[2] = { -1, -1 };
+#endif
+
+		/**
+		 * Registers with the bridge. Fails right away if the bridge's pipe doesn't exist, the previous
+		 * attempt has failed only a moment ago or another registration is still in progress, so that a
+		 * missing or slow bridge costs next to nothing.
+		 *
+		 * @param sessionLock The lock on m_sessionMutex. It is released while waiting for the bridge's answer.
+		 *
+		 * @throws BridgeException If the registration fails for whatever reason
+		 */
+		void connect(std::unique_lock< std::mutex > &sessionLock);
+		void disconnectLocked();
+		/**
+		 * Stops waiting for the registration's response
+		 */
+		void endRegistration();
+
+		std::future< nlohmann::json > enqueue(std::uint64_t &messageID);
+		/**
+		 * Sends the given message (registering first, if necessary) without waiting for the response
+		 *
+		 * @returns The ID the message has been sent with
+		 */
+		std::uint64_t submit(const std::string &message, std::future< nlohmann::json > &response);
+		/**
+		 * Stops waiting for the response to the given request. The response is discarded once it arrives.
+		 */
+		void dropPending(std::uint64_t messageID);
+		/**
+		 * Handles a request that hasn't been answered in time. The session is only ended if the bridge
+		 * hasn't sent anything since the request has been made.
+		 *
+		 * @param receivedBefore The value of m_receivedCount before the request has been sent
+		 */
+		void handleTimeout(std::uint64_t receivedBefore);
+		void failAllPending(const std::string &reason);
+
+		/**
+		 * @returns Whether the bridge's pipe exists (i.e. whether the bridge may be running)
+		 */
+		bool bridgePipeExists() const;
+		void openClientPipe();
+		void closeClientPipe();
+		void writeToBridge(const std::string &message);
+		void readerLoop();
+		void processIncoming(std::string &buffer);
+		void dispatchResponse(nlohmann::json response);
+	};
+
+};     // namespace StreamDeckIntegration
+};     // namespace Mumble
+#endif // MUMBLE_STREAMDECK_INTEGRATION_BRIDGECLIENT_H_
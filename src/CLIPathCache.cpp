@@ -0,0 +1,92 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#include "CLIPathCache.h"
+
+#include <boost/process/search_path.hpp>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	namespace {
+		std::time_t lastWriteTime(const boost::filesystem::path &path) {
+			boost::system::error_code ec;
+			std::time_t time = boost::filesystem::last_write_time(path, ec);
+
+			return ec ? 0 : time;
+		}
+
+		/// How long to wait before searching PATH again after the executable couldn't be found
+		constexpr std::chrono::milliseconds missingRetryInterval(2000);
+	} // namespace
+
+	CLIPathCache::CLIPathCache(const std::string &executableName) : m_executableName(executableName) {
+		std::lock_guard< std::mutex > guard(m_mutex);
+
+		resolveLocked();
+	}
+
+	boost::filesystem::path CLIPathCache::get() {
+		std::lock_guard< std::mutex > guard(m_mutex);
+
+		if (m_cachedPath.empty() && std::chrono::steady_clock::now() >= m_retryAfter) {
+			resolveLocked();
+		}
+
+		return m_cachedPath;
+	}
+
+	void CLIPathCache::setOverride(const boost::filesystem::path &path) {
+		std::lock_guard< std::mutex > guard(m_mutex);
+
+		if (path == m_override) {
+			return;
+		}
+
+		m_override = path;
+		resolveLocked();
+	}
+
+	void CLIPathCache::invalidate() {
+		std::lock_guard< std::mutex > guard(m_mutex);
+
+		m_cachedPath.clear();
+		m_cachedWriteTime = 0;
+		m_retryAfter      = {};
+	}
+
+	bool CLIPathCache::invalidateIfChanged() {
+		std::lock_guard< std::mutex > guard(m_mutex);
+
+		if (m_cachedPath.empty()) {
+			return false;
+		}
+
+		if (!boost::filesystem::exists(m_cachedPath) || lastWriteTime(m_cachedPath) != m_cachedWriteTime) {
+			m_cachedPath.clear();
+			m_cachedWriteTime = 0;
+
+			return true;
+		}
+
+		return false;
+	}
+
+	const std::string &CLIPathCache::executableName() const { return m_executableName; }
+
+	void CLIPathCache::resolveLocked() {
+		if (!m_override.empty()) {
+			m_cachedPath = m_override;
+		} else {
+			m_cachedPath = boost::process::search_path(m_executableName);
+		}
+
+		m_cachedWriteTime = m_cachedPath.empty() ? 0 : lastWriteTime(m_cachedPath);
+		m_retryAfter      = m_cachedPath.empty() ? std::chrono::steady_clock::now() + missingRetryInterval
+										 : std::chrono::steady_clock::time_point();
+	}
+
+}; // namespace StreamDeckIntegration
+}; // namespace Mumble
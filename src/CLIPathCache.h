@@ -0,0 +1,77 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#ifndef MUMBLE_STREAMDECK_INTEGRATION_CLIPATHCACHE_H_
+#define MUMBLE_STREAMDECK_INTEGRATION_CLIPATHCACHE_H_
+
+#include <boost/filesystem.hpp>
+
+#include <chrono>
+#include <ctime>
+#include <mutex>
+#include <string>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	/**
+	 * Caches the location of an executable so that PATH doesn't have to be searched every time the
+	 * executable is needed. The cached location stays valid until it is explicitly invalidated (e.g.
+	 * because launching the executable failed). If the executable can't be found, PATH isn't searched
+	 * again for a moment either.
+	 */
+	class CLIPathCache {
+	public:
+		/**
+		 * @param executableName The name of the executable to search for in PATH
+		 */
+		CLIPathCache(const std::string &executableName);
+
+		/**
+		 * @returns The path to the executable or an empty path, if it can't be found (or couldn't be found
+		 * 	a moment ago)
+		 */
+		boost::filesystem::path get();
+
+		/**
+		 * Sets an explicit path that will be used instead of searching PATH
+		 *
+		 * @param path The path to use. An empty path removes the override.
+		 */
+		void setOverride(const boost::filesystem::path &path);
+
+		/**
+		 * Drops the cached path. The next call to get() will resolve it again.
+		 */
+		void invalidate();
+
+		/**
+		 * Drops the cached path, if the file it points to has changed (or vanished) since it has been resolved.
+		 *
+		 * @returns Whether the cache has been invalidated
+		 */
+		bool invalidateIfChanged();
+
+		/**
+		 * @returns The name of the executable this cache is for
+		 */
+		const std::string &executableName() const;
+
+	private:
+		std::string m_executableName;
+
+		std::mutex m_mutex;
+		boost::filesystem::path m_override;
+		boost::filesystem::path m_cachedPath;
+		std::time_t m_cachedWriteTime = 0;
+		/// After the executable couldn't be found, PATH isn't searched again before this point in time
+		std::chrono::steady_clock::time_point m_retryAfter;
+
+		void resolveLocked();
+	};
+
+};     // namespace StreamDeckIntegration
+};     // namespace Mumble
+#endif // MUMBLE_STREAMDECK_INTEGRATION_CLIPATHCACHE_H_
@@ -0,0 +1,155 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#include "ChannelUserCountCache.h"
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	ChannelUserCounts ChannelUserCounts::fromResponse(const nlohmann::json &response) {
+		const nlohmann::json &channels = response.at("response").at("channels");
+
+		ChannelUserCounts result;
+		for (auto it = channels.begin(); it != channels.end(); ++it) {
+			result.counts[it.key()] = it.value().get< unsigned int >();
+		}
+
+		return result;
+	}
+
+	void ChannelUserCountCache::subscribe(ContextHandle context, const std::string &channel) {
+		auto it = m_subscribers.find(context);
+		if (it == m_subscribers.end()) {
+			it = m_subscribers.emplace(context, Subscriber()).first;
+		} else if (it->second.channel != channel) {
+			removeChannel(it->second.channel);
+		} else {
+			it->second.displayKnown = false;
+			return;
+		}
+
+		it->second.channel      = channel;
+		it->second.displayKnown = false;
+
+		if (m_channels[channel].subscribers++ == 0) {
+			m_query.reset();
+		}
+	}
+
+	void ChannelUserCountCache::unsubscribe(ContextHandle context) {
+		auto it = m_subscribers.find(context);
+		if (it == m_subscribers.end()) {
+			return;
+		}
+
+		removeChannel(it->second.channel);
+		m_subscribers.erase(it);
+	}
+
+	bool ChannelUserCountCache::isSubscribed(ContextHandle context) const {
+		return m_subscribers.find(context) != m_subscribers.end();
+	}
+
+	bool ChannelUserCountCache::hasSubscribers() const { return !m_subscribers.empty(); }
+
+	void ChannelUserCountCache::invalidate(ContextHandle context) {
+		auto it = m_subscribers.find(context);
+
+		if (it != m_subscribers.end()) {
+			it->second.displayKnown = false;
+		}
+	}
+
+	std::shared_ptr< const std::string > ChannelUserCountCache::query() {
+		if (m_query) {
+			return m_query;
+		}
+
+		nlohmann::json channels = nlohmann::json::array();
+		for (auto &current : m_channels) {
+			channels.push_back(current.first);
+			current.second.queried = true;
+		}
+
+		// NOTE: The bridge's documented operations don't include a way to query user counts yet. This assumes an
+		// operation that takes the names of the channels and answers with the number of users in every one of them
+		// that exists ({"channels": {"<name>": <count>}}). A bridge that doesn't know it answers with an error,
+		// which suspends the queries for a while (see MumblePlugin::handleUserCountResponse).
+		// clang-format off
+		m_query = std::make_shared< const std::string >(nlohmann::json({
+			{ "message_type", "operation" },
+			{
+				"message", {
+					{ "operation", "get_channel_user_counts" },
+					{ "parameter", {
+									   { "channels", std::move(channels) }
+								   }
+					}
+				}
+			}
+		}).dump());
+		// clang-format on
+
+		return m_query;
+	}
+
+	std::vector< std::pair< ContextHandle, std::string > >
+		ChannelUserCountCache::update(const ChannelUserCounts &counts) {
+		std::vector< std::pair< ContextHandle, std::string > > changes;
+
+		for (auto &current : m_subscribers) {
+			Subscriber &subscriber = current.second;
+
+			auto channel = m_channels.find(subscriber.channel);
+			if (channel == m_channels.end() || !channel->second.queried) {
+				continue;
+			}
+
+			auto count              = counts.counts.find(subscriber.channel);
+			const std::string title = count != counts.counts.end() ? std::to_string(count->second) : std::string();
+
+			if (!subscriber.displayKnown || subscriber.displayed != title) {
+				subscriber.displayKnown = true;
+				subscriber.displayed    = title;
+
+				changes.emplace_back(current.first, title);
+			}
+		}
+
+		return changes;
+	}
+
+	bool ChannelUserCountCache::beginQuery() {
+		if (m_queryRunning) {
+			m_queryAgain = true;
+
+			return false;
+		}
+
+		m_queryRunning = true;
+
+		return true;
+	}
+
+	bool ChannelUserCountCache::endQuery() {
+		m_queryRunning = false;
+
+		const bool again = m_queryAgain;
+		m_queryAgain     = false;
+
+		return again;
+	}
+
+	void ChannelUserCountCache::removeChannel(const std::string &channel) {
+		auto it = m_channels.find(channel);
+
+		if (it != m_channels.end() && --it->second.subscribers == 0) {
+			m_channels.erase(it);
+			m_query.reset();
+		}
+	}
+
+}; // namespace StreamDeckIntegration
+}; // namespace Mumble
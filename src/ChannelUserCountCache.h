@@ -0,0 +1,115 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#ifndef MUMBLE_STREAMDECK_INTEGRATION_CHANNELUSERCOUNTCACHE_H_
+#define MUMBLE_STREAMDECK_INTEGRATION_CHANNELUSERCOUNTCACHE_H_
+
+#include "IDTable.h"
+
+#include <nlohmann/json.hpp>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	/**
+	 * The number of users in some of Mumble's channels
+	 */
+	struct ChannelUserCounts {
+		/// The number of users keyed by the channels' names (channels that don't exist are missing)
+		std::unordered_map< std::string, unsigned int > counts;
+
+		/**
+		 * Extracts the counts from the bridge's response to a query made by ChannelUserCountCache
+		 *
+		 * @throws nlohmann::json::exception If the response doesn't have the expected format
+		 */
+		static ChannelUserCounts fromResponse(const nlohmann::json &response);
+	};
+
+	/**
+	 * Keeps track of which buttons display the number of users in which channel. All buttons are served by a
+	 * single query to the bridge (that asks for every channel only once, no matter how many buttons display
+	 * it) and only the buttons whose count has actually changed are updated.
+	 */
+	class ChannelUserCountCache {
+	public:
+		/**
+		 * Registers the given context as displaying the number of users in the given channel
+		 */
+		void subscribe(ContextHandle context, const std::string &channel);
+		void unsubscribe(ContextHandle context);
+		bool isSubscribed(ContextHandle context) const;
+		bool hasSubscribers() const;
+
+		/**
+		 * Marks what the given context displays as unknown, so it will be part of the next update
+		 */
+		void invalidate(ContextHandle context);
+
+		/**
+		 * @returns The query for the counts of all channels that are displayed. It is only rebuilt when the set
+		 * 	of displayed channels has changed.
+		 */
+		std::shared_ptr< const std::string > query();
+
+		/**
+		 * Stores the given counts. Buttons displaying a channel that has been added after the query has been
+		 * made are left alone.
+		 *
+		 * @returns The contexts whose displayed count has changed together with the title they should display now
+		 * 	(empty if the channel doesn't exist)
+		 */
+		std::vector< std::pair< ContextHandle, std::string > > update(const ChannelUserCounts &counts);
+
+		/**
+		 * Has to be called before querying the counts. Makes sure only one query is running at a time.
+		 *
+		 * @returns Whether a query should be started. If false, a query is running already and it will be
+		 * 	repeated once it has finished.
+		 */
+		bool beginQuery();
+		/**
+		 * Has to be called once a query has finished
+		 *
+		 * @returns Whether the query has to be repeated as the counts have been requested again in the meantime
+		 */
+		bool endQuery();
+
+	private:
+		struct Channel {
+			/// The number of buttons displaying the channel
+			std::size_t subscribers = 0;
+			/// Whether the channel is part of the current query
+			bool queried = false;
+		};
+
+		struct Subscriber {
+			std::string channel;
+			bool displayKnown = false;
+			std::string displayed;
+		};
+
+		/// Ordered, so that the query doesn't depend on the order the buttons have appeared in
+		std::map< std::string, Channel > m_channels;
+		std::unordered_map< ContextHandle, Subscriber > m_subscribers;
+		/// Null if the set of channels has changed since it has been built
+		std::shared_ptr< const std::string > m_query;
+
+		bool m_queryRunning = false;
+		bool m_queryAgain   = false;
+
+		void removeChannel(const std::string &channel);
+	};
+
+};     // namespace StreamDeckIntegration
+};     // namespace Mumble
+#endif // MUMBLE_STREAMDECK_INTEGRATION_CHANNELUSERCOUNTCACHE_H_
@@ -7,27 +7,159 @@
 // which was published under the MIT license.
 
 #include "ConnectionManager.h"
+#include "InboundMessage.h"
 #include "Utils.h"
 
 #include "StreamDeckPlugin.h"
 
+#include <boost/asio/post.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+
 namespace Mumble {
 namespace StreamDeckIntegration {
 
-	void ConnectionManager::onOpen(WebsocketClient *client, websocketpp::connection_hdl connectionHandler) {
-		// Register plugin with StreamDeck
-		nlohmann::json jsonObject;
-		jsonObject["event"] = m_registerEvent;
-		jsonObject["uuid"]  = m_pluginUUID;
+	namespace {
+		using Clock = std::chrono::steady_clock;
+
+		constexpr std::chrono::minutes metricsDumpInterval(5);
+
+		constexpr std::chrono::milliseconds initialReconnectDelay(100);
+		constexpr std::chrono::milliseconds maxReconnectDelay(5000);
+		/// How long to keep on trying to (re-)connect. If the Stream Deck software is restarted, it starts a new
+		/// instance of the plugin anyway.
+		constexpr std::chrono::seconds reconnectTimeout(60);
+
+		/// The number of messages that are buffered while there is no connection
+		constexpr std::size_t maxOutboxSize = 512;
+
+		/**
+		 * The events received from the Stream Deck that we care about
+		 */
+		enum class Event {
+			Unknown,
+			KeyDown,
+			KeyUp,
+			WillAppear,
+			WillDisappear,
+			DidReceiveSettings,
+			PropertyInspectorDidDisappear,
+			DeviceDidConnect,
+			DeviceDidDisconnect,
+			DidReceiveGlobalSettings,
+			SendToPlugin,
+			SystemDidWakeUp
+		};
+
+		Event parseEvent(std::string_view name) {
+			Event event;
+			const char *expectedName;
+
+			// The cases are computed at compile time (and the compiler would complain about collisions)
+			switch (Utils::hash(name)) {
+				case Utils::hash(kESDSDKEventKeyDown):
+					event        = Event::KeyDown;
+					expectedName = kESDSDKEventKeyDown;
+					break;
+				case Utils::hash(kESDSDKEventKeyUp):
+					event        = Event::KeyUp;
+					expectedName = kESDSDKEventKeyUp;
+					break;
+				case Utils::hash(kESDSDKEventWillAppear):
+					event        = Event::WillAppear;
+					expectedName = kESDSDKEventWillAppear;
+					break;
+				case Utils::hash(kESDSDKEventWillDisappear):
+					event        = Event::WillDisappear;
+					expectedName = kESDSDKEventWillDisappear;
+					break;
+				case Utils::hash(kESDSDKEventDidReceiveSettings):
+					event        = Event::DidReceiveSettings;
+					expectedName = kESDSDKEventDidReceiveSettings;
+					break;
+				case Utils::hash(kESDSDKEventPropertyInspectorDidDisappear):
+					event        = Event::PropertyInspectorDidDisappear;
+					expectedName = kESDSDKEventPropertyInspectorDidDisappear;
+					break;
+				case Utils::hash(kESDSDKEventDeviceDidConnect):
+					event        = Event::DeviceDidConnect;
+					expectedName = kESDSDKEventDeviceDidConnect;
+					break;
+				case Utils::hash(kESDSDKEventDeviceDidDisconnect):
+					event        = Event::DeviceDidDisconnect;
+					expectedName = kESDSDKEventDeviceDidDisconnect;
+					break;
+				case Utils::hash(kESDSDKEventDidReceiveGlobalSettings):
+					event        = Event::DidReceiveGlobalSettings;
+					expectedName = kESDSDKEventDidReceiveGlobalSettings;
+					break;
+				case Utils::hash(kESDSDKEventSendToPlugin):
+					event        = Event::SendToPlugin;
+					expectedName = kESDSDKEventSendToPlugin;
+					break;
+				case Utils::hash(kESDSDKEventSystemDidWakeUp):
+					event        = Event::SystemDidWakeUp;
+					expectedName = kESDSDKEventSystemDidWakeUp;
+					break;
+				default:
+					return Event::Unknown;
+			}
 
-		websocketpp::lib::error_code ec;
-		m_websocket.send(m_connectionHandle, jsonObject.dump(), websocketpp::frame::opcode::text, ec);
+			// An unknown event might happen to have the same hash as one we know
+			return name == expectedName ? event : Event::Unknown;
+		}
+	} // namespace
+
+	void ConnectionManager::onOpen(WebsocketClient *client, websocketpp::connection_hdl connectionHandler) {
+		// Register plugin with StreamDeck (this has to happen before anything else is sent)
+		transmit(m_writer.registerPlugin(m_registerEvent, m_pluginUUID));
 
 		// Apparently the first message that gets written to the log gets lost somewhere on Elgato's end
 		// (only causes the log file to be created).
-		// Thus we make sure to log an unnecessary thing right here at the beginning. We don't want it
-		// to be jibberish though in case it does end up in the log after all.
-		api_logMessage("Mumble StreamDeckIntegration is running");
+		// Thus we make sure to log an unnecessary thing right here at the beginning (bypassing the logger,
+		// so the message is not batched with anything important). We don't want it to be jibberish though
+		// in case it does end up in the log after all.
+		transmit(m_writer.logMessage("Mumble StreamDeckIntegration is running"));
+
+		m_connected      = true;
+		m_reconnecting   = false;
+		m_reconnectDelay = initialReconnectDelay;
+
+		// Ask for the global settings so that they are applied right from the start
+		api_getGlobalSettings();
+
+		if (m_hasBeenConnected) {
+			// Only what has piled up in the meantime has to be sent (the Stream Deck still knows about
+			// everything else)
+			const std::size_t sentBefore = m_transmittedCount;
+			const std::size_t dropped    = m_outboxDroppedCount;
+
+			flushOutbox();
+			flushUpdates();
+
+			const std::size_t resent                    = m_transmittedCount - sentBefore;
+			const std::chrono::nanoseconds recoveryTime = Clock::now() - m_disconnectedAt;
+
+			m_metrics.record({}, Metrics::Stage::Reconnect, recoveryTime);
+			for (std::size_t i = 0; i < resent; ++i) {
+				m_metrics.increment({}, Metrics::Counter::Resent);
+			}
+			m_outboxDroppedCount = 0;
+
+			log(LogLevel::Info,
+				"Reconnected to the Stream Deck after "
+					+ std::to_string(std::chrono::duration_cast< std::chrono::milliseconds >(recoveryTime).count())
+					+ " ms (resent " + std::to_string(resent) + " messages, dropped " + std::to_string(dropped)
+					+ ")");
+
+			m_plugin.didReconnect();
+		}
+		m_hasBeenConnected = true;
+
+		scheduleMetricsDump();
 	}
 
 	void ConnectionManager::onFail(WebsocketClient *client, websocketpp::connection_hdl connectionHandler) {
@@ -39,60 +171,188 @@ namespace StreamDeckIntegration {
 				reason = connection->get_ec().message();
 			}
 		}
+
+		static LogRateLimit rateLimit;
+		log(LogLevel::Warning, "Connecting to the Stream Deck failed: " + reason, rateLimit);
+
+		connectionLost();
 	}
 
 	void ConnectionManager::onClose(WebsocketClient *client, websocketpp::connection_hdl connectionHandler) {
 		std::string reason;
+		websocketpp::close::status::value code = websocketpp::close::status::abnormal_close;
 
 		if (client != nullptr) {
 			WebsocketClient::connection_ptr connection = client->get_con_from_hdl(connectionHandler);
 			if (connection != NULL) {
 				reason = connection->get_remote_close_reason();
+				code   = connection->get_remote_close_code();
 			}
 		}
+
+		if (code == websocketpp::close::status::normal || code == websocketpp::close::status::going_away) {
+			// The Stream Deck closed the connection on purpose (e.g. because it is quitting) -> so do we
+			m_connected = false;
+			m_websocket.stop();
+			return;
+		}
+
+		static LogRateLimit rateLimit;
+		log(LogLevel::Warning,
+			"The connection to the Stream Deck has been lost (" + std::to_string(code) + "): " + reason, rateLimit);
+
+		connectionLost();
+	}
+
+	void ConnectionManager::connect() {
+		websocketpp::lib::error_code ec;
+		std::string uri                            = "ws://127.0.0.1:" + std::to_string(m_port);
+		WebsocketClient::connection_ptr connection = m_websocket.get_connection(uri, ec);
+		if (ec) {
+			connectionLost();
+			return;
+		}
+
+		m_connectionHandle = connection->get_handle();
+
+		// Note that connect here only requests a connection. No network messages are
+		// exchanged until the event loop processes the request.
+		m_websocket.connect(connection);
+	}
+
+	void ConnectionManager::connectionLost() {
+		m_connected = false;
+
+		if (!m_reconnecting) {
+			// The connection has just been lost (or the initial attempt to connect failed)
+			m_reconnecting   = true;
+			m_disconnectedAt = Clock::now();
+		}
+
+		if (Clock::now() - m_disconnectedAt > reconnectTimeout) {
+			log(LogLevel::Error, "Unable to reach the Stream Deck - giving up");
+			m_websocket.stop();
+			return;
+		}
+
+		if (!m_reconnectTimer) {
+			m_reconnectTimer = std::make_unique< boost::asio::steady_timer >(getIOService());
+		}
+
+		// Exponential backoff with jitter (so that several plugins don't reconnect in lockstep)
+		std::uniform_int_distribution< std::chrono::milliseconds::rep > jitter(0, m_reconnectDelay.count() / 2);
+		const std::chrono::milliseconds delay(m_reconnectDelay.count() / 2 + jitter(m_random));
+		m_reconnectDelay = std::min(m_reconnectDelay * 2, maxReconnectDelay);
+
+		m_reconnectTimer->expires_after(delay);
+		m_reconnectTimer->async_wait([this](const boost::system::error_code &ec) {
+			if (!ec) {
+				connect();
+			}
+		});
 	}
 
 	void ConnectionManager::onMessage(websocketpp::connection_hdl, WebsocketClient::message_ptr msg) {
 		if (msg != NULL && msg->get_opcode() == websocketpp::frame::opcode::text) {
-			std::string message = msg->get_payload();
-
-			try {
-				nlohmann::json receivedJson = nlohmann::json::parse(message);
-
-				std::string event      = Utils::getStringByName(receivedJson, kESDSDKCommonEvent);
-				std::string context    = Utils::getStringByName(receivedJson, kESDSDKCommonContext);
-				std::string action     = Utils::getStringByName(receivedJson, kESDSDKCommonAction);
-				std::string deviceID   = Utils::getStringByName(receivedJson, kESDSDKCommonDevice);
-				nlohmann::json payload = Utils::getObjectByName(receivedJson, kESDSDKCommonPayload);
-
-				if (event == kESDSDKEventKeyDown) {
-					m_plugin.keyDownForAction(action, context, payload, deviceID);
-				} else if (event == kESDSDKEventKeyUp) {
-					m_plugin.keyUpForAction(action, context, payload, deviceID);
-				} else if (event == kESDSDKEventWillAppear) {
-					m_plugin.willAppearForAction(action, context, payload, deviceID);
-				} else if (event == kESDSDKEventWillDisappear) {
-					m_plugin.willDisappearForAction(action, context, payload, deviceID);
-				} else if (event == kESDSDKEventDeviceDidConnect) {
-					nlohmann::json deviceInfo = Utils::getObjectByName(receivedJson, kESDSDKCommonDeviceInfo);
-					m_plugin.deviceDidConnect(deviceID, deviceInfo);
-				} else if (event == kESDSDKEventDeviceDidDisconnect) {
-					m_plugin.deviceDidDisconnect(deviceID);
-				} else if (event == kESDSDKEventDidReceiveGlobalSettings) {
-					const nlohmann::json settings = Utils::getObjectByName(payload, kESDSDKPayloadSettings);
-					m_plugin.receivedGlobalSettings(settings);
-				} else if (event == kESDSDKEventSendToPlugin) {
-					m_plugin.receivedData(payload, context);
+			dispatch(msg->get_payload());
+		}
+	}
+
+	void ConnectionManager::dispatch(std::string_view serialized) {
+		const Clock::time_point received = Clock::now();
+
+		try {
+			// Only the parts of the message that are actually needed are parsed (straight from the
+			// websocket's buffer)
+			const InboundMessage message(serialized);
+
+			const Event event           = parseEvent(message.event());
+			const ContextHandle context = m_contexts.intern(message.context());
+			const DeviceHandle device   = m_devices.intern(message.device());
+			const LazyJSON &payload     = message.payload();
+			const ActionHandle action   = m_actions.intern(message.action());
+
+			if (context.isValid() && action.isValid()) {
+				if (context.value >= m_contextActions.size()) {
+					m_contextActions.resize(context.value + 1);
 				}
-			} catch (...) {
-				reportError("Connection Manager encountered unexpected exception during event processing");
+				m_contextActions[context.value] = action;
+			}
+
+			// Only the time it takes to get here is ours, the rest is up to the plugin's handler
+			m_metrics.record(action, Metrics::Stage::ReceiveToDispatch, Clock::now() - received);
+
+			switch (event) {
+				case Event::KeyDown:
+					// Pressing a button with multiple states makes the Stream Deck advance its state
+					// on its own, so we no longer know what state it is in.
+					m_outboundQueue.invalidate(context, OutboundQueue::Kind::State);
+					m_plugin.keyDownForAction(action, context, payload, device);
+					break;
+				case Event::KeyUp:
+					m_outboundQueue.invalidate(context, OutboundQueue::Kind::State);
+					m_plugin.keyUpForAction(action, context, payload, device);
+					break;
+				case Event::WillAppear:
+					m_plugin.willAppearForAction(action, context, payload, device);
+					break;
+				case Event::WillDisappear:
+					m_outboundQueue.forget(context);
+					m_plugin.willDisappearForAction(action, context, payload, device);
+					break;
+				case Event::DidReceiveSettings:
+					m_plugin.didReceiveSettings(action, context, payload, device);
+					break;
+				case Event::PropertyInspectorDidDisappear:
+					m_plugin.propertyInspectorDidDisappear(action, context, device);
+					break;
+				case Event::DeviceDidConnect:
+					m_plugin.deviceDidConnect(device, message.deviceInfo());
+					break;
+				case Event::DeviceDidDisconnect:
+					m_plugin.deviceDidDisconnect(device);
+					break;
+				case Event::DidReceiveGlobalSettings:
+					m_plugin.receivedGlobalSettings(Utils::getObjectByName(payload.get(), kESDSDKPayloadSettings));
+					break;
+				case Event::SendToPlugin:
+					m_plugin.receivedData(payload.get(), context);
+					break;
+				case Event::SystemDidWakeUp:
+					m_plugin.systemDidWakeUp();
+					break;
+				case Event::Unknown:
+					break;
 			}
+		} catch (...) {
+			reportError("Connection Manager encountered unexpected exception during event processing");
 		}
 	}
 
 	ConnectionManager::ConnectionManager(int port, const std::string &pluguUID, const std::string &registerEvent,
 										 const std::string &info, StreamDeckPlugin &plugin)
-		: m_port(port), m_pluginUUID(pluguUID), m_registerEvent(registerEvent), m_plugin(plugin) {
+		: m_port(port), m_pluginUUID(pluguUID), m_registerEvent(registerEvent), m_plugin(plugin),
+		  m_logger([this](const std::string &batch) {
+			  // Called on the logger's thread -> the actual sending has to happen on the event loop
+			  std::lock_guard< std::mutex > guard(m_pendingLogMutex);
+
+			  if (!m_running) {
+				  // E.g. the logger's last flush while shutting down
+				  std::cerr << batch << std::endl;
+				  return;
+			  }
+
+			  // Batches that arrive before the event loop has gotten around to sending are sent together
+			  const bool sendPosted = !m_pendingLog.empty();
+			  if (sendPosted) {
+				  m_pendingLog += '\n';
+			  }
+			  m_pendingLog += batch;
+
+			  if (!sendPosted) {
+				  post([this]() { sendPendingLog(); });
+			  }
+		  }) {
 		plugin.setConnectionManager(this);
 	}
 
@@ -116,162 +376,271 @@ namespace StreamDeckIntegration {
 																   websocketpp::lib::placeholders::_1,
 																   websocketpp::lib::placeholders::_2));
 
-			websocketpp::lib::error_code ec;
-			std::string uri                            = "ws://127.0.0.1:" + std::to_string(m_port);
-			WebsocketClient::connection_ptr connection = m_websocket.get_connection(uri, ec);
-			if (ec) {
-				return;
-			}
+			m_random.seed(std::random_device()());
+			m_reconnectDelay = initialReconnectDelay;
 
-			m_connectionHandle = connection->get_handle();
+			connect();
 
-			// Note that connect here only requests a connection. No network messages are
-			// exchanged until the event loop starts running in the next line.
-			m_websocket.connect(connection);
+			m_running = true;
 
-			// Start the ASIO io_service run loop
-			// this will cause a single connection to be made to the server. m_websocket.run()
-			// will exit when this connection is closed.
+			// Start the ASIO io_service run loop. If the connection is lost, it is re-established in the
+			// background, so m_websocket.run() only exits once the Stream Deck closes the connection on purpose
+			// or can't be reached anymore.
+			m_websocket.start_perpetual();
 			m_websocket.run();
 		} catch (websocketpp::exception const &) {
 		}
+
+		std::lock_guard< std::mutex > guard(m_pendingLogMutex);
+		m_running = false;
+
+		// The event loop won't send these anymore
+		if (!m_pendingLog.empty()) {
+			std::cerr << m_pendingLog << std::endl;
+			m_pendingLog.clear();
+		}
+	}
+
+	void ConnectionManager::reportError(const std::string &errorMessage, ContextHandle context) {
+		reportError(errorMessage, context, nullptr);
+	}
+
+	void ConnectionManager::reportError(const std::string &errorMessage, ContextHandle context,
+										LogRateLimit &rateLimit) {
+		reportError(errorMessage, context, &rateLimit);
 	}
 
-	void ConnectionManager::reportError(const std::string &errorMessage, const std::string &context) {
+	void ConnectionManager::reportError(const std::string &errorMessage, ContextHandle context,
+										LogRateLimit *rateLimit) {
+		m_metrics.increment(actionOf(context), Metrics::Counter::Errors);
+
 		// Log the error message
-		api_logMessage("Mumble plugin error: " + errorMessage);
+		std::string message = "Mumble plugin error: " + errorMessage;
+		if (rateLimit) {
+			log(LogLevel::Error, std::move(message), *rateLimit);
+		} else {
+			log(LogLevel::Error, std::move(message));
+		}
 
-		if (context.size() > 0) {
+		if (context.isValid()) {
 			// Also show an alert for the given context
 			api_showAlertForContext(context);
 		}
 	}
 
-	void ConnectionManager::api_setTitle(const std::string &title, const std::string &context, ESDSDKTarget target) {
-		nlohmann::json jsonObject;
+	void ConnectionManager::post(std::function< void() > handler) {
+		boost::asio::post(m_websocket.get_io_service(), std::move(handler));
+	}
 
-		jsonObject[kESDSDKCommonEvent]   = kESDSDKEventSetTitle;
-		jsonObject[kESDSDKCommonContext] = context;
+	boost::asio::io_service &ConnectionManager::getIOService() { return m_websocket.get_io_service(); }
 
-		nlohmann::json payload;
-		payload[kESDSDKPayloadTarget]    = target;
-		payload[kESDSDKPayloadTitle]     = title;
-		jsonObject[kESDSDKCommonPayload] = payload;
+	void ConnectionManager::log(LogLevel level, std::string message) { m_logger.log(level, std::move(message)); }
 
-		websocketpp::lib::error_code ec;
-		m_websocket.send(m_connectionHandle, jsonObject.dump(), websocketpp::frame::opcode::text, ec);
+	void ConnectionManager::log(LogLevel level, std::string message, LogRateLimit &rateLimit) {
+		m_logger.log(level, std::move(message), rateLimit);
 	}
 
-	void ConnectionManager::api_setImage(const std::string &base64ImageString, const std::string &context,
-										 ESDSDKTarget target) {
-		nlohmann::json jsonObject;
+	Logger &ConnectionManager::getLogger() { return m_logger; }
 
-		jsonObject[kESDSDKCommonEvent]   = kESDSDKEventSetImage;
-		jsonObject[kESDSDKCommonContext] = context;
+	ActionHandle ConnectionManager::getActionHandle(std::string_view actionID) { return m_actions.intern(actionID); }
 
-		nlohmann::json payload;
-		payload[kESDSDKPayloadTarget] = target;
-		const std::string prefix      = "data:image/png;base64,";
-		if (base64ImageString.empty() || base64ImageString.substr(0, prefix.length()).find(prefix) == 0)
-			payload[kESDSDKPayloadImage] = base64ImageString;
-		else
-			payload[kESDSDKPayloadImage] = "data:image/png;base64," + base64ImageString;
-		jsonObject[kESDSDKCommonPayload] = payload;
+	const std::string &ConnectionManager::getActionID(ActionHandle action) const { return m_actions.get(action); }
 
-		websocketpp::lib::error_code ec;
-		m_websocket.send(m_connectionHandle, jsonObject.dump(), websocketpp::frame::opcode::text, ec);
+	const std::string &ConnectionManager::getContextID(ContextHandle context) const { return m_contexts.get(context); }
+
+	const std::string &ConnectionManager::getDeviceID(DeviceHandle device) const { return m_devices.get(device); }
+
+	Metrics::Recorder ConnectionManager::getMetricsRecorder(ActionHandle action) { return { m_metrics, action }; }
+
+	void ConnectionManager::incrementMetric(ActionHandle action, Metrics::Counter counter) {
+		m_metrics.increment(action, counter);
 	}
 
-	void ConnectionManager::api_showAlertForContext(const std::string &context) {
-		nlohmann::json jsonObject;
+	nlohmann::json ConnectionManager::getMetricsJSON() const { return m_metrics.toJSON(m_actions); }
 
-		jsonObject[kESDSDKCommonEvent]   = kESDSDKEventShowAlert;
-		jsonObject[kESDSDKCommonContext] = context;
+	ImageCache &ConnectionManager::getImageCache() { return m_imageCache; }
 
-		websocketpp::lib::error_code ec;
-		m_websocket.send(m_connectionHandle, jsonObject.dump(), websocketpp::frame::opcode::text, ec);
+	ActionHandle ConnectionManager::actionOf(ContextHandle context) const {
+		return context.value < m_contextActions.size() ? m_contextActions[context.value] : ActionHandle();
 	}
 
-	void ConnectionManager::api_showOKForContext(const std::string &context) {
-		nlohmann::json jsonObject;
+	void ConnectionManager::api_setTitle(const std::string &title, ContextHandle context, ESDSDKTarget target) {
+		queueUpdate(context, OutboundQueue::Kind::Title, { target, 0, title });
+	}
 
-		jsonObject[kESDSDKCommonEvent]   = kESDSDKEventShowOK;
-		jsonObject[kESDSDKCommonContext] = context;
+	void ConnectionManager::api_setImage(const std::string &base64ImageString, ContextHandle context,
+										 ESDSDKTarget target) {
+		queueUpdate(context, OutboundQueue::Kind::Image, { target, 0, base64ImageString });
+	}
 
-		websocketpp::lib::error_code ec;
-		m_websocket.send(m_connectionHandle, jsonObject.dump(), websocketpp::frame::opcode::text, ec);
+	void ConnectionManager::api_setImage(const EncodedImage &image, ContextHandle context, ESDSDKTarget target) {
+		queueUpdate(context, OutboundQueue::Kind::Image, { target, 0, {}, image.dataURI, image.hash });
 	}
 
-	void ConnectionManager::api_setSettings(const nlohmann::json &settings, const std::string &context) {
-		nlohmann::json jsonObject;
+	std::shared_ptr< const std::string > ConnectionManager::prepareImage(const EncodedImage &image,
+																		 ContextHandle context, ESDSDKTarget target) {
+		return std::make_shared< const std::string >(
+			m_writer.setImage(*image.dataURI, m_contexts.get(context), target));
+	}
 
-		jsonObject[kESDSDKCommonEvent]   = kESDSDKEventSetSettings;
-		jsonObject[kESDSDKCommonContext] = context;
-		jsonObject[kESDSDKCommonPayload] = settings;
+	bool ConnectionManager::sendPreparedImage(const std::shared_ptr< const std::string > &message,
+											  ContextHandle context) {
+		if (!m_connected) {
+			return false;
+		}
 
-		websocketpp::lib::error_code ec;
-		m_websocket.send(m_connectionHandle, jsonObject.dump(), websocketpp::frame::opcode::text, ec);
+		// The button no longer shows what has been sent through the update queue, so the next update
+		// must not be dropped as unchanged
+		m_outboundQueue.invalidate(context, OutboundQueue::Kind::Image);
+		m_metrics.increment(actionOf(context), Metrics::Counter::Sends);
+
+		return transmit(*message);
 	}
 
-	void ConnectionManager::api_setState(int state, const std::string &context) {
-		nlohmann::json jsonObject;
+	void ConnectionManager::api_showAlertForContext(ContextHandle context) {
+		send(m_writer.showAlert(m_contexts.get(context)), actionOf(context));
+	}
 
-		nlohmann::json payload;
-		payload[kESDSDKPayloadState] = state;
+	void ConnectionManager::api_showOKForContext(ContextHandle context) {
+		send(m_writer.showOK(m_contexts.get(context)), actionOf(context));
+	}
 
-		jsonObject[kESDSDKCommonEvent]   = kESDSDKEventSetState;
-		jsonObject[kESDSDKCommonContext] = context;
-		jsonObject[kESDSDKCommonPayload] = payload;
+	void ConnectionManager::api_setSettings(const nlohmann::json &settings, ContextHandle context) {
+		send(m_writer.setSettings(settings, m_contexts.get(context)), actionOf(context));
+	}
 
-		websocketpp::lib::error_code ec;
-		m_websocket.send(m_connectionHandle, jsonObject.dump(), websocketpp::frame::opcode::text, ec);
+	void ConnectionManager::api_getGlobalSettings() { send(m_writer.getGlobalSettings(m_pluginUUID)); }
+
+	void ConnectionManager::api_setState(int state, ContextHandle context) {
+		queueUpdate(context, OutboundQueue::Kind::State, { kESDSDKTarget_HardwareAndSoftware, state, {} });
 	}
 
-	void ConnectionManager::api_sendToPropertyInspector(const std::string &action, const std::string &context,
+	void ConnectionManager::api_sendToPropertyInspector(ActionHandle action, ContextHandle context,
 														const nlohmann::json &payload) {
-		nlohmann::json jsonObject;
+		send(m_writer.sendToPropertyInspector(m_actions.get(action), m_contexts.get(context), payload), action);
+	}
 
-		jsonObject[kESDSDKCommonEvent]   = kESDSDKEventSendToPropertyInspector;
-		jsonObject[kESDSDKCommonContext] = context;
-		jsonObject[kESDSDKCommonAction]  = action;
-		jsonObject[kESDSDKCommonPayload] = payload;
+	void ConnectionManager::api_switchToProfile(DeviceHandle device, const std::string &profileName) {
+		if (device.isValid()) {
+			send(m_writer.switchToProfile(m_pluginUUID, m_devices.get(device), profileName));
+		}
+	}
 
-		websocketpp::lib::error_code ec;
-		m_websocket.send(m_connectionHandle, jsonObject.dump(), websocketpp::frame::opcode::text, ec);
+	void ConnectionManager::api_logMessage(const std::string &message) {
+		if (!message.empty()) {
+			log(LogLevel::Info, message);
+		}
 	}
 
-	void ConnectionManager::api_switchToProfile(const std::string &deviceID, const std::string &profileName) {
-		if (!deviceID.empty()) {
-			nlohmann::json jsonObject;
+	void ConnectionManager::sendPendingLog() {
+		std::string lines;
+		{
+			std::lock_guard< std::mutex > guard(m_pendingLogMutex);
+			lines.swap(m_pendingLog);
+		}
+
+		send(m_writer.logMessage(lines));
+	}
 
-			jsonObject[kESDSDKCommonEvent]   = kESDSDKEventSwitchToProfile;
-			jsonObject[kESDSDKCommonContext] = m_pluginUUID;
-			jsonObject[kESDSDKCommonDevice]  = deviceID;
+	void ConnectionManager::send(const std::string &message, ActionHandle action) {
+		m_metrics.increment(action, Metrics::Counter::Sends);
 
-			if (!profileName.empty()) {
-				nlohmann::json payload;
-				payload[kESDSDKPayloadProfile]   = profileName;
-				jsonObject[kESDSDKCommonPayload] = payload;
+		if (!m_connected || !transmit(message)) {
+			// Sent once the connection has been re-established
+			if (m_outbox.size() >= maxOutboxSize) {
+				m_outbox.pop_front();
+				m_outboxDroppedCount++;
 			}
+			m_outbox.push_back(message);
+		}
+	}
+
+	bool ConnectionManager::transmit(const std::string &message) {
+		websocketpp::lib::error_code ec;
+		m_websocket.send(m_connectionHandle, message, websocketpp::frame::opcode::text, ec);
 
-			websocketpp::lib::error_code ec;
-			m_websocket.send(m_connectionHandle, jsonObject.dump(), websocketpp::frame::opcode::text, ec);
+		if (!ec) {
+			m_transmittedCount++;
 		}
+
+		return !ec;
 	}
 
-	void ConnectionManager::api_logMessage(const std::string &message) {
-		if (!message.empty()) {
-			nlohmann::json jsonObject;
+	void ConnectionManager::flushOutbox() {
+		while (m_connected && !m_outbox.empty()) {
+			if (!transmit(m_outbox.front())) {
+				break;
+			}
+			m_outbox.pop_front();
+		}
+	}
 
-			jsonObject[kESDSDKCommonEvent] = kESDSDKEventLogMessage;
+	void ConnectionManager::queueUpdate(ContextHandle context, OutboundQueue::Kind kind,
+										OutboundQueue::Value value) {
+		switch (m_outboundQueue.push(context, kind, std::move(value))) {
+			case OutboundQueue::PushResult::QueuedFirst:
+				// Give everything else that is currently being processed the chance to update the same
+				// buttons before actually sending anything
+				post([this]() { flushUpdates(); });
+				break;
+			case OutboundQueue::PushResult::Queued:
+				break;
+			case OutboundQueue::PushResult::Coalesced:
+				m_metrics.increment(actionOf(context), Metrics::Counter::Coalesced);
+				break;
+			case OutboundQueue::PushResult::Dropped:
+				m_metrics.increment(actionOf(context), Metrics::Counter::Dropped);
+				break;
+		}
+	}
 
-			nlohmann::json payload;
-			payload[kESDSDKPayloadMessage]   = message;
-			jsonObject[kESDSDKCommonPayload] = payload;
+	void ConnectionManager::flushUpdates() {
+		if (!m_connected) {
+			// The updates remain queued (and keep on being coalesced) until the connection is back
+			return;
+		}
 
-			websocketpp::lib::error_code ec;
-			m_websocket.send(m_connectionHandle, jsonObject.dump(), websocketpp::frame::opcode::text, ec);
+		m_outboundQueue.flush(
+			[this](ContextHandle contextHandle, OutboundQueue::Kind kind, const OutboundQueue::Value &value) {
+				const std::string &context = m_contexts.get(contextHandle);
+				const ActionHandle action   = actionOf(contextHandle);
+
+				switch (kind) {
+					case OutboundQueue::Kind::Title:
+						send(m_writer.setTitle(value.text, context, value.target), action);
+						break;
+					case OutboundQueue::Kind::Image:
+						send(m_writer.setImage(value.payload(), context, value.target), action);
+						break;
+					case OutboundQueue::Kind::State:
+						send(m_writer.setState(value.state, context), action);
+						break;
+				}
+			});
+	}
+
+	void ConnectionManager::scheduleMetricsDump() {
+		if (!m_metricsDumpTimer) {
+			m_metricsDumpTimer = std::make_unique< boost::asio::steady_timer >(getIOService());
 		}
+
+		m_metricsDumpTimer->expires_after(metricsDumpInterval);
+		m_metricsDumpTimer->async_wait([this](const boost::system::error_code &ec) {
+			if (ec) {
+				return;
+			}
+
+			const std::uint64_t sampleCount = m_metrics.sampleCount();
+			if (sampleCount != m_dumpedSampleCount) {
+				m_dumpedSampleCount = sampleCount;
+
+				for (std::string &line : m_metrics.summarize(m_actions)) {
+					log(LogLevel::Info, std::move(line));
+				}
+			}
+
+			scheduleMetricsDump();
+		});
 	}
 
 }; // namespace StreamDeckIntegration
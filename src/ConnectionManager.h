@@ -9,9 +9,27 @@
 #ifndef MUMBLE_STREAMDECK_INTEGRATION_CONNECTIONMANAGER_H_
 #define MUMBLE_STREAMDECK_INTEGRATION_CONNECTIONMANAGER_H_
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
 #include <string>
+#include <vector>
 
 #include "ESDSDKDefines.h"
+#include "EncodedImage.h"
+#include "IDTable.h"
+#include "ImageCache.h"
+#include "Logger.h"
+#include "MessageWriter.h"
+#include "Metrics.h"
+#include "OutboundQueue.h"
+
+#include <boost/asio/steady_timer.hpp>
 
 #include <websocketpp/client.hpp>
 #include <websocketpp/common/memory.hpp>
@@ -36,25 +54,114 @@ namespace StreamDeckIntegration {
 		/// Start the event loop
 		void run();
 
+		/**
+		 * Processes a single message received from the Stream Deck
+		 *
+		 * @param message The serialized message
+		 */
+		void dispatch(std::string_view message);
+
 		/**
 		 * Reports about an error that occured. This involves writing the error message
 		 * to the log file and optionally triggering an alert for the provided context.
 		 *
 		 * @param errorMessage The error message that should be logged
-		 * @param context If given this is the context that an alert will be shown for
+		 * @param context If valid, this is the context that an alert will be shown for
+		 */
+		void reportError(const std::string &errorMessage, ContextHandle context = {});
+		/**
+		 * Same as above, but only a limited number of errors from the same place are logged per time interval
+		 * (alerts are shown nonetheless)
+		 *
+		 * @param rateLimit The limit for the place the error is reported at
+		 */
+		void reportError(const std::string &errorMessage, ContextHandle context, LogRateLimit &rateLimit);
+
+		/**
+		 * Logs the given message. The message is written out asynchronously (to the Stream Deck's log and
+		 * potentially a local file), so this is cheap to call from anywhere (including other threads).
+		 *
+		 * @param level The message's level (it is dropped if the level is disabled)
+		 * @param message The message to log
+		 */
+		void log(LogLevel level, std::string message);
+		/**
+		 * Same as above, but only a limited number of messages from the same place are logged per time interval
+		 *
+		 * @param rateLimit The limit for the place the message is logged at
+		 */
+		void log(LogLevel level, std::string message, LogRateLimit &rateLimit);
+		/**
+		 * @returns The logger (e.g. in order to configure it)
+		 */
+		Logger &getLogger();
+
+		/**
+		 * Schedules the given handler to be run on the thread that is running the event loop. This function
+		 * may be called from any thread.
+		 *
+		 * @param handler The handler to run
+		 */
+		void post(std::function< void() > handler);
+
+		/**
+		 * @returns The IO service the event loop is running on (only valid while run() is executing)
+		 */
+		boost::asio::io_service &getIOService();
+
+		// The Stream Deck's string IDs are only ever handed to the plugin as handles. These functions
+		// translate between the two representations.
+		ActionHandle getActionHandle(std::string_view actionID);
+		const std::string &getActionID(ActionHandle action) const;
+		const std::string &getContextID(ContextHandle context) const;
+		const std::string &getDeviceID(DeviceHandle device) const;
+
+		/**
+		 * @param action The action to record for (if invalid, the plugin itself)
+		 * @returns A recorder for the latencies of the given action's stages. It may be used from any thread.
+		 */
+		Metrics::Recorder getMetricsRecorder(ActionHandle action = {});
+		void incrementMetric(ActionHandle action, Metrics::Counter counter);
+		/**
+		 * @returns The latencies and counters recorded so far (see Metrics::toJSON)
 		 */
-		void reportError(const std::string &errorMessage, const std::string &context = "");
+		nlohmann::json getMetricsJSON() const;
+
+		/**
+		 * @returns The images that can be shown on the buttons (loaded once at startup)
+		 */
+		ImageCache &getImageCache();
 
 		// API to communicate with the Stream Deck application
-		void api_setTitle(const std::string &title, const std::string &context, ESDSDKTarget target);
-		void api_setImage(const std::string &base64ImageString, const std::string &context, ESDSDKTarget target);
-		void api_showAlertForContext(const std::string &context);
-		void api_showOKForContext(const std::string &context);
-		void api_setSettings(const nlohmann::json &settings, const std::string &context);
-		void api_setState(int state, const std::string &context);
-		void api_sendToPropertyInspector(const std::string &action, const std::string &context,
-										 const nlohmann::json &payload);
-		void api_switchToProfile(const std::string &deviceID, const std::string &profileName);
+		// Title, image and state updates are queued and sent in batches once per event loop
+		// iteration. Only the latest update per button is sent and updates that wouldn't change
+		// anything are dropped.
+		void api_setTitle(const std::string &title, ContextHandle context, ESDSDKTarget target);
+		void api_setImage(const std::string &base64ImageString, ContextHandle context, ESDSDKTarget target);
+		// Cached images are compared by their hash, so re-sending the image a button displays already is free
+		void api_setImage(const EncodedImage &image, ContextHandle context, ESDSDKTarget target);
+		/**
+		 * Serializes a setImage message for the given button once, so that it can be sent as often as needed
+		 * (e.g. as a frame of an animation) without any further work
+		 */
+		std::shared_ptr< const std::string > prepareImage(const EncodedImage &image, ContextHandle context,
+														  ESDSDKTarget target);
+		/**
+		 * Sends a message prepared by prepareImage right away, bypassing the update queue. Such messages are
+		 * meant to be sent frequently, so nothing is buffered while there is no connection: by the time it is
+		 * back, the message would be outdated anyway.
+		 *
+		 * @returns Whether the message has been sent
+		 */
+		bool sendPreparedImage(const std::shared_ptr< const std::string > &message, ContextHandle context);
+		void api_showAlertForContext(ContextHandle context);
+		void api_showOKForContext(ContextHandle context);
+		void api_setSettings(const nlohmann::json &settings, ContextHandle context);
+		void api_getGlobalSettings();
+		void api_setState(int state, ContextHandle context);
+		void api_sendToPropertyInspector(ActionHandle action, ContextHandle context, const nlohmann::json &payload);
+		void api_switchToProfile(DeviceHandle device, const std::string &profileName);
+		/// Logs the given message with level info (see log)
 		void api_logMessage(const std::string &message);
 
 	private:
@@ -64,13 +171,87 @@ namespace StreamDeckIntegration {
 		void onClose(WebsocketClient *client, websocketpp::connection_hdl connectionHandler);
 		void onMessage(websocketpp::connection_hdl, WebsocketClient::message_ptr msg);
 
+		/**
+		 * Starts connecting to the Stream Deck
+		 */
+		void connect();
+		/**
+		 * Schedules an attempt to reconnect (with exponential backoff). Gives up if the Stream Deck hasn't been
+		 * reachable for too long.
+		 */
+		void connectionLost();
+
+		/**
+		 * Sends the given message or, if there is no connection, buffers it until the connection is back
+		 */
+		void send(const std::string &message, ActionHandle action = {});
+		/**
+		 * Sends the given message right away
+		 *
+		 * @returns Whether sending succeeded
+		 */
+		bool transmit(const std::string &message);
+		void flushOutbox();
+		/**
+		 * Sends the log lines that the logger has handed over (see m_pendingLog)
+		 */
+		void sendPendingLog();
+		void queueUpdate(ContextHandle context, OutboundQueue::Kind kind, OutboundQueue::Value value);
+		void flushUpdates();
+		/**
+		 * Implements both public variants of reportError
+		 *
+		 * @param rateLimit The limit for the place the error is reported at or nullptr if there is none
+		 */
+		void reportError(const std::string &errorMessage, ContextHandle context, LogRateLimit *rateLimit);
+
+		/**
+		 * @returns The action of the button with the given context (invalid if not known)
+		 */
+		ActionHandle actionOf(ContextHandle context) const;
+		/**
+		 * Writes a summary of the metrics to the log every now and then (as long as there is anything new)
+		 */
+		void scheduleMetricsDump();
+
 		// Member variables
 		int m_port = 0;
 		std::string m_pluginUUID;
 		std::string m_registerEvent;
 		websocketpp::connection_hdl m_connectionHandle;
 		WebsocketClient m_websocket;
+		IDTable< ActionHandle > m_actions;
+		IDTable< ContextHandle > m_contexts;
+		IDTable< DeviceHandle > m_devices;
+		/// The action of every context, indexed by the context's handle
+		std::vector< ActionHandle > m_contextActions;
+		MessageWriter m_writer;
+		OutboundQueue m_outboundQueue;
+		ImageCache m_imageCache;
+		Metrics m_metrics;
+		std::unique_ptr< boost::asio::steady_timer > m_metricsDumpTimer;
+		std::uint64_t m_dumpedSampleCount = 0;
+
+		/// Whether the event loop is running (and thus handlers may be posted to it)
+		std::atomic_bool m_running = { false };
+		// Log lines that have been handed over by the logger but not yet sent by the event loop. If the event loop
+		// stops before sending them, they are written to stderr instead of being lost (see run).
+		std::mutex m_pendingLogMutex;
+		std::string m_pendingLog;
+		bool m_connected           = false;
+		bool m_hasBeenConnected    = false;
+		bool m_reconnecting        = false;
+		std::chrono::steady_clock::time_point m_disconnectedAt;
+		std::chrono::milliseconds m_reconnectDelay;
+		std::mt19937 m_random;
+		std::unique_ptr< boost::asio::steady_timer > m_reconnectTimer;
+		/// Messages that couldn't be sent as there was no connection
+		std::deque< std::string > m_outbox;
+		std::size_t m_outboxDroppedCount = 0;
+		std::size_t m_transmittedCount   = 0;
 		StreamDeckPlugin &m_plugin;
+		// Declared last so that its flusher is stopped before anything it might use is destroyed
+		Logger m_logger;
 	};
 
 }; // namespace StreamDeckIntegration
@@ -0,0 +1,77 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#include "Debouncer.h"
+
+#include <vector>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	Debouncer::Debouncer(boost::asio::io_service &ioService, std::chrono::milliseconds settleTime, Callback callback)
+		: m_ioService(ioService), m_settleTime(settleTime), m_callback(std::move(callback)) {}
+
+	void Debouncer::touch(ContextHandle key) {
+		std::unique_ptr< boost::asio::steady_timer > &timer = m_pending[key];
+		if (!timer) {
+			timer = std::make_unique< boost::asio::steady_timer >(m_ioService);
+		}
+
+		// Restarting the timer cancels the wait that is currently in progress
+		timer->expires_after(m_settleTime);
+		timer->async_wait([this, key](const boost::system::error_code &ec) {
+			if (ec == boost::asio::error::operation_aborted) {
+				return;
+			}
+
+			auto it = m_pending.find(key);
+			if (it != m_pending.end() && it->second->expiry() > boost::asio::steady_timer::clock_type::now()) {
+				// The key has been touched again after this wait had completed already
+				return;
+			}
+
+			flush(key);
+		});
+	}
+
+	void Debouncer::flush(ContextHandle key) {
+		auto it = m_pending.find(key);
+		if (it == m_pending.end()) {
+			return;
+		}
+
+		it->second->cancel();
+		m_pending.erase(it);
+
+		m_callback(key);
+	}
+
+	bool Debouncer::cancel(ContextHandle key) {
+		auto it = m_pending.find(key);
+		if (it == m_pending.end()) {
+			return false;
+		}
+
+		it->second->cancel();
+		m_pending.erase(it);
+
+		return true;
+	}
+
+	void Debouncer::flushAll() {
+		std::vector< ContextHandle > keys;
+		keys.reserve(m_pending.size());
+
+		for (const auto &current : m_pending) {
+			keys.push_back(current.first);
+		}
+
+		for (ContextHandle current : keys) {
+			flush(current);
+		}
+	}
+
+}; // namespace StreamDeckIntegration
+}; // namespace Mumble
@@ -0,0 +1,68 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#ifndef MUMBLE_STREAMDECK_INTEGRATION_DEBOUNCER_H_
+#define MUMBLE_STREAMDECK_INTEGRATION_DEBOUNCER_H_
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include "IDTable.h"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	/**
+	 * Delays a callback until things have settled down. Every key (a button's context) has its own settle window
+	 * that is restarted whenever the key is touched. The callback for a key is invoked once its window has passed
+	 * without the key having been touched again (or when the key is flushed explicitly).
+	 *
+	 * All functions have to be called on the thread running the given IO service.
+	 */
+	class Debouncer {
+	public:
+		using Callback = std::function< void(ContextHandle key) >;
+
+		Debouncer(boost::asio::io_service &ioService, std::chrono::milliseconds settleTime, Callback callback);
+
+		/**
+		 * (Re)Starts the settle window for the given key
+		 */
+		void touch(ContextHandle key);
+
+		/**
+		 * Invokes the callback for the given key right away, if it has been touched since the callback has
+		 * last been invoked for it
+		 */
+		void flush(ContextHandle key);
+
+		/**
+		 * Forgets the given key without invoking the callback
+		 *
+		 * @returns Whether the key had been touched since the callback has last been invoked for it
+		 */
+		bool cancel(ContextHandle key);
+
+		/**
+		 * Flushes all keys
+		 */
+		void flushAll();
+
+	private:
+		boost::asio::io_service &m_ioService;
+		std::chrono::milliseconds m_settleTime;
+		Callback m_callback;
+
+		std::unordered_map< ContextHandle, std::unique_ptr< boost::asio::steady_timer > > m_pending;
+	};
+
+};     // namespace StreamDeckIntegration
+};     // namespace Mumble
+#endif // MUMBLE_STREAMDECK_INTEGRATION_DEBOUNCER_H_
@@ -0,0 +1,33 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#ifndef MUMBLE_STREAMDECK_INTEGRATION_ENCODEDIMAGE_H_
+#define MUMBLE_STREAMDECK_INTEGRATION_ENCODEDIMAGE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	/**
+	 * An image that is ready to be used in setImage. The data URI is shared, so that the image can be queued
+	 * for any number of buttons without copying it.
+	 */
+	struct EncodedImage {
+		/// What the data URI of every PNG image starts with
+		static constexpr std::string_view pngDataURIPrefix = "data:image/png;base64,";
+
+		/// The image as a data URI
+		std::shared_ptr< const std::string > dataURI;
+		/// The hash of the image's content (images with the same hash are considered to be identical)
+		std::uint64_t hash = 0;
+	};
+
+};     // namespace StreamDeckIntegration
+};     // namespace Mumble
+#endif // MUMBLE_STREAMDECK_INTEGRATION_ENCODEDIMAGE_H_
@@ -0,0 +1,220 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#include "FrameScheduler.h"
+
+#include <algorithm>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	namespace {
+		/// The credit a single frame costs
+		constexpr std::int64_t frameCost = 1000;
+	} // namespace
+
+	FrameScheduler::FrameScheduler(boost::asio::io_service &ioService, Budget budget, Sender sender)
+		: m_timer(ioService), m_budget(budget), m_sender(std::move(sender)) {}
+
+	void FrameScheduler::start(ContextHandle context, std::vector< Frame > frames,
+							   std::chrono::milliseconds frameInterval) {
+		if (!context.isValid() || frames.empty()) {
+			stop(context);
+			return;
+		}
+
+		if (context.value >= m_animations.size()) {
+			m_animations.resize(context.value + 1);
+		}
+
+		Animation &animation = m_animations[context.value];
+		if (!animation.active || animation.paused) {
+			m_playingCount++;
+		}
+
+		// Rounded up, so that the animation never plays faster than intended
+		const auto ticks = (frameInterval + tickInterval - std::chrono::milliseconds(1)) / tickInterval;
+
+		animation.frames    = std::move(frames);
+		animation.interval  = std::max< std::size_t >(static_cast< std::size_t >(ticks), 1);
+		animation.nextFrame = 0;
+		animation.active    = true;
+		animation.paused    = false;
+		animation.generation++;
+
+		schedule(context, 1);
+		startTicking();
+	}
+
+	void FrameScheduler::stop(ContextHandle context) {
+		if (context.value >= m_animations.size() || !m_animations[context.value].active) {
+			return;
+		}
+
+		Animation &animation = m_animations[context.value];
+		if (!animation.paused) {
+			m_playingCount--;
+		}
+
+		// The frames may be large, so they aren't kept around
+		animation.frames.clear();
+		animation.frames.shrink_to_fit();
+		animation.displayed.reset();
+		animation.active = false;
+		animation.paused = false;
+		animation.generation++;
+	}
+
+	void FrameScheduler::pause(ContextHandle context) {
+		if (context.value >= m_animations.size()) {
+			return;
+		}
+
+		Animation &animation = m_animations[context.value];
+		if (!animation.active || animation.paused) {
+			return;
+		}
+
+		animation.paused = true;
+		animation.generation++;
+		m_playingCount--;
+	}
+
+	void FrameScheduler::resume(ContextHandle context) {
+		if (context.value >= m_animations.size()) {
+			return;
+		}
+
+		Animation &animation = m_animations[context.value];
+		if (!animation.active || !animation.paused) {
+			return;
+		}
+
+		animation.paused = false;
+		animation.displayed.reset();
+		animation.generation++;
+		m_playingCount++;
+
+		schedule(context, 1);
+		startTicking();
+	}
+
+	bool FrameScheduler::isAnimating(ContextHandle context) const {
+		return context.value < m_animations.size() && m_animations[context.value].active;
+	}
+
+	std::size_t FrameScheduler::sentCount() const { return m_sentCount; }
+
+	std::size_t FrameScheduler::postponedCount() const { return m_postponedCount; }
+
+	void FrameScheduler::schedule(ContextHandle context, std::size_t ticks) {
+		const Entry entry = { context, m_animations[context.value].generation, (ticks - 1) / slotCount };
+
+		m_wheel[(m_currentSlot + ticks) % slotCount].push_back(entry);
+	}
+
+	void FrameScheduler::startTicking() {
+		if (m_ticking || m_playingCount == 0) {
+			return;
+		}
+
+		m_ticking  = true;
+		m_nextTick = std::chrono::steady_clock::now() + tickInterval;
+		wait();
+	}
+
+	void FrameScheduler::tick() {
+		m_currentSlot = (m_currentSlot + 1) % slotCount;
+
+		// Budget that hasn't been used up on the previous tick may only be carried over as far as needed to
+		// make up for rounding (otherwise a burst of frames would follow every quiet period)
+		const std::int64_t frameCredit = static_cast< std::int64_t >(m_budget.framesPerSecond) * tickInterval.count();
+		const std::int64_t byteCredit  = static_cast< std::int64_t >(m_budget.bytesPerSecond) * tickInterval.count()
+										/ 1000;
+		m_frameCredit = std::min(m_frameCredit + frameCredit, frameCredit + frameCost);
+		m_byteCredit  = std::min(m_byteCredit + byteCredit, byteCredit);
+
+		// Whatever has been postponed on the previous tick goes first
+		m_processing.clear();
+		m_processing.swap(m_postponed);
+
+		std::vector< Entry > &slot = m_wheel[m_currentSlot];
+		for (const Entry &entry : slot) {
+			if (entry.rounds > 0) {
+				m_postponed.push_back({ entry.context, entry.generation, entry.rounds - 1 });
+			} else {
+				m_processing.push_back(entry);
+			}
+		}
+		// The entries that need more rounds are put back onto the wheel
+		slot.swap(m_postponed);
+		m_postponed.clear();
+
+		for (const Entry &entry : m_processing) {
+			if (!process(entry)) {
+				m_postponed.push_back(entry);
+				m_postponedCount++;
+			}
+		}
+
+		if (m_playingCount == 0) {
+			// Entries that are still on the wheel belong to stopped or paused animations and are skipped later on
+			m_ticking = false;
+			return;
+		}
+
+		// Ticks are scheduled relative to the previous one, so that the cadence doesn't drift. If the event loop
+		// has been blocked for a while, the missed ticks are skipped instead of being caught up on all at once.
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		m_nextTick += tickInterval;
+		if (m_nextTick <= now) {
+			m_nextTick = now + tickInterval;
+		}
+
+		wait();
+	}
+
+	void FrameScheduler::wait() {
+		m_timer.expires_at(m_nextTick);
+		m_timer.async_wait([this](const boost::system::error_code &ec) {
+			if (!ec) {
+				tick();
+			}
+		});
+	}
+
+	bool FrameScheduler::process(const Entry &entry) {
+		Animation &animation = m_animations[entry.context.value];
+		if (!animation.active || animation.paused || entry.generation != animation.generation) {
+			// Outdated entry
+			return true;
+		}
+
+		const Frame &frame = animation.frames[animation.nextFrame];
+		if (frame != animation.displayed) {
+			if (m_frameCredit < frameCost || m_byteCredit <= 0) {
+				return false;
+			}
+
+			m_frameCredit -= frameCost;
+			m_byteCredit -= static_cast< std::int64_t >(frame->size());
+
+			if (m_sender(entry.context, frame)) {
+				animation.displayed = frame;
+				m_sentCount++;
+			} else {
+				// Whatever the button shows now, it isn't this frame
+				animation.displayed.reset();
+			}
+		}
+
+		animation.nextFrame = (animation.nextFrame + 1) % animation.frames.size();
+		schedule(entry.context, animation.interval);
+
+		return true;
+	}
+
+}; // namespace StreamDeckIntegration
+}; // namespace Mumble
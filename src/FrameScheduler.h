@@ -0,0 +1,176 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#ifndef MUMBLE_STREAMDECK_INTEGRATION_FRAMESCHEDULER_H_
+#define MUMBLE_STREAMDECK_INTEGRATION_FRAMESCHEDULER_H_
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include "IDTable.h"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	/**
+	 * Plays animations on buttons by sending them one frame after the other. The frames are messages that have
+	 * been serialized in advance (see ConnectionManager::prepareImage), so playing a frame costs nothing but
+	 * sending it.
+	 *
+	 * All animations are driven by a single timer wheel that ticks at a fixed rate for as long as any animation
+	 * is playing. On every tick, each button whose next frame is due gets (at most) one message. How many
+	 * frames and bytes may be sent per second is limited globally, so that animations can't saturate the
+	 * connection to the Stream Deck. Frames that would exceed the limit are postponed to the next tick (and
+	 * sent before anything else then), which slows down the animations instead of dropping frames at random.
+	 *
+	 * All functions have to be called on the thread running the given IO service.
+	 */
+	class FrameScheduler {
+	public:
+		/// A serialized setImage message
+		using Frame = std::shared_ptr< const std::string >;
+		/**
+		 * Sends the given frame to the given button
+		 *
+		 * @returns Whether the frame has been sent
+		 */
+		using Sender = std::function< bool(ContextHandle context, const Frame &frame) >;
+
+		struct Budget {
+			/// The number of frames that may be sent per second (across all buttons)
+			unsigned int framesPerSecond;
+			/// The number of bytes that may be sent per second (across all buttons)
+			std::size_t bytesPerSecond;
+		};
+
+		/// The resolution of the timer wheel (frame intervals are rounded up to a multiple of it)
+		static constexpr std::chrono::milliseconds tickInterval = std::chrono::milliseconds(25);
+		/// The number of slots of the timer wheel (longer intervals take multiple rounds)
+		static constexpr std::size_t slotCount = 64;
+
+		FrameScheduler(boost::asio::io_service &ioService, Budget budget, Sender sender);
+
+		FrameScheduler(const FrameScheduler &) = delete;
+		FrameScheduler &operator=(const FrameScheduler &) = delete;
+
+		/**
+		 * Starts playing the given frames on the given button in a loop (replacing the animation the button
+		 * is playing already, if any). The first frame is sent on the next tick.
+		 *
+		 * @param context The context of the button
+		 * @param frames The frames to play (consecutive frames that are the same object are only sent once)
+		 * @param frameInterval How long every frame is shown
+		 */
+		void start(ContextHandle context, std::vector< Frame > frames, std::chrono::milliseconds frameInterval);
+		/**
+		 * Stops the given button's animation. The button keeps on showing the last frame that has been sent.
+		 */
+		void stop(ContextHandle context);
+
+		/**
+		 * Suspends the given button's animation (e.g. because the button has disappeared) without consuming
+		 * any of the budget until it is resumed
+		 */
+		void pause(ContextHandle context);
+		/**
+		 * Continues the given button's paused animation with the frame it has been paused at. As the button
+		 * may show something else by now, that frame is sent in any case.
+		 */
+		void resume(ContextHandle context);
+
+		/**
+		 * @returns Whether an animation has been started for the given button (and not been stopped yet)
+		 */
+		bool isAnimating(ContextHandle context) const;
+
+		/**
+		 * @returns The number of frames that have been sent
+		 */
+		std::size_t sentCount() const;
+		/**
+		 * @returns The number of times a frame has been postponed as the budget had been used up
+		 */
+		std::size_t postponedCount() const;
+
+	private:
+		struct Animation {
+			std::vector< Frame > frames;
+			/// The interval between frames in ticks
+			std::size_t interval  = 1;
+			std::size_t nextFrame = 0;
+			/// The frame the button is showing (null if not known)
+			Frame displayed;
+			bool active = false;
+			bool paused = false;
+			/// Incremented whenever the animation is (re-)started, stopped or paused, which invalidates
+			/// the entries that have been put on the wheel before
+			std::uint32_t generation = 0;
+		};
+
+		struct Entry {
+			ContextHandle context;
+			std::uint32_t generation;
+			/// The number of times the wheel has to go round before the entry is due
+			std::size_t rounds;
+		};
+
+		boost::asio::steady_timer m_timer;
+		Budget m_budget;
+		Sender m_sender;
+
+		/// The animations indexed by the handles of their contexts
+		std::vector< Animation > m_animations;
+		std::array< std::vector< Entry >, slotCount > m_wheel;
+		/// The entries postponed on the previous tick
+		std::vector< Entry > m_postponed;
+		/// The entries currently being processed (kept around so that ticks don't allocate)
+		std::vector< Entry > m_processing;
+		std::size_t m_currentSlot = 0;
+		/// The number of animations that are neither stopped nor paused
+		std::size_t m_playingCount = 0;
+		bool m_ticking             = false;
+		std::chrono::steady_clock::time_point m_nextTick;
+
+		/// How many frames may still be sent (in thousandths of a frame)
+		std::int64_t m_frameCredit = 0;
+		/// How many bytes may still be sent (negative if the last frame has exceeded the budget)
+		std::int64_t m_byteCredit = 0;
+
+		std::size_t m_sentCount      = 0;
+		std::size_t m_postponedCount = 0;
+
+		/**
+		 * Puts the given button's animation on the wheel, so that it is processed after the given number of ticks
+		 */
+		void schedule(ContextHandle context, std::size_t ticks);
+		/**
+		 * Starts the timer, if it isn't running already
+		 */
+		void startTicking();
+		/**
+		 * Waits for the next tick
+		 */
+		void wait();
+		void tick();
+		/**
+		 * Sends the due frame of the given entry's animation (if the budget allows) and schedules the next one
+		 *
+		 * @returns Whether the entry has been processed (otherwise it has to be postponed)
+		 */
+		bool process(const Entry &entry);
+	};
+
+};     // namespace StreamDeckIntegration
+};     // namespace Mumble
+#endif // MUMBLE_STREAMDECK_INTEGRATION_FRAMESCHEDULER_H_
@@ -0,0 +1,120 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#ifndef MUMBLE_STREAMDECK_INTEGRATION_IDTABLE_H_
+#define MUMBLE_STREAMDECK_INTEGRATION_IDTABLE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	/**
+	 * A compact stand-in for one of the (lengthy) string IDs used by the Stream Deck. Handles are small
+	 * consecutive integers, so they can be used as indices into flat tables. The tag type makes sure
+	 * handles of different kinds of IDs can't be mixed up.
+	 */
+	template< typename Tag > struct Handle {
+		std::uint32_t value = 0;
+
+		/// @returns Whether this handle refers to an actual ID
+		bool isValid() const { return value != 0; }
+
+		bool operator==(const Handle &other) const { return value == other.value; }
+		bool operator!=(const Handle &other) const { return value != other.value; }
+	};
+
+	struct ContextTag;
+	struct ActionTag;
+	struct DeviceTag;
+
+	using ContextHandle = Handle< ContextTag >;
+	using ActionHandle  = Handle< ActionTag >;
+	using DeviceHandle  = Handle< DeviceTag >;
+
+	/**
+	 * Maps string IDs to handles (and back). Once an ID has been interned, it keeps its handle for as long
+	 * as the table exists. As the Stream Deck reuses the IDs of buttons and devices, the table's size is
+	 * bounded by the number of distinct buttons and devices.
+	 */
+	template< typename HandleType > class IDTable {
+	public:
+		IDTable() {
+			// Reserve index 0 for the invalid handle
+			m_ids.emplace_back();
+		}
+
+		IDTable(const IDTable &) = delete;
+		IDTable &operator=(const IDTable &) = delete;
+
+		/**
+		 * @returns The handle for the given ID. If the ID hasn't been seen before, a new handle is created
+		 * 	for it. An empty ID always maps to the invalid handle.
+		 */
+		HandleType intern(std::string_view id) {
+			if (id.empty()) {
+				return {};
+			}
+
+			auto it = m_lookup.find(id);
+			if (it != m_lookup.end()) {
+				return it->second;
+			}
+
+			// Elements of a deque don't move when it grows, so the views into them remain valid
+			m_ids.emplace_back(id);
+
+			HandleType handle;
+			handle.value = static_cast< std::uint32_t >(m_ids.size() - 1);
+
+			m_lookup.emplace(std::string_view(m_ids.back()), handle);
+
+			return handle;
+		}
+
+		/**
+		 * @returns The handle for the given ID or the invalid handle, if the ID is not known
+		 */
+		HandleType find(std::string_view id) const {
+			auto it = m_lookup.find(id);
+
+			return it == m_lookup.end() ? HandleType() : it->second;
+		}
+
+		/**
+		 * @returns The ID the given handle stands for (empty for invalid handles)
+		 */
+		const std::string &get(HandleType handle) const {
+			return handle.value < m_ids.size() ? m_ids[handle.value] : m_ids.front();
+		}
+
+		/**
+		 * @returns One past the largest handle value that is in use
+		 */
+		std::size_t size() const { return m_ids.size(); }
+
+	private:
+		std::deque< std::string > m_ids;
+		std::unordered_map< std::string_view, HandleType > m_lookup;
+	};
+
+};     // namespace StreamDeckIntegration
+};     // namespace Mumble
+
+namespace std {
+template< typename Tag > struct hash< Mumble::StreamDeckIntegration::Handle< Tag > > {
+	std::size_t operator()(const Mumble::StreamDeckIntegration::Handle< Tag > &handle) const noexcept {
+		return std::hash< std::uint32_t >()(handle.value);
+	}
+};
+}; // namespace std
+
+#endif // MUMBLE_STREAMDECK_INTEGRATION_IDTABLE_H_
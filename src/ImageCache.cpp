@@ -0,0 +1,100 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#include "ImageCache.h"
+#include "Base64.h"
+
+#include "MumbleActionImages.h"
+
+#include <array>
+#include <memory>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	namespace {
+		constexpr std::string_view highDPISuffix = "@2x";
+
+		template< std::size_t Size > struct EmbeddedImage {
+			std::array< char, EncodedImage::pngDataURIPrefix.size() + Base64::encodedSize(Size) > dataURI = {};
+			std::uint64_t hash = 0;
+		};
+
+		/**
+		 * Turns the given PNG into a data URI at compile time
+		 */
+		template< std::size_t Size > constexpr EmbeddedImage< Size > encode(const unsigned char (&png)[Size]) {
+			constexpr char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+			EmbeddedImage< Size > image;
+			std::size_t out = 0;
+
+			for (char c : EncodedImage::pngDataURIPrefix) {
+				image.dataURI[out++] = c;
+			}
+
+			for (std::size_t i = 0; i < Size; i += 3) {
+				const std::uint32_t group = (png[i] << 16) | (i + 1 < Size ? png[i + 1] << 8 : 0)
+											| (i + 2 < Size ? png[i + 2] : 0);
+
+				image.dataURI[out++] = alphabet[(group >> 18) & 0x3F];
+				image.dataURI[out++] = alphabet[(group >> 12) & 0x3F];
+				image.dataURI[out++] = i + 1 < Size ? alphabet[(group >> 6) & 0x3F] : '=';
+				image.dataURI[out++] = i + 2 < Size ? alphabet[group & 0x3F] : '=';
+			}
+
+			image.hash = ImageCache::hash(png, Size);
+
+			return image;
+		}
+	} // namespace
+
+	std::size_t ImageCache::loadEmbedded() {
+		std::size_t loaded = 0;
+
+#define MUMBLE_STREAMDECK_EMBED_IMAGE(name, png)                                           \
+	{                                                                                      \
+		static constexpr EmbeddedImage< sizeof(png) > image = encode(png);                 \
+		insert(name, std::string(image.dataURI.data(), image.dataURI.size()), image.hash); \
+		loaded++;                                                                          \
+	}
+
+		MUMBLE_STREAMDECK_ACTION_IMAGES(MUMBLE_STREAMDECK_EMBED_IMAGE)
+
+#undef MUMBLE_STREAMDECK_EMBED_IMAGE
+
+		return loaded;
+	}
+
+	const EncodedImage &ImageCache::add(const std::string &name, std::string_view png) {
+		std::string dataURI(EncodedImage::pngDataURIPrefix);
+		Base64::encode(png, dataURI);
+
+		return insert(name, std::move(dataURI), hash(png.data(), png.size()));
+	}
+
+	const EncodedImage &ImageCache::insert(const std::string &name, std::string dataURI, std::uint64_t hash) {
+		EncodedImage &image = m_images[name];
+		image.dataURI       = std::make_shared< const std::string >(std::move(dataURI));
+		image.hash          = hash;
+
+		return image;
+	}
+
+	const EncodedImage *ImageCache::find(const std::string &name, bool highDPI) const {
+		if (highDPI) {
+			auto it = m_images.find(name + std::string(highDPISuffix));
+			if (it != m_images.end()) {
+				return &it->second;
+			}
+		}
+
+		auto it = m_images.find(name);
+
+		return it == m_images.end() ? nullptr : &it->second;
+	}
+
+}; // namespace StreamDeckIntegration
+}; // namespace Mumble
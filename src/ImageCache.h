@@ -0,0 +1,80 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#ifndef MUMBLE_STREAMDECK_INTEGRATION_IMAGECACHE_H_
+#define MUMBLE_STREAMDECK_INTEGRATION_IMAGECACHE_H_
+
+#include "EncodedImage.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	/**
+	 * Holds the images the plugin may send to the Stream Deck, ready to be used in setImage. The images shipped
+	 * with the plugin are embedded into the executable already encoded (see actionImages.cmake), so that
+	 * showing an image never touches the disk.
+	 *
+	 * The cache is only modified while loading it, so once that is done it may be read from any thread.
+	 */
+	class ImageCache {
+	public:
+		/**
+		 * Adds the images that are embedded into the executable. An image is named after the file it has been
+		 * created from without the extension, so "muted_icon@2x.png" becomes "muted_icon@2x".
+		 *
+		 * @returns The number of images that have been added
+		 */
+		std::size_t loadEmbedded();
+
+		/**
+		 * Adds the given image to the cache (replacing any image of the same name)
+		 *
+		 * @param name The name of the image
+		 * @param png The content of the PNG file
+		 * @returns The added image
+		 */
+		const EncodedImage &add(const std::string &name, std::string_view png);
+
+		/**
+		 * @param name The name of the image
+		 * @param highDPI Whether the high resolution variant (the one with the "@2x" suffix) is wanted. If there
+		 * 	is no such variant, the regular image is returned instead.
+		 * @returns The image of the given name or nullptr if there is no such image
+		 */
+		const EncodedImage *find(const std::string &name, bool highDPI = false) const;
+
+		/**
+		 * Computes the 64-bit FNV-1a hash of the given data (at compile time, if possible)
+		 *
+		 * @param data The data to hash
+		 * @param size The number of bytes to hash
+		 * @returns The data's hash
+		 */
+		template< typename Byte > static constexpr std::uint64_t hash(const Byte *data, std::size_t size) {
+			std::uint64_t hash = 14695981039346656037ull;
+
+			for (std::size_t i = 0; i < size; ++i) {
+				hash ^= static_cast< unsigned char >(data[i]);
+				hash *= 1099511628211ull;
+			}
+
+			return hash;
+		}
+
+	private:
+		std::unordered_map< std::string, EncodedImage > m_images;
+
+		const EncodedImage &insert(const std::string &name, std::string dataURI, std::uint64_t hash);
+	};
+
+};     // namespace StreamDeckIntegration
+};     // namespace Mumble
+#endif // MUMBLE_STREAMDECK_INTEGRATION_IMAGECACHE_H_
@@ -0,0 +1,82 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#include "InFlightTable.h"
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	InFlightTable::InFlightTable(std::size_t capacity) : m_capacity(capacity) {}
+
+	InFlightTable::PressResult InFlightTable::press(ContextHandle context, Kind kind, Request request) {
+		auto it = m_entries.find(context);
+		if (it == m_entries.end()) {
+			if (m_entries.size() >= m_capacity) {
+				return PressResult::Rejected;
+			}
+
+			Entry entry;
+			entry.kind    = kind;
+			entry.running = std::move(request);
+			m_entries.emplace(context, std::move(entry));
+
+			return PressResult::Start;
+		}
+
+		Entry &entry = it->second;
+		entry.kind   = kind;
+
+		switch (kind) {
+			case Kind::Toggle:
+				// Every other press undoes the one before it
+				if (entry.pending) {
+					entry.pending.reset();
+				} else {
+					entry.pending = std::move(request);
+				}
+				break;
+			case Kind::Idempotent:
+				// Only the latest press counts and if that asks for what is running already, there is
+				// nothing left to do afterwards
+				if (*request == *entry.running) {
+					entry.pending.reset();
+				} else {
+					entry.pending = std::move(request);
+				}
+				break;
+		}
+
+		return PressResult::Merged;
+	}
+
+	InFlightTable::Request InFlightTable::finish(ContextHandle context) {
+		auto it = m_entries.find(context);
+		if (it == m_entries.end()) {
+			return nullptr;
+		}
+
+		Entry &entry = it->second;
+		if (!entry.pending) {
+			m_entries.erase(it);
+			return nullptr;
+		}
+
+		entry.running = std::move(entry.pending);
+		entry.pending.reset();
+
+		return entry.running;
+	}
+
+	void InFlightTable::discardPending(ContextHandle context) {
+		auto it = m_entries.find(context);
+		if (it != m_entries.end()) {
+			it->second.pending.reset();
+		}
+	}
+
+	std::size_t InFlightTable::size() const { return m_entries.size(); }
+
+}; // namespace StreamDeckIntegration
+}; // namespace Mumble
@@ -0,0 +1,103 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#ifndef MUMBLE_STREAMDECK_INTEGRATION_INFLIGHTTABLE_H_
+#define MUMBLE_STREAMDECK_INTEGRATION_INFLIGHTTABLE_H_
+
+#include "IDTable.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	/**
+	 * Keeps track of the requests that are currently being executed for each button. At most one request
+	 * per button is running at any time. Key presses that happen in the meantime are not queued one by one
+	 * but merged into (at most) a single follow-up request, so that the load on the bridge depends on what
+	 * the user wants to achieve rather than on how often a key has been hit:
+	 * - Presses of toggle buttons cancel each other out in pairs, so only their parity matters
+	 * - Presses of other buttons (e.g. joining a channel) are idempotent, so presses that ask for the same
+	 *   thing as the running request are merged into it and otherwise only the latest one is kept
+	 *
+	 * The number of buttons with outstanding requests is bounded. Once the limit has been reached, presses
+	 * of other buttons are rejected (presses of buttons that already have a request running are still
+	 * merged).
+	 *
+	 * Must only be used from the event loop's thread.
+	 */
+	class InFlightTable {
+	public:
+		enum class Kind {
+			/// Executing the request twice is the same as not executing it at all
+			Toggle,
+			/// Executing the request twice is the same as executing it once
+			Idempotent
+		};
+
+		enum class PressResult {
+			/// There is nothing running for the button -> the request has to be started
+			Start,
+			/// The press has been merged into the running (or an already pending) request
+			Merged,
+			/// Too many requests are outstanding -> the press is to be ignored
+			Rejected
+		};
+
+		using Request = std::shared_ptr< const std::string >;
+
+		/**
+		 * @param capacity The maximum number of buttons that may have requests outstanding at the same time
+		 */
+		InFlightTable(std::size_t capacity = 32);
+
+		/**
+		 * Registers a key press
+		 *
+		 * @param context The context of the pressed button
+		 * @param kind How repeated executions of the request behave
+		 * @param request The request the press asks for
+		 * @returns What is to be done about the press
+		 */
+		PressResult press(ContextHandle context, Kind kind, Request request);
+
+		/**
+		 * Has to be called once a request that has been started has finished (no matter whether it succeeded)
+		 *
+		 * @param context The context the request has been started for
+		 * @returns The request that has to be started next for the button (null if there is none)
+		 */
+		Request finish(ContextHandle context);
+
+		/**
+		 * Drops the pending follow-up request of the given button (if any). A request that is running already
+		 * will still be reported as finished.
+		 */
+		void discardPending(ContextHandle context);
+
+		/**
+		 * @returns The number of buttons with outstanding requests
+		 */
+		std::size_t size() const;
+
+	private:
+		struct Entry {
+			Kind kind;
+			/// The request that is currently being executed
+			Request running;
+			/// The request to execute once the running one has finished (null if none)
+			Request pending;
+		};
+
+		std::size_t m_capacity;
+		std::unordered_map< ContextHandle, Entry > m_entries;
+	};
+
+};     // namespace StreamDeckIntegration
+};     // namespace Mumble
+#endif // MUMBLE_STREAMDECK_INTEGRATION_INFLIGHTTABLE_H_
@@ -0,0 +1,206 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#include "InboundMessage.h"
+#include "ESDSDKDefines.h"
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	namespace {
+		void skipWhitespace(std::string_view text, std::size_t &pos) {
+			while (pos < text.size()
+				   && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r')) {
+				pos++;
+			}
+		}
+
+		void expect(std::string_view text, std::size_t pos, char c) {
+			if (pos >= text.size() || text[pos] != c) {
+				throw InboundMessageException(std::string("Expected '") + c + "' at position " + std::to_string(pos));
+			}
+		}
+
+		/**
+		 * @param pos The position of the string's opening quote
+		 * @param hasEscapes Will be set to whether the string contains escape sequences
+		 * @returns The position after the string's closing quote
+		 */
+		std::size_t skipString(std::string_view text, std::size_t pos, bool &hasEscapes) {
+			hasEscapes = false;
+
+			for (std::size_t i = pos + 1; i < text.size(); ++i) {
+				if (text[i] == '\\') {
+					hasEscapes = true;
+					// Skip the escaped character
+					i++;
+				} else if (text[i] == '"') {
+					return i + 1;
+				}
+			}
+
+			throw InboundMessageException("Unterminated string");
+		}
+
+		/**
+		 * @param pos The position of the value's first character
+		 * @returns The position after the value's last character
+		 */
+		std::size_t skipValue(std::string_view text, std::size_t pos) {
+			bool hasEscapes;
+
+			switch (text[pos]) {
+				case '"':
+					return skipString(text, pos, hasEscapes);
+				case '{':
+				case '[': {
+					int depth = 0;
+					for (std::size_t i = pos; i < text.size(); ++i) {
+						switch (text[i]) {
+							case '"':
+								i = skipString(text, i, hasEscapes) - 1;
+								break;
+							case '{':
+							case '[':
+								depth++;
+								break;
+							case '}':
+							case ']':
+								if (--depth == 0) {
+									return i + 1;
+								}
+								break;
+							default:
+								break;
+						}
+					}
+
+					throw InboundMessageException("Unterminated object or array");
+				}
+				default: {
+					// Numbers and literals
+					std::size_t i = pos;
+					while (i < text.size() && text[i] != ',' && text[i] != '}' && text[i] != ']' && text[i] != ' '
+						   && text[i] != '\t' && text[i] != '\n' && text[i] != '\r') {
+						i++;
+					}
+
+					return i;
+				}
+			}
+		}
+	} // namespace
+
+	LazyJSON::LazyJSON(std::string_view serialized) : m_serialized(serialized) {}
+
+	const nlohmann::json &LazyJSON::get() const {
+		if (!m_parsed) {
+			if (!m_serialized.empty()) {
+				m_value = nlohmann::json::parse(m_serialized.begin(), m_serialized.end());
+			}
+
+			m_parsed = true;
+		}
+
+		return m_value;
+	}
+
+	std::string_view LazyJSON::serialized() const { return m_serialized; }
+
+	InboundMessage::InboundMessage(std::string_view message) {
+		std::size_t pos = 0;
+
+		skipWhitespace(message, pos);
+		expect(message, pos, '{');
+		pos++;
+		skipWhitespace(message, pos);
+
+		if (pos < message.size() && message[pos] == '}') {
+			return;
+		}
+
+		while (true) {
+			skipWhitespace(message, pos);
+			expect(message, pos, '"');
+
+			bool hasEscapes;
+			const std::size_t keyEnd = skipString(message, pos, hasEscapes);
+			// The members we are interested in don't need escaping, so we can compare the raw key
+			const std::string_view key = message.substr(pos + 1, keyEnd - pos - 2);
+
+			pos = keyEnd;
+			skipWhitespace(message, pos);
+			expect(message, pos, ':');
+			pos++;
+			skipWhitespace(message, pos);
+
+			if (pos >= message.size()) {
+				throw InboundMessageException("Missing value for member \"" + std::string(key) + "\"");
+			}
+
+			const std::size_t valueStart = pos;
+			pos                          = skipValue(message, pos);
+
+			if (pos == valueStart) {
+				// E.g. {"event": } or {"event":,}
+				throw InboundMessageException("Missing value for member \"" + std::string(key) + "\"");
+			}
+
+			const std::string_view value = message.substr(valueStart, pos - valueStart);
+
+			if (value.front() == '"') {
+				const bool valueHasEscapes = value.find('\\') != std::string_view::npos;
+
+				if (key == kESDSDKCommonEvent) {
+					setString(Event, value, valueHasEscapes);
+				} else if (key == kESDSDKCommonContext) {
+					setString(Context, value, valueHasEscapes);
+				} else if (key == kESDSDKCommonAction) {
+					setString(Action, value, valueHasEscapes);
+				} else if (key == kESDSDKCommonDevice) {
+					setString(Device, value, valueHasEscapes);
+				}
+			} else if (value.front() == '{') {
+				if (key == kESDSDKCommonPayload) {
+					m_payload = LazyJSON(value);
+				} else if (key == kESDSDKCommonDeviceInfo) {
+					m_deviceInfo = LazyJSON(value);
+				}
+			}
+
+			skipWhitespace(message, pos);
+			if (pos < message.size() && message[pos] == ',') {
+				pos++;
+			} else {
+				expect(message, pos, '}');
+				break;
+			}
+		}
+	}
+
+	void InboundMessage::setString(StringMember member, std::string_view value, bool hasEscapes) {
+		if (hasEscapes) {
+			m_unescaped[member] = nlohmann::json::parse(value.begin(), value.end()).get< std::string >();
+			m_strings[member]   = m_unescaped[member];
+		} else {
+			// Strip the quotes
+			m_strings[member] = value.substr(1, value.size() - 2);
+		}
+	}
+
+	std::string_view InboundMessage::event() const { return m_strings[Event]; }
+
+	std::string_view InboundMessage::context() const { return m_strings[Context]; }
+
+	std::string_view InboundMessage::action() const { return m_strings[Action]; }
+
+	std::string_view InboundMessage::device() const { return m_strings[Device]; }
+
+	const LazyJSON &InboundMessage::payload() const { return m_payload; }
+
+	const LazyJSON &InboundMessage::deviceInfo() const { return m_deviceInfo; }
+
+}; // namespace StreamDeckIntegration
+}; // namespace Mumble
@@ -0,0 +1,101 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#ifndef MUMBLE_STREAMDECK_INTEGRATION_INBOUNDMESSAGE_H_
+#define MUMBLE_STREAMDECK_INTEGRATION_INBOUNDMESSAGE_H_
+
+#include <nlohmann/json.hpp>
+
+#include <array>
+#include <cstddef>
+#include <exception>
+#include <string>
+#include <string_view>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	class InboundMessageException : public std::exception {
+	private:
+		std::string m_errorMsg;
+
+	public:
+		InboundMessageException(const std::string &errorMsg) : m_errorMsg(errorMsg) {}
+		InboundMessageException(const std::string &&errorMsg) : m_errorMsg(std::move(errorMsg)) {}
+
+		const char *what() const noexcept override { return m_errorMsg.c_str(); }
+	};
+
+	/**
+	 * A JSON value that is only parsed once it is accessed for the first time. It refers to the
+	 * serialized value, which thus has to outlive it.
+	 */
+	class LazyJSON {
+	public:
+		LazyJSON() = default;
+		explicit LazyJSON(std::string_view serialized);
+
+		/**
+		 * @returns The parsed value (null if there is no value)
+		 *
+		 * @throws nlohmann::json::parse_error If the value is malformed
+		 */
+		const nlohmann::json &get() const;
+
+		/**
+		 * @returns The serialized value
+		 */
+		std::string_view serialized() const;
+
+	private:
+		std::string_view m_serialized;
+		mutable bool m_parsed = false;
+		mutable nlohmann::json m_value;
+	};
+
+	/**
+	 * A message received from the Stream Deck. Instead of building a DOM of the entire message, only the
+	 * boundaries of its top-level members are determined. The strings identifying the event and the
+	 * button it is about are accessed in place and the payload is only parsed if somebody asks for it.
+	 *
+	 * The message refers to the buffer it has been created from, which thus has to outlive it.
+	 */
+	class InboundMessage {
+	public:
+		/**
+		 * @param message The serialized message
+		 *
+		 * @throws InboundMessageException If the message is not a JSON object
+		 */
+		explicit InboundMessage(std::string_view message);
+
+		InboundMessage(const InboundMessage &) = delete;
+		InboundMessage &operator=(const InboundMessage &) = delete;
+
+		// The string members of the message (empty if they don't exist or aren't strings)
+		std::string_view event() const;
+		std::string_view context() const;
+		std::string_view action() const;
+		std::string_view device() const;
+
+		// The object members of the message (null if they don't exist or aren't objects)
+		const LazyJSON &payload() const;
+		const LazyJSON &deviceInfo() const;
+
+	private:
+		enum StringMember { Event = 0, Context, Action, Device, StringMemberCount };
+
+		std::array< std::string_view, StringMemberCount > m_strings;
+		/// Storage for strings that contain escape sequences and thus can't be referred to in place
+		std::array< std::string, StringMemberCount > m_unescaped;
+		LazyJSON m_payload;
+		LazyJSON m_deviceInfo;
+
+		void setString(StringMember member, std::string_view value, bool hasEscapes);
+	};
+
+};     // namespace StreamDeckIntegration
+};     // namespace Mumble
+#endif // MUMBLE_STREAMDECK_INTEGRATION_INBOUNDMESSAGE_H_
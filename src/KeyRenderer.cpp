@@ -0,0 +1,104 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#include "KeyRenderer.h"
+#include "Base64.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <string>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	namespace {
+		/**
+		 * Hashes the given pixels 8 bytes at a time. This only has to tell frames apart and is a lot cheaper than
+		 * encoding a frame.
+		 */
+		std::uint64_t hashPixels(const std::uint8_t *data, std::size_t size) {
+			std::uint64_t hash = 0x9E3779B97F4A7C15ull ^ size;
+
+			std::size_t i = 0;
+			for (; i + 8 <= size; i += 8) {
+				std::uint64_t word;
+				std::memcpy(&word, data + i, sizeof(word));
+
+				hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+				hash ^= hash >> 32;
+			}
+			for (; i < size; ++i) {
+				hash = (hash ^ data[i]) * 0xFF51AFD7ED558CCDull;
+			}
+
+			return hash;
+		}
+	} // namespace
+
+	KeyRenderer::KeyRenderer(unsigned int size, PNGEncoder::Compression compression)
+		: m_canvas(size, size), m_compression(compression) {}
+
+	Bitmap &KeyRenderer::canvas() { return m_canvas; }
+
+	void KeyRenderer::drawBadge(std::string_view text, Color background, Color foreground) {
+		const float margin = scaled(2.0f);
+		const float radius = scaled(16.0f);
+		const float size   = static_cast< float >(m_canvas.width());
+
+		const float centerX = size - margin - radius;
+		const float centerY = margin + radius;
+		m_canvas.fillCircle(centerX, centerY, radius, background);
+
+		// Use the largest font size at which the text fits into the circle
+		int scale = 1;
+		while (static_cast< float >(Bitmap::textWidth(text, scale + 1)) <= 1.5f * radius
+			   && static_cast< float >(Bitmap::textHeight(scale + 1)) <= radius) {
+			scale++;
+		}
+
+		const int x = static_cast< int >(std::lround(centerX - Bitmap::textWidth(text, scale) / 2.0f));
+		const int y = static_cast< int >(std::lround(centerY - Bitmap::textHeight(scale) / 2.0f));
+		m_canvas.drawText(x, y, text, scale, foreground);
+	}
+
+	void KeyRenderer::drawBorder(unsigned int thickness, Color color) {
+		const int width = std::max(static_cast< int >(std::lround(scaled(static_cast< float >(thickness)))), 1);
+		const int size  = static_cast< int >(m_canvas.width());
+
+		m_canvas.fillRect(0, 0, size, width, color);
+		m_canvas.fillRect(0, size - width, size, width, color);
+		m_canvas.fillRect(0, width, width, size - 2 * width, color);
+		m_canvas.fillRect(size - width, width, width, size - 2 * width, color);
+	}
+
+	const EncodedImage &KeyRenderer::finish() {
+		const std::uint64_t hash = hashPixels(m_canvas.data(), m_canvas.width() * m_canvas.height()
+																	* Bitmap::bytesPerPixel);
+		if (m_image.dataURI && m_image.hash == hash) {
+			return m_image;
+		}
+
+		const std::string &png = m_encoder.encode(m_canvas, m_compression);
+
+		// The data URI can't be reused, as the previous one may still be waiting to be sent
+		auto dataURI = std::make_shared< std::string >();
+		dataURI->reserve(EncodedImage::pngDataURIPrefix.size() + Base64::encodedSize(png.size()));
+		dataURI->append(EncodedImage::pngDataURIPrefix);
+		Base64::encode(png, *dataURI);
+
+		m_image.dataURI = std::move(dataURI);
+		m_image.hash    = hash;
+
+		return m_image;
+	}
+
+	float KeyRenderer::scaled(float length) const {
+		return length * static_cast< float >(m_canvas.width()) / static_cast< float >(keySize);
+	}
+
+}; // namespace StreamDeckIntegration
+}; // namespace Mumble
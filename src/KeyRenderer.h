@@ -0,0 +1,82 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#ifndef MUMBLE_STREAMDECK_INTEGRATION_KEYRENDERER_H_
+#define MUMBLE_STREAMDECK_INTEGRATION_KEYRENDERER_H_
+
+#include "Bitmap.h"
+#include "EncodedImage.h"
+#include "PNGEncoder.h"
+
+#include <cstdint>
+#include <string_view>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	/**
+	 * Draws key images at runtime (e.g. to show live data as a badge) and turns them into data URIs that can be
+	 * sent via setImage. The renderer keeps its canvas and buffers, so that drawing a frame only allocates the
+	 * resulting data URI. A frame whose pixels are the same as the previous one's isn't encoded again.
+	 *
+	 * A renderer must only be used by one thread at a time.
+	 */
+	class KeyRenderer {
+	public:
+		/// The size of a key in pixels (high DPI devices use keys twice as large)
+		static constexpr unsigned int keySize = 72;
+
+		/**
+		 * @param size The width and height of the images to draw
+		 * @param compression How to compress the images
+		 */
+		KeyRenderer(unsigned int size = keySize,
+					PNGEncoder::Compression compression = PNGEncoder::Compression::RunLength);
+
+		/**
+		 * @returns The canvas the next frame is drawn onto (it isn't cleared between frames)
+		 */
+		Bitmap &canvas();
+
+		/**
+		 * Draws a badge (a filled circle with the given text in it) into the top right corner of the canvas
+		 *
+		 * @param text The text to show (should be no more than 3 characters)
+		 * @param background The color of the circle
+		 * @param foreground The color of the text
+		 */
+		void drawBadge(std::string_view text, Color background, Color foreground);
+
+		/**
+		 * Draws a frame along the edges of the canvas (e.g. to highlight the key)
+		 *
+		 * @param thickness The frame's thickness in pixels on a key of the regular size
+		 * @param color The color of the frame
+		 */
+		void drawBorder(unsigned int thickness, Color color);
+
+		/**
+		 * Encodes the canvas
+		 *
+		 * @returns The encoded image. Its hash is that of the canvas' pixels.
+		 */
+		const EncodedImage &finish();
+
+	private:
+		Bitmap m_canvas;
+		PNGEncoder m_encoder;
+		PNGEncoder::Compression m_compression;
+		/// The image produced by the last call to finish()
+		EncodedImage m_image;
+
+		/**
+		 * @returns The given length on a key of the regular size scaled to the size of the canvas
+		 */
+		float scaled(float length) const;
+	};
+
+};     // namespace StreamDeckIntegration
+};     // namespace Mumble
+#endif // MUMBLE_STREAMDECK_INTEGRATION_KEYRENDERER_H_
@@ -0,0 +1,296 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#include "Logger.h"
+
+#include <boost/filesystem.hpp>
+
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	namespace {
+		const char *levelName(LogLevel level) {
+			switch (level) {
+				case LogLevel::Debug:
+					return "DEBUG";
+				case LogLevel::Info:
+					return "INFO";
+				case LogLevel::Warning:
+					return "WARNING";
+				case LogLevel::Error:
+					return "ERROR";
+			}
+
+			return "";
+		}
+
+		std::string formatTime(std::chrono::system_clock::time_point time) {
+			const std::time_t seconds = std::chrono::system_clock::to_time_t(time);
+			const long long milliseconds =
+				std::chrono::duration_cast< std::chrono::milliseconds >(time.time_since_epoch()).count() % 1000;
+
+			std::ostringstream stream;
+			// Only ever called from the flusher thread
+			stream << std::put_time(std::localtime(&seconds), "%Y-%m-%d %H:%M:%S") << "." << std::setw(3)
+				   << std::setfill('0') << milliseconds;
+
+			return stream.str();
+		}
+	} // namespace
+
+	LogRateLimit::LogRateLimit(std::uint32_t burst, std::chrono::milliseconds interval)
+		: m_burst(burst), m_interval(interval) {}
+
+	bool LogRateLimit::acquire(std::uint32_t &suppressed) {
+		const std::chrono::steady_clock::rep now = std::chrono::steady_clock::now().time_since_epoch().count();
+
+		std::chrono::steady_clock::rep start = m_intervalStart.load(std::memory_order_relaxed);
+		if (now - start >= m_interval.count() && m_intervalStart.compare_exchange_strong(start, now)) {
+			// A new interval begins (concurrent callers may still count towards the old one, which is fine)
+			m_passed.store(0, std::memory_order_relaxed);
+		}
+
+		if (m_passed.fetch_add(1, std::memory_order_relaxed) >= m_burst) {
+			m_suppressed.fetch_add(1, std::memory_order_relaxed);
+
+			return false;
+		}
+
+		suppressed = m_suppressed.exchange(0, std::memory_order_relaxed);
+
+		return true;
+	}
+
+	Logger::Logger(Sink sink, std::size_t capacity, std::chrono::milliseconds flushInterval)
+		: m_sink(std::move(sink)), m_flushInterval(flushInterval) {
+		std::size_t size = 2;
+		while (size < capacity) {
+			size <<= 1;
+		}
+
+		m_entries = std::make_unique< Entry[] >(size);
+		m_mask    = size - 1;
+		for (std::size_t i = 0; i < size; ++i) {
+			m_entries[i].sequence.store(i, std::memory_order_relaxed);
+		}
+
+		m_flusher = std::thread(&Logger::flusherLoop, this);
+	}
+
+	Logger::~Logger() {
+		{
+			std::lock_guard< std::mutex > guard(m_flusherMutex);
+			m_stop = true;
+		}
+		m_flusherCondition.notify_one();
+
+		m_flusher.join();
+	}
+
+	void Logger::setLevel(LogLevel level) { m_level.store(level, std::memory_order_relaxed); }
+
+	bool Logger::isEnabled(LogLevel level) const { return level >= m_level.load(std::memory_order_relaxed); }
+
+	void Logger::setFile(const std::string &path, std::uintmax_t maxSize, unsigned int keep) {
+		std::lock_guard< std::mutex > guard(m_fileMutex);
+
+		if (path == m_filePath && m_file.is_open() == !path.empty()) {
+			m_fileMaxSize = maxSize;
+			m_fileKeep    = keep;
+			return;
+		}
+
+		m_file.close();
+		m_filePath    = path;
+		m_fileMaxSize = maxSize;
+		m_fileKeep    = keep;
+		m_fileSize    = 0;
+
+		if (!m_filePath.empty()) {
+			boost::system::error_code ec;
+			const std::uintmax_t size = boost::filesystem::file_size(m_filePath, ec);
+
+			m_fileSize = ec ? 0 : size;
+			m_file.open(m_filePath, std::ios::app);
+		}
+	}
+
+	void Logger::log(LogLevel level, std::string message) {
+		if (isEnabled(level)) {
+			push(level, std::move(message));
+		}
+	}
+
+	void Logger::log(LogLevel level, std::string message, LogRateLimit &rateLimit) {
+		if (!isEnabled(level)) {
+			return;
+		}
+
+		std::uint32_t suppressed = 0;
+		if (!rateLimit.acquire(suppressed)) {
+			return;
+		}
+
+		if (suppressed > 0) {
+			message += " (" + std::to_string(suppressed) + " similar messages have been suppressed)";
+		}
+
+		push(level, std::move(message));
+	}
+
+	std::uint64_t Logger::droppedCount() const { return m_droppedCount.load(std::memory_order_relaxed); }
+
+	bool Logger::parseLevel(const std::string &name, LogLevel &level) {
+		if (name == "debug") {
+			level = LogLevel::Debug;
+		} else if (name == "info") {
+			level = LogLevel::Info;
+		} else if (name == "warning") {
+			level = LogLevel::Warning;
+		} else if (name == "error") {
+			level = LogLevel::Error;
+		} else {
+			return false;
+		}
+
+		return true;
+	}
+
+	void Logger::push(LogLevel level, std::string message) {
+		std::size_t position = m_enqueuePosition.load(std::memory_order_relaxed);
+		Entry *entry;
+
+		for (;;) {
+			entry = &m_entries[position & m_mask];
+
+			const std::size_t sequence = entry->sequence.load(std::memory_order_acquire);
+			const std::ptrdiff_t difference =
+				static_cast< std::ptrdiff_t >(sequence) - static_cast< std::ptrdiff_t >(position);
+
+			if (difference == 0) {
+				// The entry is free - try to claim it
+				if (m_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					break;
+				}
+			} else if (difference < 0) {
+				// The flusher hasn't caught up yet
+				m_droppedCount.fetch_add(1, std::memory_order_relaxed);
+				return;
+			} else {
+				// Someone else has claimed the entry in the meantime
+				position = m_enqueuePosition.load(std::memory_order_relaxed);
+			}
+		}
+
+		entry->level   = level;
+		entry->time    = std::chrono::system_clock::now();
+		entry->message = std::move(message);
+		entry->sequence.store(position + 1, std::memory_order_release);
+	}
+
+	void Logger::flusherLoop() {
+		std::unique_lock< std::mutex > lock(m_flusherMutex);
+
+		while (!m_stop) {
+			m_flusherCondition.wait_for(lock, m_flushInterval, [this]() { return m_stop; });
+
+			lock.unlock();
+			flush();
+			lock.lock();
+		}
+	}
+
+	void Logger::flush() {
+		std::string batch;
+		std::string fileLines;
+
+		std::lock_guard< std::mutex > guard(m_fileMutex);
+		const bool toFile = m_file.is_open();
+
+		const auto append = [&](LogLevel level, std::chrono::system_clock::time_point time,
+								const std::string &message) {
+			if (!batch.empty()) {
+				batch += '\n';
+			}
+			if (level != LogLevel::Info) {
+				batch += levelName(level);
+				batch += ": ";
+			}
+			batch += message;
+
+			if (toFile) {
+				fileLines += formatTime(time) + " " + levelName(level) + " " + message + "\n";
+			}
+		};
+
+		for (;;) {
+			Entry &entry = m_entries[m_dequeuePosition & m_mask];
+
+			if (entry.sequence.load(std::memory_order_acquire) != m_dequeuePosition + 1) {
+				// Nothing more has been published
+				break;
+			}
+
+			append(entry.level, entry.time, entry.message);
+			entry.message.clear();
+
+			entry.sequence.store(m_dequeuePosition + m_mask + 1, std::memory_order_release);
+			m_dequeuePosition++;
+		}
+
+		const std::uint64_t dropped = m_droppedCount.load(std::memory_order_relaxed);
+		if (dropped != m_reportedDroppedCount) {
+			append(LogLevel::Warning, std::chrono::system_clock::now(),
+				   std::to_string(dropped - m_reportedDroppedCount)
+					   + " log messages have been dropped as they were logged too quickly");
+			m_reportedDroppedCount = dropped;
+		}
+
+		if (batch.empty()) {
+			return;
+		}
+
+		if (toFile) {
+			writeToFile(fileLines);
+		}
+
+		m_sink(batch);
+	}
+
+	void Logger::writeToFile(const std::string &lines) {
+		if (m_fileSize > 0 && m_fileSize + lines.size() > m_fileMaxSize) {
+			rotateFile();
+		}
+
+		m_file << lines;
+		m_file.flush();
+		m_fileSize += lines.size();
+	}
+
+	void Logger::rotateFile() {
+		m_file.close();
+
+		boost::system::error_code ec;
+		if (m_fileKeep == 0) {
+			boost::filesystem::remove(m_filePath, ec);
+		} else {
+			boost::filesystem::remove(m_filePath + "." + std::to_string(m_fileKeep), ec);
+			for (unsigned int i = m_fileKeep - 1; i > 0; --i) {
+				boost::filesystem::rename(m_filePath + "." + std::to_string(i),
+										  m_filePath + "." + std::to_string(i + 1), ec);
+			}
+			boost::filesystem::rename(m_filePath, m_filePath + ".1", ec);
+		}
+
+		m_file.open(m_filePath, std::ios::trunc);
+		m_fileSize = 0;
+	}
+
+}; // namespace StreamDeckIntegration
+}; // namespace Mumble
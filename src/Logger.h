@@ -0,0 +1,159 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#ifndef MUMBLE_STREAMDECK_INTEGRATION_LOGGER_H_
+#define MUMBLE_STREAMDECK_INTEGRATION_LOGGER_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	enum class LogLevel { Debug = 0, Info, Warning, Error };
+
+	/**
+	 * Limits how often a single place in the code may log. Within every interval, only the first few
+	 * messages pass. The number of messages that have been suppressed in between is reported along with
+	 * the next message that passes. Meant to be used as a static variable at the place that logs.
+	 */
+	class LogRateLimit {
+	public:
+		/**
+		 * @param burst The number of messages that may pass per interval
+		 * @param interval The length of an interval
+		 */
+		LogRateLimit(std::uint32_t burst = 5, std::chrono::milliseconds interval = std::chrono::seconds(10));
+
+		/**
+		 * @param suppressed Is set to the number of messages that have been suppressed since the last one that
+		 * 	passed
+		 * @returns Whether the message may pass
+		 */
+		bool acquire(std::uint32_t &suppressed);
+
+	private:
+		const std::uint32_t m_burst;
+		const std::chrono::steady_clock::duration m_interval;
+		std::atomic< std::chrono::steady_clock::rep > m_intervalStart = { 0 };
+		std::atomic< std::uint32_t > m_passed                         = { 0 };
+		std::atomic< std::uint32_t > m_suppressed                     = { 0 };
+	};
+
+	/**
+	 * Collects log messages from any number of threads and writes them out on a background thread. Logging
+	 * never blocks: messages are put into a fixed-size lock-free ring buffer (and dropped if it is full).
+	 * Every now and then, the flusher thread hands all collected messages as a single batch to the sink
+	 * and (optionally) appends them to a local log file, which is rotated once it becomes too large.
+	 */
+	class Logger {
+	public:
+		/**
+		 * Receives a batch of log lines (separated by newlines). Called on the flusher thread.
+		 */
+		using Sink = std::function< void(const std::string &batch) >;
+
+		/**
+		 * @param sink The sink to hand the messages to
+		 * @param capacity The number of messages that can be buffered (rounded up to a power of two)
+		 * @param flushInterval How often the buffered messages are written out
+		 */
+		Logger(Sink sink, std::size_t capacity = 1024,
+			   std::chrono::milliseconds flushInterval = std::chrono::milliseconds(250));
+		/**
+		 * Writes out everything that is still buffered and stops the flusher thread
+		 */
+		~Logger();
+
+		Logger(const Logger &) = delete;
+		Logger &operator=(const Logger &) = delete;
+
+		void setLevel(LogLevel level);
+		bool isEnabled(LogLevel level) const;
+
+		/**
+		 * Makes the logger (additionally) write to the given file. Once the file exceeds the given size, it is
+		 * renamed (to <path>.1, with older files being shifted to <path>.2 and so on) and a new file is started.
+		 *
+		 * @param path The path of the log file (if empty, no file is written)
+		 * @param maxSize The size in bytes after which the file is rotated
+		 * @param keep The number of rotated files to keep
+		 */
+		void setFile(const std::string &path, std::uintmax_t maxSize = 1024 * 1024, unsigned int keep = 3);
+
+		/**
+		 * Logs the given message (if the level is enabled). May be called from any thread.
+		 */
+		void log(LogLevel level, std::string message);
+		/**
+		 * Logs the given message (if the level is enabled and the rate limit allows for it). May be called from
+		 * any thread.
+		 */
+		void log(LogLevel level, std::string message, LogRateLimit &rateLimit);
+
+		/**
+		 * @returns The number of messages that have been dropped because the buffer was full
+		 */
+		std::uint64_t droppedCount() const;
+
+		/**
+		 * Parses the name of a log level ("debug", "info", "warning" or "error")
+		 *
+		 * @returns Whether the name is valid
+		 */
+		static bool parseLevel(const std::string &name, LogLevel &level);
+
+	private:
+		struct Entry {
+			std::atomic< std::size_t > sequence;
+			LogLevel level;
+			std::chrono::system_clock::time_point time;
+			std::string message;
+		};
+
+		Sink m_sink;
+		std::atomic< LogLevel > m_level = { LogLevel::Info };
+
+		// A bounded multi-producer queue (Dmitry Vyukov's design) that is consumed by the flusher only
+		std::unique_ptr< Entry[] > m_entries;
+		std::size_t m_mask;
+		std::atomic< std::size_t > m_enqueuePosition = { 0 };
+		std::size_t m_dequeuePosition                = 0;
+		std::atomic< std::uint64_t > m_droppedCount  = { 0 };
+		std::uint64_t m_reportedDroppedCount         = 0;
+
+		// Only touched by the flusher thread (and setFile)
+		std::mutex m_fileMutex;
+		std::string m_filePath;
+		std::uintmax_t m_fileMaxSize = 0;
+		unsigned int m_fileKeep      = 0;
+		std::ofstream m_file;
+		std::uintmax_t m_fileSize = 0;
+
+		std::chrono::milliseconds m_flushInterval;
+		std::mutex m_flusherMutex;
+		std::condition_variable m_flusherCondition;
+		bool m_stop = false;
+		std::thread m_flusher;
+
+		void push(LogLevel level, std::string message);
+		void flusherLoop();
+		void flush();
+		void writeToFile(const std::string &lines);
+		void rotateFile();
+	};
+
+};     // namespace StreamDeckIntegration
+};     // namespace Mumble
+#endif // MUMBLE_STREAMDECK_INTEGRATION_LOGGER_H_
@@ -0,0 +1,306 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#include "MessageWriter.h"
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	namespace {
+		constexpr std::string_view imagePrefix = "data:image/png;base64,";
+		/// U+FFFD, which takes the place of invalid UTF-8
+		constexpr std::string_view replacementCharacter = "\xEF\xBF\xBD";
+
+		struct UTF8Sequence {
+			std::size_t length;
+			bool valid;
+		};
+
+		/**
+		 * Checks the multi-byte UTF-8 sequence starting at the given position (see table 3-7 of the Unicode
+		 * standard, which also rules out overlong encodings and surrogates)
+		 *
+		 * @returns The sequence's length and whether it is valid. For an invalid sequence, the length is that
+		 * 	of its maximal subpart (at least one byte), which is to be replaced as a whole.
+		 */
+		UTF8Sequence checkUTF8Sequence(std::string_view str, std::size_t pos) {
+			const unsigned char lead = static_cast< unsigned char >(str[pos]);
+
+			std::size_t length;
+			unsigned char lower = 0x80;
+			unsigned char upper = 0xBF;
+
+			if (lead >= 0xC2 && lead <= 0xDF) {
+				length = 2;
+			} else if (lead >= 0xE0 && lead <= 0xEF) {
+				length = 3;
+				lower  = lead == 0xE0 ? 0xA0 : lower;
+				upper  = lead == 0xED ? 0x9F : upper;
+			} else if (lead >= 0xF0 && lead <= 0xF4) {
+				length = 4;
+				lower  = lead == 0xF0 ? 0x90 : lower;
+				upper  = lead == 0xF4 ? 0x8F : upper;
+			} else {
+				return { 1, false };
+			}
+
+			for (std::size_t i = 1; i < length; ++i) {
+				if (pos + i >= str.size()) {
+					return { i, false };
+				}
+
+				const unsigned char c = static_cast< unsigned char >(str[pos + i]);
+				if (c < lower || c > upper) {
+					return { i, false };
+				}
+
+				lower = 0x80;
+				upper = 0xBF;
+			}
+
+			return { length, true };
+		}
+	} // namespace
+
+	MessageWriter::MessageWriter() {
+		// Large enough for all regular messages (images will grow the buffer once)
+		m_buffer.reserve(1024);
+	}
+
+	const std::string &MessageWriter::registerPlugin(std::string_view registerEvent, std::string_view pluginUUID) {
+		m_buffer.clear();
+		m_buffer += '{';
+		appendKey(kESDSDKCommonEvent);
+		appendString(m_buffer, registerEvent);
+		m_buffer += ',';
+		appendKey(kESDSDKRegisterUUID);
+		appendString(m_buffer, pluginUUID);
+
+		return end();
+	}
+
+	const std::string &MessageWriter::setTitle(std::string_view title, std::string_view context,
+											   ESDSDKTarget target) {
+		begin(kESDSDKEventSetTitle, context);
+		m_buffer += ',';
+		appendKey(kESDSDKCommonPayload);
+		m_buffer += '{';
+		appendKey(kESDSDKPayloadTarget);
+		m_buffer += std::to_string(target);
+		m_buffer += ',';
+		appendKey(kESDSDKPayloadTitle);
+		appendString(m_buffer, title);
+		m_buffer += '}';
+
+		return end();
+	}
+
+	const std::string &MessageWriter::setImage(std::string_view base64ImageString, std::string_view context,
+											   ESDSDKTarget target) {
+		begin(kESDSDKEventSetImage, context);
+		m_buffer += ',';
+		appendKey(kESDSDKCommonPayload);
+		m_buffer += '{';
+		appendKey(kESDSDKPayloadTarget);
+		m_buffer += std::to_string(target);
+		m_buffer += ',';
+		appendKey(kESDSDKPayloadImage);
+
+		if (base64ImageString.empty() || base64ImageString.substr(0, imagePrefix.size()) == imagePrefix) {
+			appendString(m_buffer, base64ImageString);
+		} else {
+			// Base64 doesn't contain any characters that would need escaping
+			m_buffer += '"';
+			m_buffer += imagePrefix;
+			m_buffer += base64ImageString;
+			m_buffer += '"';
+		}
+		m_buffer += '}';
+
+		return end();
+	}
+
+	const std::string &MessageWriter::showAlert(std::string_view context) {
+		begin(kESDSDKEventShowAlert, context);
+
+		return end();
+	}
+
+	const std::string &MessageWriter::showOK(std::string_view context) {
+		begin(kESDSDKEventShowOK, context);
+
+		return end();
+	}
+
+	const std::string &MessageWriter::setSettings(const nlohmann::json &settings, std::string_view context) {
+		begin(kESDSDKEventSetSettings, context);
+		m_buffer += ',';
+		appendKey(kESDSDKCommonPayload);
+		appendJSON(settings);
+
+		return end();
+	}
+
+	const std::string &MessageWriter::getGlobalSettings(std::string_view pluginUUID) {
+		begin(kESDSDKEventGetGlobalSettings, pluginUUID);
+
+		return end();
+	}
+
+	const std::string &MessageWriter::setState(int state, std::string_view context) {
+		begin(kESDSDKEventSetState, context);
+		m_buffer += ',';
+		appendKey(kESDSDKCommonPayload);
+		m_buffer += '{';
+		appendKey(kESDSDKPayloadState);
+		m_buffer += std::to_string(state);
+		m_buffer += '}';
+
+		return end();
+	}
+
+	const std::string &MessageWriter::sendToPropertyInspector(std::string_view action, std::string_view context,
+															  const nlohmann::json &payload) {
+		begin(kESDSDKEventSendToPropertyInspector, context);
+		m_buffer += ',';
+		appendKey(kESDSDKCommonAction);
+		appendString(m_buffer, action);
+		m_buffer += ',';
+		appendKey(kESDSDKCommonPayload);
+		appendJSON(payload);
+
+		return end();
+	}
+
+	const std::string &MessageWriter::switchToProfile(std::string_view pluginUUID, std::string_view deviceID,
+													  std::string_view profileName) {
+		begin(kESDSDKEventSwitchToProfile, pluginUUID);
+		m_buffer += ',';
+		appendKey(kESDSDKCommonDevice);
+		appendString(m_buffer, deviceID);
+
+		if (!profileName.empty()) {
+			m_buffer += ',';
+			appendKey(kESDSDKCommonPayload);
+			m_buffer += '{';
+			appendKey(kESDSDKPayloadProfile);
+			appendString(m_buffer, profileName);
+			m_buffer += '}';
+		}
+
+		return end();
+	}
+
+	const std::string &MessageWriter::logMessage(std::string_view message) {
+		m_buffer.clear();
+		m_buffer += '{';
+		appendKey(kESDSDKCommonEvent);
+		appendString(m_buffer, kESDSDKEventLogMessage);
+		m_buffer += ',';
+		appendKey(kESDSDKCommonPayload);
+		m_buffer += '{';
+		appendKey(kESDSDKPayloadMessage);
+		appendString(m_buffer, message);
+		m_buffer += '}';
+
+		return end();
+	}
+
+	void MessageWriter::appendString(std::string &buffer, std::string_view str) {
+		static constexpr char hexDigits[] = "0123456789abcdef";
+
+		buffer += '"';
+
+		std::size_t runStart = 0;
+		for (std::size_t i = 0; i < str.size(); ++i) {
+			const unsigned char c = static_cast< unsigned char >(str[i]);
+
+			if (c >= 0x80) {
+				const UTF8Sequence sequence = checkUTF8Sequence(str, i);
+
+				if (!sequence.valid) {
+					// The Stream Deck software rejects messages that aren't valid UTF-8 (nlohmann::json used to
+					// throw instead)
+					buffer.append(str.data() + runStart, i - runStart);
+					buffer += replacementCharacter;
+					runStart = i + sequence.length;
+				}
+
+				i += sequence.length - 1;
+				continue;
+			}
+
+			if (c >= 0x20 && c != '"' && c != '\\') {
+				continue;
+			}
+
+			// Flush everything up to here that didn't need escaping
+			buffer.append(str.data() + runStart, i - runStart);
+			runStart = i + 1;
+
+			switch (c) {
+				case '"':
+					buffer += "\\\"";
+					break;
+				case '\\':
+					buffer += "\\\\";
+					break;
+				case '\b':
+					buffer += "\\b";
+					break;
+				case '\f':
+					buffer += "\\f";
+					break;
+				case '\n':
+					buffer += "\\n";
+					break;
+				case '\r':
+					buffer += "\\r";
+					break;
+				case '\t':
+					buffer += "\\t";
+					break;
+				default:
+					buffer += "\\u00";
+					buffer += hexDigits[c >> 4];
+					buffer += hexDigits[c & 0xF];
+					break;
+			}
+		}
+		buffer.append(str.data() + runStart, str.size() - runStart);
+
+		buffer += '"';
+	}
+
+	void MessageWriter::begin(const char *event, std::string_view context) {
+		m_buffer.clear();
+		m_buffer += '{';
+		appendKey(kESDSDKCommonEvent);
+		appendString(m_buffer, event);
+		m_buffer += ',';
+		appendKey(kESDSDKCommonContext);
+		appendString(m_buffer, context);
+	}
+
+	void MessageWriter::appendKey(const char *key) {
+		// None of the keys we use need escaping
+		m_buffer += '"';
+		m_buffer += key;
+		m_buffer += "\":";
+	}
+
+	void MessageWriter::appendJSON(const nlohmann::json &json) {
+		// These messages are rare enough to not bother with serializing them in place
+		m_buffer += json.dump();
+	}
+
+	const std::string &MessageWriter::end() {
+		m_buffer += '}';
+
+		return m_buffer;
+	}
+
+}; // namespace StreamDeckIntegration
+}; // namespace Mumble
@@ -0,0 +1,63 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#ifndef MUMBLE_STREAMDECK_INTEGRATION_MESSAGEWRITER_H_
+#define MUMBLE_STREAMDECK_INTEGRATION_MESSAGEWRITER_H_
+
+#include "ESDSDKDefines.h"
+
+#include <nlohmann/json.hpp>
+
+#include <string>
+#include <string_view>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	/**
+	 * Serializes the messages that are sent to the Stream Deck application. As all of these messages have
+	 * a fixed shape, they are written straight into an internal buffer instead of going through a JSON DOM.
+	 * The buffer is reused for every message, so once it has grown large enough, writing a message doesn't
+	 * allocate any memory.
+	 *
+	 * Every function returns a reference to the internal buffer, which stays valid until the next message
+	 * is written.
+	 */
+	class MessageWriter {
+	public:
+		MessageWriter();
+
+		const std::string &registerPlugin(std::string_view registerEvent, std::string_view pluginUUID);
+		const std::string &setTitle(std::string_view title, std::string_view context, ESDSDKTarget target);
+		const std::string &setImage(std::string_view base64ImageString, std::string_view context, ESDSDKTarget target);
+		const std::string &showAlert(std::string_view context);
+		const std::string &showOK(std::string_view context);
+		const std::string &setSettings(const nlohmann::json &settings, std::string_view context);
+		const std::string &getGlobalSettings(std::string_view pluginUUID);
+		const std::string &setState(int state, std::string_view context);
+		const std::string &sendToPropertyInspector(std::string_view action, std::string_view context,
+												   const nlohmann::json &payload);
+		const std::string &switchToProfile(std::string_view pluginUUID, std::string_view deviceID,
+										   std::string_view profileName);
+		const std::string &logMessage(std::string_view message);
+
+		/**
+		 * Appends the given string as a (quoted and escaped) JSON string to the given buffer. Invalid UTF-8
+		 * sequences are replaced by U+FFFD, so the result is always valid JSON.
+		 */
+		static void appendString(std::string &buffer, std::string_view str);
+
+	private:
+		std::string m_buffer;
+
+		void begin(const char *event, std::string_view context);
+		void appendKey(const char *key);
+		void appendJSON(const nlohmann::json &json);
+		const std::string &end();
+	};
+
+};     // namespace StreamDeckIntegration
+};     // namespace Mumble
+#endif // MUMBLE_STREAMDECK_INTEGRATION_MESSAGEWRITER_H_
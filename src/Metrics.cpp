@@ -0,0 +1,221 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#include "Metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	namespace {
+		constexpr std::array< const char *, Metrics::stageCount > stageNames = {
+			"receive_to_dispatch", "cli_resolve", "spawn", "bridge_wait", "response_parse", "ui_update", "reconnect",
+			"press_to_transmit"
+		};
+
+		constexpr std::array< const char *, Metrics::counterCount > counterNames = {
+			"sends", "errors", "dropped", "coalesced", "resent", "merged", "rejected"
+		};
+
+		double toMicroseconds(std::chrono::nanoseconds duration) {
+			return std::chrono::duration< double, std::micro >(duration).count();
+		}
+	} // namespace
+
+	void LatencyHistogram::record(std::chrono::nanoseconds latency) {
+		const std::uint64_t value = static_cast< std::uint64_t >(std::max< std::int64_t >(latency.count(), 0));
+
+		m_buckets[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+		m_count.fetch_add(1, std::memory_order_relaxed);
+
+		std::uint64_t currentMax = m_max.load(std::memory_order_relaxed);
+		while (value > currentMax && !m_max.compare_exchange_weak(currentMax, value, std::memory_order_relaxed)) {
+		}
+	}
+
+	std::uint64_t LatencyHistogram::count() const { return m_count.load(std::memory_order_relaxed); }
+
+	std::chrono::nanoseconds LatencyHistogram::percentile(double percentile) const {
+		std::array< std::uint64_t, bucketCount > counts;
+		std::uint64_t total = 0;
+		for (std::size_t i = 0; i < bucketCount; ++i) {
+			counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+			total += counts[i];
+		}
+
+		if (total == 0) {
+			return std::chrono::nanoseconds(0);
+		}
+
+		const std::uint64_t rank =
+			std::max< std::uint64_t >(1, static_cast< std::uint64_t >(std::ceil(percentile / 100 * total)));
+
+		std::uint64_t seen = 0;
+		std::size_t i      = 0;
+		for (; i < bucketCount - 1; ++i) {
+			seen += counts[i];
+
+			if (seen >= rank) {
+				break;
+			}
+		}
+
+		// The bucket's bound may lie above anything that has actually been recorded (and the last bucket
+		// has no bound at all)
+		return std::chrono::nanoseconds(std::min(upperBoundOf(i), m_max.load(std::memory_order_relaxed)));
+	}
+
+	std::chrono::nanoseconds LatencyHistogram::max() const {
+		return std::chrono::nanoseconds(m_max.load(std::memory_order_relaxed));
+	}
+
+	std::size_t LatencyHistogram::bucketOf(std::uint64_t value) {
+		constexpr std::uint64_t subBucketCount = 1 << subBucketBits;
+
+		if (value < subBucketCount) {
+			return static_cast< std::size_t >(value);
+		}
+
+		unsigned int magnitude = 0;
+		while ((value >> magnitude) > 1) {
+			magnitude++;
+		}
+
+		if (magnitude > maxMagnitude) {
+			return bucketCount - 1;
+		}
+
+		// The top bits (below the leading one) select the sub-bucket
+		const unsigned int shift = magnitude - subBucketBits;
+
+		return ((shift + 1) << subBucketBits) + static_cast< std::size_t >((value >> shift) & (subBucketCount - 1));
+	}
+
+	std::uint64_t LatencyHistogram::upperBoundOf(std::size_t bucket) {
+		constexpr std::uint64_t subBucketCount = 1 << subBucketBits;
+
+		if (bucket < subBucketCount) {
+			return bucket;
+		} else if (bucket == bucketCount - 1) {
+			return std::numeric_limits< std::uint64_t >::max();
+		}
+
+		const unsigned int shift       = static_cast< unsigned int >(bucket >> subBucketBits) - 1;
+		const std::uint64_t lowerBound = (subBucketCount + (bucket & (subBucketCount - 1))) << shift;
+
+		return lowerBound + (std::uint64_t(1) << shift) - 1;
+	}
+
+	Metrics::Recorder::Recorder(Metrics &metrics, ActionHandle action) : m_metrics(&metrics), m_action(action) {}
+
+	void Metrics::Recorder::record(Stage stage, std::chrono::nanoseconds latency) const {
+		if (m_metrics) {
+			m_metrics->record(m_action, stage, latency);
+		}
+	}
+
+	Metrics::Metrics() : m_actions(std::make_unique< ActionMetrics[] >(maxTrackedActions + 1)) {}
+
+	void Metrics::record(ActionHandle action, Stage stage, std::chrono::nanoseconds latency) {
+		slotOf(action).stages[static_cast< std::size_t >(stage)].record(latency);
+		m_sampleCount.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void Metrics::increment(ActionHandle action, Counter counter) {
+		slotOf(action).counters[static_cast< std::size_t >(counter)].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	std::uint64_t Metrics::sampleCount() const { return m_sampleCount.load(std::memory_order_relaxed); }
+
+	nlohmann::json Metrics::toJSON(const IDTable< ActionHandle > &actions) const {
+		nlohmann::json result = nlohmann::json::object();
+
+		for (std::size_t slot = 0; slot <= maxTrackedActions; ++slot) {
+			const ActionMetrics &current = m_actions[slot];
+
+			nlohmann::json stages = nlohmann::json::object();
+			for (std::size_t i = 0; i < stageCount; ++i) {
+				const LatencyHistogram &histogram = current.stages[i];
+				if (histogram.count() == 0) {
+					continue;
+				}
+
+				stages[stageNames[i]] = { { "count", histogram.count() },
+										  { "p50_us", toMicroseconds(histogram.percentile(50)) },
+										  { "p90_us", toMicroseconds(histogram.percentile(90)) },
+										  { "p99_us", toMicroseconds(histogram.percentile(99)) },
+										  { "max_us", toMicroseconds(histogram.max()) } };
+			}
+
+			nlohmann::json counters = nlohmann::json::object();
+			bool hasCounts          = false;
+			for (std::size_t i = 0; i < counterCount; ++i) {
+				const std::uint64_t value = current.counters[i].load(std::memory_order_relaxed);
+				counters[counterNames[i]] = value;
+				hasCounts                 = hasCounts || value > 0;
+			}
+
+			if (stages.empty() && !hasCounts) {
+				continue;
+			}
+
+			result[slotName(slot, actions)] = { { "stages", std::move(stages) }, { "counters", std::move(counters) } };
+		}
+
+		return result;
+	}
+
+	std::vector< std::string > Metrics::summarize(const IDTable< ActionHandle > &actions) const {
+		std::vector< std::string > lines;
+
+		const nlohmann::json metrics = toJSON(actions);
+		for (auto action = metrics.begin(); action != metrics.end(); ++action) {
+			std::ostringstream line;
+			line.setf(std::ios::fixed);
+			line.precision(0);
+
+			line << "Metrics for " << action.key() << ":";
+
+			const nlohmann::json &stages = action.value()["stages"];
+			for (auto stage = stages.begin(); stage != stages.end(); ++stage) {
+				line << " " << stage.key() << " p50=" << stage.value()["p50_us"].get< double >()
+					 << "us p99=" << stage.value()["p99_us"].get< double >() << "us (n=" << stage.value()["count"]
+					 << ");";
+			}
+
+			const nlohmann::json &counters = action.value()["counters"];
+			for (auto counter = counters.begin(); counter != counters.end(); ++counter) {
+				line << " " << counter.key() << "=" << counter.value();
+			}
+
+			lines.push_back(line.str());
+		}
+
+		return lines;
+	}
+
+	Metrics::ActionMetrics &Metrics::slotOf(ActionHandle action) {
+		return m_actions[std::min< std::size_t >(action.value, maxTrackedActions)];
+	}
+
+	std::string Metrics::slotName(std::size_t slot, const IDTable< ActionHandle > &actions) {
+		if (slot == 0) {
+			return "plugin";
+		} else if (slot == maxTrackedActions) {
+			return "other actions";
+		}
+
+		ActionHandle action;
+		action.value = static_cast< std::uint32_t >(slot);
+
+		return actions.get(action);
+	}
+
+}; // namespace StreamDeckIntegration
+}; // namespace Mumble
@@ -0,0 +1,165 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#ifndef MUMBLE_STREAMDECK_INTEGRATION_METRICS_H_
+#define MUMBLE_STREAMDECK_INTEGRATION_METRICS_H_
+
+#include "IDTable.h"
+
+#include <nlohmann/json.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	/**
+	 * A histogram of latencies that can be recorded into from any number of threads without locking. The
+	 * buckets are laid out logarithmically with 8 linear sub-buckets per power of two (as in HDR histograms),
+	 * so any value is reported with an error of at most 12.5%. Latencies of up to about a minute are
+	 * distinguished, everything above that ends up in the last bucket.
+	 */
+	class LatencyHistogram {
+	public:
+		void record(std::chrono::nanoseconds latency);
+
+		std::uint64_t count() const;
+
+		/**
+		 * @param percentile The percentile to compute (0 - 100)
+		 * @returns The (upper bound of the bucket of the) latency below which the given percentage of
+		 * 	samples lie. Samples that are recorded concurrently may or may not be taken into account.
+		 */
+		std::chrono::nanoseconds percentile(double percentile) const;
+
+		std::chrono::nanoseconds max() const;
+
+	private:
+		static constexpr unsigned int subBucketBits = 3;
+		static constexpr unsigned int maxMagnitude  = 36;
+		static constexpr std::size_t bucketCount    = (maxMagnitude - subBucketBits + 2) << subBucketBits;
+
+		std::array< std::atomic< std::uint64_t >, bucketCount > m_buckets = {};
+		std::atomic< std::uint64_t > m_count                              = { 0 };
+		std::atomic< std::uint64_t > m_max                                = { 0 };
+
+		static std::size_t bucketOf(std::uint64_t value);
+		static std::uint64_t upperBoundOf(std::size_t bucket);
+	};
+
+	/**
+	 * Keeps latency histograms for the stages every key press (and every other message) goes through as well
+	 * as some counters, separately for every action. Everything that isn't associated with an action (e.g.
+	 * device events or state queries) is accounted to the plugin itself.
+	 *
+	 * Recording is lock-free and may happen from any thread.
+	 */
+	class Metrics {
+	public:
+		enum class Stage {
+			/// From receiving a message from the Stream Deck until it is handed to the plugin (parsing it and
+			/// looking up its IDs, but not the plugin's handling of it)
+			ReceiveToDispatch = 0,
+			/// Locating the bridge's CLI
+			CLIResolve,
+			/// Launching the CLI
+			Spawn,
+			/// Waiting for the bridge (or the CLI) to answer
+			BridgeWait,
+			/// Parsing the CLI's response
+			ResponseParse,
+			/// From handing the response to the event loop until the resulting button updates have been queued
+			UIUpdate,
+			/// From losing the connection to the Stream Deck until it has been re-established
+			Reconnect,
+			/// From a push-to-talk button being pressed until the bridge has activated the microphone
+			PressToTransmit
+		};
+		static constexpr std::size_t stageCount = 8;
+
+		enum class Counter {
+			/// Messages sent to the Stream Deck
+			Sends = 0,
+			/// Errors reported
+			Errors,
+			/// Button updates that have been dropped as they wouldn't have changed anything
+			Dropped,
+			/// Button updates that have been replaced by a newer one before being sent
+			Coalesced,
+			/// Messages that have piled up while there was no connection and have been sent after reconnecting
+			Resent,
+			/// Key presses that have been merged into a request that was still running
+			Merged,
+			/// Key presses that have been ignored as too many requests were outstanding
+			Rejected
+		};
+		static constexpr std::size_t counterCount = 7;
+
+		/**
+		 * Records stages for a fixed action. Default-constructed recorders don't record anything.
+		 */
+		class Recorder {
+		public:
+			Recorder() = default;
+			Recorder(Metrics &metrics, ActionHandle action);
+
+			void record(Stage stage, std::chrono::nanoseconds latency) const;
+
+		private:
+			Metrics *m_metrics = nullptr;
+			ActionHandle m_action;
+		};
+
+		Metrics();
+
+		Metrics(const Metrics &) = delete;
+		Metrics &operator=(const Metrics &) = delete;
+
+		void record(ActionHandle action, Stage stage, std::chrono::nanoseconds latency);
+		void increment(ActionHandle action, Counter counter);
+
+		/**
+		 * @returns The number of latencies recorded so far (over all actions and stages)
+		 */
+		std::uint64_t sampleCount() const;
+
+		/**
+		 * @param actions The table to look up the actions' IDs in
+		 * @returns All non-empty histograms (as count and percentiles in microseconds) and counters by action
+		 */
+		nlohmann::json toJSON(const IDTable< ActionHandle > &actions) const;
+
+		/**
+		 * @param actions The table to look up the actions' IDs in
+		 * @returns A human-readable summary per action (for the log)
+		 */
+		std::vector< std::string > summarize(const IDTable< ActionHandle > &actions) const;
+
+	private:
+		/// Actions with larger handles share a single slot
+		static constexpr std::size_t maxTrackedActions = 16;
+
+		struct ActionMetrics {
+			std::array< LatencyHistogram, stageCount > stages;
+			std::array< std::atomic< std::uint64_t >, counterCount > counters = {};
+		};
+
+		std::unique_ptr< ActionMetrics[] > m_actions;
+		std::atomic< std::uint64_t > m_sampleCount = { 0 };
+
+		ActionMetrics &slotOf(ActionHandle action);
+		static std::string slotName(std::size_t slot, const IDTable< ActionHandle > &actions);
+	};
+
+};     // namespace StreamDeckIntegration
+};     // namespace Mumble
+#endif // MUMBLE_STREAMDECK_INTEGRATION_METRICS_H_
@@ -5,75 +5,855 @@
 
 #include "MumblePlugin.h"
 #include "ConnectionManager.h"
+#include "KeyRenderer.h"
 #include "MumbleActionIDs.h"
 #include "MumbleSettingIDs.h"
+#include "Utils.h"
 
-#include <boost/algorithm/string.hpp>
-#include <boost/process.hpp>
-
+#include <chrono>
+#include <limits>
 #include <string>
+#include <vector>
 
 namespace Mumble {
 namespace StreamDeckIntegration {
 
-	void MumblePlugin::keyDownForAction(const std::string &actionID, const std::string &context,
-										const nlohmann::json &payload, const std::string &deviceID) {
-		try {
-			boost::filesystem::path cliPath = findCLI();
-			const nlohmann::json action     = getJSONForAction(actionID, m_settings);
-			nlohmann::json response         = executeAction(action, cliPath);
+	namespace {
+		using Clock = std::chrono::steady_clock;
+
+		/// The key that state queries are serialized on in the executor (buttons use their context's handle)
+		constexpr ActionExecutor::Key stateQueryKey = std::numeric_limits< ActionExecutor::Key >::max();
+		/// The key that batches of Multi Action requests are serialized on
+		constexpr ActionExecutor::Key multiActionKey = stateQueryKey - 1;
+		/// The key that user count queries are serialized on
+		constexpr ActionExecutor::Key userCountQueryKey = stateQueryKey - 2;
+
+		/// The Stream Deck fires the actions of a Multi Action right after one another. Everything that arrives
+		/// within this window is sent to the bridge as a single batch.
+		constexpr std::chrono::milliseconds multiActionBurstWindow(10);
+
+		constexpr std::chrono::seconds statePollInterval(2);
+
+		/// How long executing a single action may take (including falling back to the CLI)
+		constexpr std::chrono::milliseconds actionTimeout(5000);
+		/// How long to wait for the bridge before falling back to the CLI
+		constexpr std::chrono::milliseconds bridgeTimeout(2000);
+
+		/// How long settings have to remain unchanged before they are persisted
+		constexpr std::chrono::milliseconds settingsSettleTime(500);
+
+		/// The image of a join-channel button while the local user is in the button's channel
+		const std::string joinChannelActiveImage = "joinChannel_icon_active";
+
+		constexpr std::size_t talkingFrameCount = 8;
+		constexpr std::chrono::milliseconds talkingFrameInterval(100);
+		/// Plenty for the few buttons that are animated at once, while leaving the connection to everything else
+		constexpr FrameScheduler::Budget animationBudget = { 40, 256 * 1024 };
+
+		/**
+		 * Determines which part of the local user's state the button for the given action displays
+		 *
+		 * @returns Whether the button displays state at all
+		 */
+		bool getDisplayedField(const std::string &actionID, MumbleStateCache::Field &field) {
+			if (actionID == MUMBLE_STREAMDECK_TOGGLE_LOCAL_USER_MUTE_ACTION_UUID) {
+				field = MumbleStateCache::Field::Muted;
+				return true;
+			} else if (actionID == MUMBLE_STREAMDECK_TOGGLE_LOCAL_USER_DEAF_ACTION_UUID) {
+				field = MumbleStateCache::Field::Deafened;
+				return true;
+			} else if (actionID == MUMBLE_STREAMDECK_JOIN_CHANNEL_ACTION_UUID) {
+				field = MumbleStateCache::Field::Channel;
+				return true;
+			}
+
+			return false;
+		}
+
+		/**
+		 * @returns The frames of the animation shown on push-to-talk buttons while talking (a ring spreading out
+		 * from the middle of the button)
+		 */
+		const std::vector< EncodedImage > &getTalkingFrames() {
+			static const std::vector< EncodedImage > frames = []() {
+				// Drawn for high DPI devices (the Stream Deck scales them down for all others)
+				KeyRenderer renderer(2 * KeyRenderer::keySize);
+				Bitmap &canvas = renderer.canvas();
+
+				const float center     = static_cast< float >(canvas.width()) / 2.0f;
+				const Color background = { 30, 30, 40, 255 };
+				const Color active     = { 40, 200, 90, 255 };
+
+				std::vector< EncodedImage > result;
+				for (std::size_t i = 0; i < talkingFrameCount; ++i) {
+					const float progress = static_cast< float >(i) / static_cast< float >(talkingFrameCount);
+					const float radius   = center * (0.4f + 0.5f * progress);
+
+					// The ring fades out while it spreads
+					Color ring = active;
+					ring.a     = static_cast< std::uint8_t >(255.0f * (1.0f - progress));
+
+					canvas.clear(background);
+					canvas.fillCircle(center, center, radius, ring);
+					canvas.fillCircle(center, center, radius - center * 0.08f, background);
+					canvas.fillCircle(center, center, center * 0.3f, active);
+					renderer.drawBorder(3, active);
+
+					result.push_back(renderer.finish());
+				}
+
+				return result;
+			}();
+
+			return frames;
+		}
+
+		const std::string &getStateQuery() {
+			// NOTE: The bridge's documented operations don't include a way to query the local user's state yet.
+			// This assumes an operation that answers with {"muted": <bool>, "deafened": <bool>, "channel": "<name>"}
+			// (see LocalUserState::fromResponse). A bridge that doesn't know it answers with an error, which
+			// suspends the queries for a while (see MumblePlugin::handleStateResponse).
+			// clang-format off
+			static const std::string query = nlohmann::json({
+				{ "message_type", "operation" },
+				{
+					"message", {
+						{ "operation", "get_local_user_state" }
+					}
+				}
+			}).dump();
+			// clang-format on
+
+			return query;
+		}
+	} // namespace
+
+	MumblePlugin::MumblePlugin()
+		: m_cliPathCache("mumble_json_bridge_cli"), m_bridgeCLI(m_cliPathCache),
+		  m_executor([this](const std::string &error) {
+			  m_connectionManager->log(LogLevel::Error, "A background job has failed: " + error);
+		  }) {}
+
+	void MumblePlugin::keyDownForAction(ActionHandle action, ContextHandle context,
+										const LazyJSON &payload, DeviceHandle device) {
+		auto it = m_compiledActions.find(context);
+		if (it == m_compiledActions.end() || it->second.action != action) {
+			// We haven't seen this button appear (should not happen)
+			compileAction(action, context, Utils::getObjectByName(payload.get(), kESDSDKPayloadSettings));
+			it = m_compiledActions.find(context);
+
+			it->second.inMultiAction = Utils::getBoolByName(payload.get(), kESDSDKPayloadIsInMultiAction);
+		}
+
+		if (it->second.pushToTalk) {
+			// Must not be delayed by anything else
+			PushToTalk &pushToTalk = getPushToTalk(action);
+			const bool wasActive   = pushToTalk.isActive();
+			pushToTalk.press(context);
+
+			if (!wasActive) {
+				updateTalkingAnimations();
+			}
+			return;
+		}
+
+		if (!it->second.request) {
+			m_connectionManager->reportError(it->second.error, context);
+			return;
+		}
+
+		// Pressing a button with multiple states makes the Stream Deck switch its state on its own, so
+		// we have to make sure the button is updated with the real state afterwards
+		m_stateCache.invalidate(context);
+
+		switch (m_inFlight.press(context, it->second.kind, it->second.request)) {
+			case InFlightTable::PressResult::Start:
+				if (it->second.inMultiAction) {
+					queueBurst(action, context, it->second.request);
+				} else {
+					runAction(action, context, it->second.request);
+				}
+				break;
+			case InFlightTable::PressResult::Merged:
+				m_connectionManager->incrementMetric(action, Metrics::Counter::Merged);
+				break;
+			case InFlightTable::PressResult::Rejected: {
+				m_connectionManager->incrementMetric(action, Metrics::Counter::Rejected);
+
+				static LogRateLimit rateLimit;
+				m_connectionManager->reportError("Too many actions are pending - ignoring key press", context,
+												 rateLimit);
+				break;
+			}
+		}
+	}
+
+	void MumblePlugin::runAction(ActionHandle action, ContextHandle context,
+								 std::shared_ptr< const std::string > request) {
+		const Metrics::Recorder recorder = m_connectionManager->getMetricsRecorder(action);
+
+		// Talking to the bridge may block for quite a while, so this must not happen on the event loop.
+		// The results are handed back to the event loop's thread for processing though.
+		m_executor.execute(context.value, [this, action, context, request, recorder]() {
+			// The button's next request must be started in any case
+			const auto fail = [this, action, context](const std::string &errorMessage) {
+				m_connectionManager->post([this, action, errorMessage, context]() {
+					// Mashing a button while Mumble can't be reached must not flood the log
+					static LogRateLimit rateLimit;
+					m_connectionManager->reportError(errorMessage, context, rateLimit);
+
+					finishAction(action, context);
+				});
+			};
 
-			// Clear any potential text on the button
+			try {
+				nlohmann::json response = executeAction(*request, recorder);
+
+				const Clock::time_point responded = Clock::now();
+				m_connectionManager->post([this, action, context, response, recorder, responded]() {
+					handleResponse(action, context, response);
+
+					recorder.record(Metrics::Stage::UIUpdate, Clock::now() - responded);
+
+					finishAction(action, context);
+				});
+			} catch (const PluginException &e) {
+				fail(e.what());
+			} catch (const std::exception &e) {
+				fail(std::string("Unexpected error while executing the action: ") + e.what());
+			}
+		});
+	}
+
+	void MumblePlugin::finishAction(ActionHandle action, ContextHandle context) {
+		if (std::shared_ptr< const std::string > next = m_inFlight.finish(context)) {
+			auto it = m_compiledActions.find(context);
+			if (it != m_compiledActions.end() && it->second.inMultiAction) {
+				queueBurst(action, context, std::move(next));
+			} else {
+				runAction(action, context, std::move(next));
+			}
+		}
+	}
+
+	void MumblePlugin::queueBurst(ActionHandle action, ContextHandle context,
+								  std::shared_ptr< const std::string > request) {
+		m_burst.push_back({ action, context, std::move(request), m_connectionManager->getMetricsRecorder(action) });
+
+		if (m_burst.size() > 1) {
+			// The burst's window is open already
+			return;
+		}
+
+		if (!m_burstTimer) {
+			m_burstTimer = std::make_unique< boost::asio::steady_timer >(m_connectionManager->getIOService());
+		}
+
+		m_burstTimer->expires_after(multiActionBurstWindow);
+		m_burstTimer->async_wait([this](const boost::system::error_code &ec) {
+			if (!ec) {
+				runBurst();
+			}
+		});
+	}
+
+	void MumblePlugin::runBurst() {
+		std::vector< BatchedRequest > batch;
+		batch.swap(m_burst);
+
+		if (batch.size() == 1) {
+			runAction(batch.front().action, batch.front().context, std::move(batch.front().request));
+			return;
+		}
+
+		m_executor.execute(multiActionKey, [this, batch]() {
+			std::vector< BatchedResponse > responses;
+			try {
+				responses = executeBatch(batch);
+			} catch (const std::exception &e) {
+				// Every button of the batch has to be finished nevertheless
+				BatchedResponse failure;
+				failure.error = std::string("Unexpected error while executing the actions: ") + e.what();
+
+				responses.assign(batch.size(), failure);
+			}
+
+			const Clock::time_point responded = Clock::now();
+			m_connectionManager->post([this, batch, responses, responded]() {
+				for (std::size_t i = 0; i < batch.size(); ++i) {
+					if (responses[i].error.empty()) {
+						handleResponse(batch[i].action, batch[i].context, responses[i].response);
+
+						batch[i].recorder.record(Metrics::Stage::UIUpdate, Clock::now() - responded);
+					} else {
+						static LogRateLimit rateLimit;
+						m_connectionManager->reportError(responses[i].error, batch[i].context, rateLimit);
+					}
+
+					finishAction(batch[i].action, batch[i].context);
+				}
+			});
+		});
+	}
+
+	void MumblePlugin::handleResponse(ActionHandle action, ContextHandle context, const nlohmann::json &response) {
+		if (!m_userCounts.isSubscribed(context)) {
+			// Clear any potential text on the button (unless it is showing a user count)
 			m_connectionManager->api_setTitle("", context, kESDSDKTarget_HardwareAndSoftware);
+		}
+		try {
+			std::string responseType = response.at("response_type").get< std::string >();
+			if (responseType != "error") {
+				if (m_connectionManager->getLogger().isEnabled(LogLevel::Debug)) {
+					m_connectionManager->log(LogLevel::Debug, "Successfully executed action "
+																  + m_connectionManager->getActionID(action));
+				}
+
+				if (m_stateCache.hasSubscribers()) {
+					refreshState(true);
+				}
+				if (m_userCounts.hasSubscribers()
+					&& m_connectionManager->getActionID(action) == MUMBLE_STREAMDECK_JOIN_CHANNEL_ACTION_UUID) {
+					// The local user has moved from one channel to another
+					refreshUserCounts(true);
+				}
+			} else {
+				m_connectionManager->reportError("Error while executing action "
+												 + m_connectionManager->getActionID(action) + " "
+												 + response.at("response").at("error_message").get< std::string >());
+			}
+		} catch (const nlohmann::json::exception &e) {
+			m_connectionManager->reportError(std::string("JSON error: ") + e.what(), context);
+		}
+	}
+
+	void MumblePlugin::refreshState(bool allowCLIFallback) {
+		if (!m_stateBackoff.mayQuery() || !m_stateCache.beginQuery()) {
+			return;
+		}
+
+		// State queries aren't accounted to any action
+		const Metrics::Recorder recorder = m_connectionManager->getMetricsRecorder();
+
+		m_executor.execute(stateQueryKey, [this, allowCLIFallback, recorder]() {
+			std::shared_ptr< const LocalUserState > state;
+			std::string rejection;
+
 			try {
-				std::string responseType = response["response_type"].get< std::string >();
-				if (responseType != "error") {
-					m_connectionManager->api_logMessage("Successfully executed action " + actionID);
+				nlohmann::json response = executeAction(getStateQuery(), recorder, allowCLIFallback);
+
+				if (response.value("response_type", "") != "error") {
+					state = std::make_shared< const LocalUserState >(LocalUserState::fromResponse(response));
 				} else {
-					m_connectionManager->reportError("Error while executing action " + actionID + " "
-													 + response["response"]["error_message"].get< std::string >());
+					rejection = response.dump();
 				}
-			} catch (const nlohmann::json::exception &e) {
-				throw PluginException(std::string("JSON error: ") + e.what());
+			} catch (const PluginException &) {
+				// Mumble is not reachable - the buttons simply keep displaying what they do
+			} catch (const nlohmann::json::exception &) {
 			}
-		} catch (const PluginException &e) {
-			m_connectionManager->reportError(e.what(), context);
+
+			const Clock::time_point responded = Clock::now();
+			m_connectionManager->post([this, state, rejection, recorder, responded]() {
+				handleStateResponse(state, rejection);
+
+				recorder.record(Metrics::Stage::UIUpdate, Clock::now() - responded);
+			});
+		});
+	}
+
+	void MumblePlugin::handleStateResponse(const std::shared_ptr< const LocalUserState > &state,
+										   const std::string &rejection) {
+		if (state) {
+			m_stateBackoff.succeeded();
+
+			for (const MumbleStateCache::Change &change : m_stateCache.update(*state)) {
+				displayState(change.context, change.field, change.value);
+			}
+		} else if (!rejection.empty() && m_stateBackoff.failed()) {
+			// Most likely the bridge doesn't know the operation (see getStateQuery). Actions keep working, their
+			// buttons just don't reflect Mumble's state.
+			m_connectionManager->log(LogLevel::Warning,
+									 "The bridge can't tell the local user's state, so buttons won't show it (asking "
+									 "less often from now on): "
+										 + rejection);
+		}
+
+		if (m_stateCache.endQuery()) {
+			refreshState(true);
 		}
 	}
 
-	void MumblePlugin::keyUpForAction(const std::string &actionID, const std::string &context,
-									  const nlohmann::json &payload, const std::string &deviceID) {}
+	void MumblePlugin::displayState(ContextHandle context, MumbleStateCache::Field field, int value) {
+		if (field != MumbleStateCache::Field::Channel) {
+			m_connectionManager->api_setState(value, context);
+			return;
+		}
+
+		if (value) {
+			auto it            = m_compiledActions.find(context);
+			const bool highDPI = it != m_compiledActions.end() && m_highDPIDevices.count(it->second.device) > 0;
+
+			const EncodedImage *image = m_connectionManager->getImageCache().find(joinChannelActiveImage, highDPI);
 
-	void MumblePlugin::willAppearForAction(const std::string &actionID, const std::string &context,
-										   const nlohmann::json &payload, const std::string &deviceID) {}
+			if (image) {
+				m_connectionManager->api_setImage(*image, context, kESDSDKTarget_HardwareAndSoftware);
+				return;
+			}
+		}
+
+		// Go back to the image from the manifest
+		m_connectionManager->api_setImage(std::string(), context, kESDSDKTarget_HardwareAndSoftware);
+	}
 
-	void MumblePlugin::willDisappearForAction(const std::string &actionID, const std::string &context,
-											  const nlohmann::json &payload, const std::string &deviceID) {}
+	void MumblePlugin::updateStateSubscription(ContextHandle context, const CompiledAction &compiled) {
+		MumbleStateCache::Field field;
+		// Buttons inside of Multi Actions aren't visible on their own
+		if (compiled.inMultiAction || !getDisplayedField(m_connectionManager->getActionID(compiled.action), field)) {
+			return;
+		}
 
-	void MumblePlugin::deviceDidConnect(const std::string &deviceID, const nlohmann::json &deviceInfo) {}
+		std::string channel;
+		if (field == MumbleStateCache::Field::Channel) {
+			channel = Utils::getStringByName(compiled.settings,
+											 MUMBLE_STREAMDECK_CHANNEL_JOIN_ACTION_CHANNEL_NAME_SETTING, "");
 
-	void MumblePlugin::deviceDidDisconnect(const std::string &deviceID) {}
+			if (channel.empty()) {
+				if (m_stateCache.unsubscribe(context)) {
+					displayState(context, field, 0);
+				}
 
-	void MumblePlugin::sendToPlugin(const std::string &actionID, const std::string &context,
-									const nlohmann::json &payload, const std::string &deviceID) {}
+				return;
+			}
+		}
 
-	void MumblePlugin::receivedGlobalSettings(const nlohmann::json &settings) {}
+		m_stateCache.subscribe(context, field, channel);
 
-	void MumblePlugin::receivedData(const nlohmann::json &data, const std::string &context) {
-		if (data.contains("settings")) {
-			// Store for later use
-			m_settings = data["settings"];
+		if (m_stateCache.isKnown()) {
+			displayState(context, field, m_stateCache.displayedValue(context));
+		}
 
-			// m_connectionManager->api_logMessage("Received settings: " + m_settings.dump());
+		refreshState(true);
+		scheduleStatePoll();
+	}
 
-			// Permanently save the settings as well (the property inspector will send the settings
-			// to the plugin without saving them as the latter is not reliable when being done in the
-			// property inspector).
-			m_connectionManager->api_setSettings(m_settings, context);
+	void MumblePlugin::refreshUserCounts(bool allowCLIFallback) {
+		if (!m_userCountBackoff.mayQuery() || !m_userCounts.beginQuery()) {
+			return;
 		}
+
+		const std::shared_ptr< const std::string > query = m_userCounts.query();
+		const Metrics::Recorder recorder                 = m_connectionManager->getMetricsRecorder();
+
+		m_executor.execute(userCountQueryKey, [this, allowCLIFallback, query, recorder]() {
+			std::shared_ptr< const ChannelUserCounts > counts;
+			std::string rejection;
+
+			try {
+				nlohmann::json response = executeAction(*query, recorder, allowCLIFallback);
+
+				if (response.value("response_type", "") != "error") {
+					counts = std::make_shared< const ChannelUserCounts >(ChannelUserCounts::fromResponse(response));
+				} else {
+					rejection = response.dump();
+				}
+			} catch (const PluginException &) {
+				// Mumble is not reachable - the buttons simply keep displaying what they do
+			} catch (const nlohmann::json::exception &) {
+			}
+
+			m_connectionManager->post([this, counts, rejection]() { handleUserCountResponse(counts, rejection); });
+		});
+	}
+
+	void MumblePlugin::handleUserCountResponse(const std::shared_ptr< const ChannelUserCounts > &counts,
+											   const std::string &rejection) {
+		if (counts) {
+			m_userCountBackoff.succeeded();
+
+			for (const std::pair< ContextHandle, std::string > &change : m_userCounts.update(*counts)) {
+				m_connectionManager->api_setTitle(change.second, change.first, kESDSDKTarget_HardwareAndSoftware);
+			}
+		} else if (!rejection.empty() && m_userCountBackoff.failed()) {
+			// Most likely the bridge doesn't know the operation (see ChannelUserCountCache::query)
+			m_connectionManager->log(LogLevel::Warning,
+									 "The bridge can't tell the number of users in a channel, so join-channel buttons "
+									 "won't show it (asking less often from now on): "
+										 + rejection);
+		}
+
+		if (m_userCounts.endQuery()) {
+			refreshUserCounts(true);
+		}
+	}
+
+	void MumblePlugin::updateUserCountSubscription(ContextHandle context, const CompiledAction &compiled) {
+		if (m_connectionManager->getActionID(compiled.action) != MUMBLE_STREAMDECK_JOIN_CHANNEL_ACTION_UUID) {
+			return;
+		}
+
+		const std::string channel =
+			Utils::getStringByName(compiled.settings, MUMBLE_STREAMDECK_CHANNEL_JOIN_ACTION_CHANNEL_NAME_SETTING, "");
+
+		// Buttons inside of Multi Actions aren't visible on their own
+		if (compiled.inMultiAction || channel.empty()) {
+			if (m_userCounts.isSubscribed(context)) {
+				m_userCounts.unsubscribe(context);
+				m_connectionManager->api_setTitle("", context, kESDSDKTarget_HardwareAndSoftware);
+			}
+
+			return;
+		}
+
+		m_userCounts.subscribe(context, channel);
+
+		refreshUserCounts(true);
+		scheduleStatePoll();
+	}
+
+	void MumblePlugin::scheduleStatePoll() {
+		if (m_statePollScheduled) {
+			return;
+		}
+
+		if (!m_statePollTimer) {
+			m_statePollTimer = std::make_unique< boost::asio::steady_timer >(m_connectionManager->getIOService());
+		}
+
+		m_statePollScheduled = true;
+
+		m_statePollTimer->expires_after(statePollInterval);
+		m_statePollTimer->async_wait([this](const boost::system::error_code &ec) {
+			m_statePollScheduled = false;
+
+			if (ec || (!m_stateCache.hasSubscribers() && !m_userCounts.hasSubscribers())) {
+				return;
+			}
+
+			// Polling happens all the time, so it must never spawn the CLI
+			if (m_stateCache.hasSubscribers()) {
+				refreshState(false);
+			}
+			if (m_userCounts.hasSubscribers()) {
+				refreshUserCounts(false);
+			}
+			scheduleStatePoll();
+		});
 	}
 
-	nlohmann::json MumblePlugin::getJSONForAction(const std::string &actionID, const nlohmann::json &settings) const {
+	void MumblePlugin::resync() {
+		if (m_stateCache.hasSubscribers()) {
+			refreshState(true);
+		}
+		if (m_userCounts.hasSubscribers()) {
+			refreshUserCounts(true);
+		}
+	}
+
+	PushToTalk &MumblePlugin::getPushToTalk(ActionHandle action) {
+		if (!m_pushToTalk) {
+			nlohmann::json request = getJSONForAction(MUMBLE_STREAMDECK_PUSH_TO_TALK_ACTION_UUID, {});
+			const std::string activateRequest = request.dump();
+
+			request["message"]["parameter"]["activate"] = false;
+			const std::string deactivateRequest         = request.dump();
+
+			const Metrics::Recorder recorder = m_connectionManager->getMetricsRecorder(action);
+
+			m_pushToTalk = std::make_unique< PushToTalk >(
+				activateRequest, deactivateRequest, getStateQuery(),
+				[this, recorder](const std::string &request, bool allowCLIFallback) -> std::string {
+					try {
+						const nlohmann::json response = executeAction(request, recorder, allowCLIFallback);
+
+						if (response.value("response_type", "") == "error") {
+							return Utils::getStringByName(Utils::getObjectByName(response, "response"), "error_message",
+														  "The bridge reported an error");
+						}
+					} catch (const PluginException &e) {
+						return e.what();
+					}
+
+					return {};
+				},
+				[this](ContextHandle context, const std::string &error) {
+					m_connectionManager->post([this, context, error]() {
+						static LogRateLimit rateLimit;
+						m_connectionManager->reportError("Push to talk failed: " + error, context, rateLimit);
+					});
+				},
+				recorder);
+		}
+
+		return *m_pushToTalk;
+	}
+
+	FrameScheduler &MumblePlugin::getFrameScheduler() {
+		if (!m_frameScheduler) {
+			m_frameScheduler = std::make_unique< FrameScheduler >(
+				m_connectionManager->getIOService(), animationBudget,
+				[this](ContextHandle context, const FrameScheduler::Frame &frame) {
+					return m_connectionManager->sendPreparedImage(frame, context);
+				});
+		}
+
+		return *m_frameScheduler;
+	}
+
+	void MumblePlugin::updateTalkingAnimation(ContextHandle context, bool talking) {
+		FrameScheduler &scheduler = getFrameScheduler();
+
+		if (talking) {
+			if (scheduler.isAnimating(context)) {
+				// The button may have disappeared in the meantime
+				scheduler.resume(context);
+				return;
+			}
+
+			// The frames contain the button's context, so they have to be serialized for every button
+			std::vector< FrameScheduler::Frame > frames;
+			for (const EncodedImage &image : getTalkingFrames()) {
+				frames.push_back(m_connectionManager->prepareImage(image, context, kESDSDKTarget_HardwareAndSoftware));
+			}
+
+			scheduler.start(context, std::move(frames), talkingFrameInterval);
+		} else if (scheduler.isAnimating(context)) {
+			scheduler.stop(context);
+
+			// Back to the button's regular image
+			m_connectionManager->api_setImage(std::string(), context, kESDSDKTarget_HardwareAndSoftware);
+		}
+	}
+
+	void MumblePlugin::updateTalkingAnimations() {
+		const bool talking = m_pushToTalk && m_pushToTalk->isActive();
+
+		for (const auto &current : m_compiledActions) {
+			if (current.second.pushToTalk && !current.second.inMultiAction) {
+				updateTalkingAnimation(current.first, talking);
+			}
+		}
+	}
+
+	void MumblePlugin::keyUpForAction(ActionHandle action, ContextHandle context,
+									  const LazyJSON &payload, DeviceHandle device) {
+		if (m_pushToTalk && m_pushToTalk->isActive()) {
+			// Does nothing for any other button
+			m_pushToTalk->release(context);
+
+			if (!m_pushToTalk->isActive()) {
+				updateTalkingAnimations();
+			}
+		}
+	}
+
+	void MumblePlugin::willAppearForAction(ActionHandle action, ContextHandle context,
+										   const LazyJSON &payload, DeviceHandle device) {
+		const std::string &actionID = m_connectionManager->getActionID(action);
+
+		CompiledAction &compiled = m_compiledActions[context];
+		compiled.inMultiAction   = Utils::getBoolByName(payload.get(), kESDSDKPayloadIsInMultiAction);
+		compiled.device          = device;
+
+		compileAction(action, context, Utils::getObjectByName(payload.get(), kESDSDKPayloadSettings));
+
+		if (compiled.pushToTalk) {
+			PushToTalk &pushToTalk = getPushToTalk(action);
+
+			if (!m_bridgeClient.isConnected()) {
+				// Get everything ready for the first press
+				pushToTalk.warmUp();
+			}
+
+			if (!compiled.inMultiAction) {
+				updateTalkingAnimation(context, pushToTalk.isActive());
+			}
+		}
+
+		if (!compiled.request) {
+			// Only log the problem - a freshly placed button has not been configured yet
+			m_connectionManager->log(LogLevel::Info, "Button for action " + actionID
+														 + " is not configured properly: " + compiled.error);
+		}
+
+		updateUserCountSubscription(context, compiled);
+		updateStateSubscription(context, compiled);
+	}
+
+	void MumblePlugin::willDisappearForAction(ActionHandle action, ContextHandle context,
+											  const LazyJSON &payload, DeviceHandle device) {
+		if (m_settingsWriteBack && m_settingsWriteBack->cancel(context)) {
+			// Only save the settings - the rest of what persistSettings does is pointless for a button that
+			// is going away (and would e.g. subscribe it to the user counts again)
+			auto it = m_compiledActions.find(context);
+			if (it != m_compiledActions.end()) {
+				m_connectionManager->api_setSettings(it->second.settings, context);
+			}
+		}
+
+		if (m_frameScheduler) {
+			// Continued (if still needed) once the button is back
+			m_frameScheduler->pause(context);
+		}
+
+		m_compiledActions.erase(context);
+
+		if (m_pushToTalk && m_pushToTalk->isActive()) {
+			// The button can't be released anymore once it is gone
+			m_pushToTalk->release(context);
+
+			if (!m_pushToTalk->isActive()) {
+				updateTalkingAnimations();
+			}
+		}
+
+		m_stateCache.unsubscribe(context);
+		m_userCounts.unsubscribe(context);
+		m_inFlight.discardPending(context);
+		m_executor.release(context.value);
+	}
+
+	void MumblePlugin::didReceiveSettings(ActionHandle action, ContextHandle context,
+										  const LazyJSON &payload, DeviceHandle device) {
+		const CompiledAction &compiled =
+			compileAction(action, context, Utils::getObjectByName(payload.get(), kESDSDKPayloadSettings));
+
+		if (!compiled.request) {
+			m_connectionManager->reportError(compiled.error, context);
+		}
+
+		updateUserCountSubscription(context, compiled);
+		updateStateSubscription(context, compiled);
+	}
+
+	void MumblePlugin::propertyInspectorDidDisappear(ActionHandle action, ContextHandle context,
+													 DeviceHandle device) {
+		if (m_settingsWriteBack) {
+			m_settingsWriteBack->flush(context);
+		}
+	}
+
+	void MumblePlugin::deviceDidConnect(DeviceHandle device, const LazyJSON &deviceInfo) {
+		// The keys of the XL are larger than the ones of the other models
+		if (Utils::getIntByName(deviceInfo.get(), kESDSDKDeviceInfoType, kESDSDKDeviceType_StreamDeck)
+			== kESDSDKDeviceType_StreamDeckXL) {
+			m_highDPIDevices.insert(device);
+		}
+	}
+
+	void MumblePlugin::deviceDidDisconnect(DeviceHandle device) { m_highDPIDevices.erase(device); }
+
+	void MumblePlugin::sendToPlugin(ActionHandle action, ContextHandle context,
+									const LazyJSON &payload, DeviceHandle device) {}
+
+	void MumblePlugin::receivedGlobalSettings(const nlohmann::json &settings) {
+		// An empty path means that the CLI shall be searched for in PATH
+		m_cliPathCache.setOverride(Utils::getStringByName(settings, MUMBLE_STREAMDECK_GLOBAL_CLI_PATH_SETTING));
+
+		Logger &logger = m_connectionManager->getLogger();
+
+		LogLevel level = LogLevel::Info;
+		Logger::parseLevel(Utils::getStringByName(settings, MUMBLE_STREAMDECK_GLOBAL_LOG_LEVEL_SETTING), level);
+		logger.setLevel(level);
+
+		// An empty path means that there is no log file
+		logger.setFile(Utils::getStringByName(settings, MUMBLE_STREAMDECK_GLOBAL_LOG_FILE_SETTING));
+	}
+
+	void MumblePlugin::receivedData(const nlohmann::json &data, ContextHandle context) {
+		auto it = m_compiledActions.find(context);
+		if (it == m_compiledActions.end()) {
+			return;
+		}
+
+		if (data.contains("getMetrics")) {
+			m_connectionManager->api_sendToPropertyInspector(it->second.action, context,
+															 { { "metrics", m_connectionManager->getMetricsJSON() } });
+			return;
+		}
+
+		nlohmann::json settings = it->second.settings;
+		if (data.contains("settingsDelta")) {
+			// The property inspector only sends the settings that have changed
+			if (!settings.is_object()) {
+				settings = nlohmann::json::object();
+			}
+			settings.update(data["settingsDelta"]);
+		} else if (data.contains("settings")) {
+			settings = data["settings"];
+		} else {
+			return;
+		}
+
+		// Prepare the request right away so that a key press uses the new settings, but wait for the
+		// user to finish editing before reporting problems or persisting anything.
+		compileAction(it->second.action, context, settings);
+
+		if (!m_settingsWriteBack) {
+			m_settingsWriteBack = std::make_unique< Debouncer >(
+				m_connectionManager->getIOService(), settingsSettleTime,
+				[this](ContextHandle settledContext) { persistSettings(settledContext); });
+		}
+		m_settingsWriteBack->touch(context);
+	}
+
+	void MumblePlugin::systemDidWakeUp() {
+		// Mumble's state may have changed while the computer was asleep
+		resync();
+	}
+
+	void MumblePlugin::didReconnect() {
+		// Changes of Mumble's state may have happened while the connection was down
+		resync();
+	}
+
+	void MumblePlugin::persistSettings(ContextHandle context) {
+		auto it = m_compiledActions.find(context);
+		if (it == m_compiledActions.end()) {
+			return;
+		}
+
+		if (!it->second.request) {
+			m_connectionManager->reportError(it->second.error, context);
+		}
+
+		// Only now that the user is done editing, so that a half-typed channel name isn't queried
+		updateUserCountSubscription(context, it->second);
+		updateStateSubscription(context, it->second);
+
+		// Permanently save the settings as well (the property inspector will send the settings
+		// to the plugin without saving them as the latter is not reliable when being done in the
+		// property inspector).
+		m_connectionManager->api_setSettings(it->second.settings, context);
+	}
+
+	const MumblePlugin::CompiledAction &MumblePlugin::compileAction(ActionHandle action, ContextHandle context,
+																	const nlohmann::json &settings) {
+		CompiledAction &compiled    = m_compiledActions[context];
+		const std::string &actionID = m_connectionManager->getActionID(action);
+
+		compiled.action   = action;
+		compiled.settings = settings;
+		compiled.error.clear();
+
+		compiled.pushToTalk = actionID == MUMBLE_STREAMDECK_PUSH_TO_TALK_ACTION_UUID;
+
+		// Everything but the toggles asks for a specific state
+		compiled.kind = actionID == MUMBLE_STREAMDECK_TOGGLE_LOCAL_USER_MUTE_ACTION_UUID
+								|| actionID == MUMBLE_STREAMDECK_TOGGLE_LOCAL_USER_DEAF_ACTION_UUID
+							? InFlightTable::Kind::Toggle
+							: InFlightTable::Kind::Idempotent;
+
+		try {
+			compiled.request = std::make_shared< const std::string >(getJSONForAction(actionID, settings).dump());
+		} catch (const PluginException &e) {
+			compiled.request.reset();
+			compiled.error = e.what();
+		}
+
+		return compiled;
+	}
+
+	nlohmann::json MumblePlugin::getJSONForAction(const std::string &actionID, const nlohmann::json &settings) {
 		nlohmann::json action;
 		if (actionID == MUMBLE_STREAMDECK_TOGGLE_LOCAL_USER_MUTE_ACTION_UUID) {
 			// clang-format off
@@ -101,7 +881,7 @@ namespace StreamDeckIntegration {
 			std::string targetChannelName;
 			std::string channelPassword;
 
-			if (!settings.contains(MUMBLE_STREAMDECK_CHANNEL_JOIN_ACTION_CHANNEL_PASSWORD_SETTING)) {
+			if (!settings.contains(MUMBLE_STREAMDECK_CHANNEL_JOIN_ACTION_CHANNEL_NAME_SETTING)) {
 				throw PluginException("ChannelJoinAction: Channel name not contained in settings!");
 			}
 			if (settings[MUMBLE_STREAMDECK_CHANNEL_JOIN_ACTION_CHANNEL_NAME_SETTING].type()
@@ -137,6 +917,22 @@ namespace StreamDeckIntegration {
 				}
 			};
 			// clang-format on
+		} else if (actionID == MUMBLE_STREAMDECK_PUSH_TO_TALK_ACTION_UUID) {
+			// The request for pressing the button (releasing it sends the same with "activate" being false)
+			// clang-format off
+			action = {
+				{ "message_type", "operation" },
+				{
+					"message", {
+						{ "operation", "request_microphone_activation_overwrite" },
+						{ "parameter", {
+										   { "activate", true }
+									   }
+						}
+					}
+				}
+			};
+			// clang-format on
 		} else {
 			throw PluginException("Unknown action \"" + actionID + "\"");
 		}
@@ -144,62 +940,70 @@ namespace StreamDeckIntegration {
 		return action;
 	}
 
-	boost::filesystem::path MumblePlugin::findCLI() {
-		const std::string cli_name      = "mumble_json_bridge_cli";
-		boost::filesystem::path cliPath = boost::process::search_path(cli_name);
-		if (cliPath.empty()) {
-			// Not found
-			throw PluginException("Unable to locate \"" + cli_name + "\" binary. Are you sure it's in PATH?");
-		}
+	nlohmann::json MumblePlugin::executeAction(const std::string &action, const Metrics::Recorder &recorder,
+											   bool allowCLIFallback) {
+		const Clock::time_point deadline = Clock::now() + actionTimeout;
 
-		return cliPath;
-	}
+		try {
+			const Clock::time_point start = Clock::now();
+
+			nlohmann::json response = m_bridgeClient.execute(action, bridgeTimeout);
 
-	nlohmann::json MumblePlugin::executeAction(const nlohmann::json &action, const boost::filesystem::path &cliPath) {
-		boost::process::ipstream stdout_stream;
-		boost::process::ipstream stderr_stream;
-		std::error_code launchErrorCode;
-		boost::process::child c(cliPath, "--json", action.dump(), boost::process::std_out > stdout_stream,
-								boost::process::std_err > stderr_stream, launchErrorCode);
+			recorder.record(Metrics::Stage::BridgeWait, Clock::now() - start);
 
-		std::string stdout_content;
-		std::string stderr_content;
-		std::string line;
-		while (stdout_stream && std::getline(stdout_stream, line) && !line.empty()) {
-			stdout_content += line;
+			return response;
+		} catch (const BridgeException &e) {
+			if (!allowCLIFallback) {
+				throw PluginException(e.what());
+			}
 		}
-		while (stderr_stream && std::getline(stderr_stream, line) && !line.empty()) {
-			stderr_content += line;
+
+		// The bridge can't be reached directly (e.g. because it doesn't support this) -> let the CLI
+		// have a go at it
+		try {
+			return m_bridgeCLI.execute(
+				action, recorder, std::chrono::duration_cast< std::chrono::milliseconds >(deadline - Clock::now()));
+		} catch (const BridgeException &e) {
+			throw PluginException(e.what());
 		}
+	}
 
-		c.wait();
+	std::vector< MumblePlugin::BatchedResponse >
+		MumblePlugin::executeBatch(const std::vector< BatchedRequest > &requests) {
+		std::vector< BatchedResponse > responses(requests.size());
 
-		// Trim contents
-		boost::trim(stdout_content);
-		boost::trim(stderr_content);
+		std::vector< std::string > messages;
+		messages.reserve(requests.size());
+		for (const BatchedRequest &current : requests) {
+			messages.push_back(*current.request);
+		}
+
+		try {
+			const Clock::time_point start = Clock::now();
 
-		int processExitCode = c.exit_code();
+			std::vector< nlohmann::json > results = m_bridgeClient.executeAll(messages, bridgeTimeout);
 
-		if (launchErrorCode) {
-			throw PluginException("Trying to launch external process resulted in non-zero exit code: "
-								  + std::to_string(launchErrorCode.value()));
-		}
-		if (processExitCode) {
-			std::string errorMsg = "Calling the CLI returned non-zero exit code: " + std::to_string(processExitCode);
-			if (stderr_content.size() > 0) {
-				errorMsg += " (\"" + stderr_content + "\")";
+			const std::chrono::nanoseconds wait = Clock::now() - start;
+			for (std::size_t i = 0; i < requests.size(); ++i) {
+				requests[i].recorder.record(Metrics::Stage::BridgeWait, wait);
+				responses[i].response = std::move(results[i]);
 			}
 
-			throw PluginException(errorMsg);
+			return responses;
+		} catch (const BridgeException &) {
 		}
 
-		try {
-			// Parse and return
-			return nlohmann::json::parse(stdout_content);
-		} catch (const nlohmann::json::parse_error &e) {
-			throw PluginException(std::string("CLI returned malformed JSON: ") + e.what() + " (JSON: \""
-								  + stdout_content + "\")");
+		// The CLI only handles a single request per invocation
+		for (std::size_t i = 0; i < requests.size(); ++i) {
+			try {
+				responses[i].response =
+					m_bridgeCLI.execute(messages[i], requests[i].recorder, actionTimeout - bridgeTimeout);
+			} catch (const BridgeException &e) {
+				responses[i].error = e.what();
+			}
 		}
+
+		return responses;
 	}
 
 }; // namespace StreamDeckIntegration
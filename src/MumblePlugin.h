@@ -6,11 +6,27 @@
 #ifndef MUMBLE_STREAMDECK_INTEGRATION_MUMBLEPLUGIN_H_
 #define MUMBLE_STREAMDECK_INTEGRATION_MUMBLEPLUGIN_H_
 
+#include "ActionExecutor.h"
+#include "BridgeCLI.h"
+#include "BridgeClient.h"
+#include "CLIPathCache.h"
+#include "ChannelUserCountCache.h"
+#include "Debouncer.h"
+#include "FrameScheduler.h"
+#include "InFlightTable.h"
+#include "MumbleStateCache.h"
+#include "PushToTalk.h"
+#include "QueryBackoff.h"
 #include "StreamDeckPlugin.h"
 
-#include <boost/filesystem.hpp>
+#include <boost/asio/steady_timer.hpp>
 
 #include <exception>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace Mumble {
 namespace StreamDeckIntegration {
@@ -28,31 +44,37 @@ namespace StreamDeckIntegration {
 
 	class MumblePlugin : public StreamDeckPlugin {
 	public:
-		MumblePlugin() {}
+		MumblePlugin();
 		virtual ~MumblePlugin() {}
 
-		virtual void keyDownForAction(const std::string &actionID, const std::string &context,
-									  const nlohmann::json &payload, const std::string &deviceID) override;
-		virtual void keyUpForAction(const std::string &actionID, const std::string &context,
-									const nlohmann::json &payload, const std::string &deviceID) override;
+		virtual void keyDownForAction(ActionHandle action, ContextHandle context,
+									  const LazyJSON &payload, DeviceHandle device) override;
+		virtual void keyUpForAction(ActionHandle action, ContextHandle context,
+									const LazyJSON &payload, DeviceHandle device) override;
 
-		virtual void willAppearForAction(const std::string &actionID, const std::string &context,
-										 const nlohmann::json &payload, const std::string &deviceID) override;
-		virtual void willDisappearForAction(const std::string &actionID, const std::string &context,
-											const nlohmann::json &payload, const std::string &deviceID) override;
+		virtual void willAppearForAction(ActionHandle action, ContextHandle context,
+										 const LazyJSON &payload, DeviceHandle device) override;
+		virtual void willDisappearForAction(ActionHandle action, ContextHandle context,
+											const LazyJSON &payload, DeviceHandle device) override;
 
-		virtual void deviceDidConnect(const std::string &deviceID, const nlohmann::json &deviceInfo) override;
-		virtual void deviceDidDisconnect(const std::string &deviceID) override;
+		virtual void didReceiveSettings(ActionHandle action, ContextHandle context,
+										const LazyJSON &payload, DeviceHandle device) override;
 
-		virtual void sendToPlugin(const std::string &actionID, const std::string &context,
-								  const nlohmann::json &payload, const std::string &deviceID) override;
+		virtual void propertyInspectorDidDisappear(ActionHandle action, ContextHandle context,
+												   DeviceHandle device) override;
+
+		virtual void deviceDidConnect(DeviceHandle device, const LazyJSON &deviceInfo) override;
+		virtual void deviceDidDisconnect(DeviceHandle device) override;
+
+		virtual void sendToPlugin(ActionHandle action, ContextHandle context,
+								  const LazyJSON &payload, DeviceHandle device) override;
 
 		virtual void receivedGlobalSettings(const nlohmann::json &settings) override;
 
-		virtual void receivedData(const nlohmann::json &data, const std::string &context) override;
+		virtual void receivedData(const nlohmann::json &data, ContextHandle context) override;
 
-	private:
-		nlohmann::json m_settings;
+		virtual void systemDidWakeUp() override;
+		virtual void didReconnect() override;
 
 		/**
 		 * Gets the JSON object that is to be sent to the CLI for the given action
@@ -61,26 +83,230 @@ namespace StreamDeckIntegration {
 		 * @param settings Settings to respect for the action (may be an empty JSON struct)
 		 * @returns The respective JSON
 		 *
-		 * @throws Plugexception If there is no action with the given ID
+		 * @throws Plugexception If there is no action with the given ID or the settings are invalid
+		 */
+		static nlohmann::json getJSONForAction(const std::string &actionID, const nlohmann::json &settings);
+
+	private:
+		/**
+		 * The request for a specific button, ready to be sent to the bridge
+		 */
+		struct CompiledAction {
+			ActionHandle action;
+			/// The device the button is on
+			DeviceHandle device;
+			InFlightTable::Kind kind = InFlightTable::Kind::Idempotent;
+			/// Whether the button is part of a Multi Action
+			bool inMultiAction = false;
+			/// Whether the button is a push-to-talk button (which doesn't use the request)
+			bool pushToTalk = false;
+			nlohmann::json settings;
+			/// The serialized request (null if the settings are invalid)
+			std::shared_ptr< const std::string > request;
+			/// The reason the request couldn't be compiled
+			std::string error;
+		};
+
+		/**
+		 * A request that is to be executed as part of a batch
+		 */
+		struct BatchedRequest {
+			ActionHandle action;
+			ContextHandle context;
+			std::shared_ptr< const std::string > request;
+			Metrics::Recorder recorder;
+		};
+
+		/**
+		 * The outcome of a request that has been executed as part of a batch
+		 */
+		struct BatchedResponse {
+			nlohmann::json response;
+			/// Why the request failed (empty if it didn't)
+			std::string error;
+		};
+
+		/// The compiled actions of all currently visible buttons, keyed by their context
+		std::unordered_map< ContextHandle, CompiledAction > m_compiledActions;
+		BridgeClient m_bridgeClient;
+		CLIPathCache m_cliPathCache;
+		BridgeCLI m_bridgeCLI;
+		MumbleStateCache m_stateCache;
+		/// Suspends the state queries while the bridge rejects them
+		QueryBackoff m_stateBackoff;
+		/// The devices whose keys are large enough to need the high resolution variants of images
+		std::unordered_set< DeviceHandle > m_highDPIDevices;
+		/// The user counts shown on join-channel buttons
+		ChannelUserCountCache m_userCounts;
+		/// Suspends the user count queries while the bridge rejects them
+		QueryBackoff m_userCountBackoff;
+		InFlightTable m_inFlight;
+		/// Requests of Multi Actions that have been triggered within the current burst window
+		std::vector< BatchedRequest > m_burst;
+		std::unique_ptr< boost::asio::steady_timer > m_burstTimer;
+		std::unique_ptr< boost::asio::steady_timer > m_statePollTimer;
+		bool m_statePollScheduled = false;
+		/// Delays persisting settings received from the property inspector until the user is done editing
+		std::unique_ptr< Debouncer > m_settingsWriteBack;
+		/// Only created once the first push-to-talk button appears
+		std::unique_ptr< PushToTalk > m_pushToTalk;
+		/// Plays the animation on push-to-talk buttons while talking (created on first use)
+		std::unique_ptr< FrameScheduler > m_frameScheduler;
+		// Declared last so that it is destroyed (and thus waits for running actions) first
+		ActionExecutor m_executor;
+
+		/**
+		 * Executes the given request for the given button in the background and starts the button's next
+		 * request (if any) once it has finished
+		 *
+		 * @param action The action of the button
+		 * @param context The context of the button
+		 * @param request The serialized request
 		 */
-		nlohmann::json getJSONForAction(const std::string &actionID, const nlohmann::json &settings) const;
+		void runAction(ActionHandle action, ContextHandle context, std::shared_ptr< const std::string > request);
 		/**
-		 * Tries to locate the CLI application's path in the host system
+		 * Starts the given button's next request (if any). Has to be called once a request has finished.
+		 */
+		void finishAction(ActionHandle action, ContextHandle context);
+
+		/**
+		 * Queues the given request for execution together with all others that arrive within a short time
+		 * (as is the case for the actions of a Multi Action)
+		 */
+		void queueBurst(ActionHandle action, ContextHandle context, std::shared_ptr< const std::string > request);
+		/**
+		 * Executes all requests queued by queueBurst as a single batch
+		 */
+		void runBurst();
+
+		/**
+		 * Processes the bridge's response to the given action. Must be called on the event loop's thread.
 		 *
-		 * @throws Plugexception In case the CLI can't be found
+		 * @param action The action that has been executed
+		 * @param context The context of the button that triggered the action
+		 * @param response The bridge's response
+		 */
+		void handleResponse(ActionHandle action, ContextHandle context, const nlohmann::json &response);
+
+		/**
+		 * @returns The push-to-talk handler (created on first use)
 		 */
-		boost::filesystem::path findCLI();
+		PushToTalk &getPushToTalk(ActionHandle action);
 		/**
-		 * Sends the given action JSON to the CLI at the given location and processes the
-		 * resulting output.
+		 * @returns The scheduler for animations on buttons (created on first use)
+		 */
+		FrameScheduler &getFrameScheduler();
+		/**
+		 * Starts or stops the talking animation on the given push-to-talk button. The animation is played for
+		 * as long as any push-to-talk button is held down.
 		 *
-		 * @param action The JSON describing the action that is sent to the CLI
-		 * @param cliPath The path to the CLI executable
-		 * @returns The JSON response from the CLI
+		 * @param context The context of the button
+		 * @param talking Whether the local user is talking
+		 */
+		void updateTalkingAnimation(ContextHandle context, bool talking);
+		/**
+		 * Updates the talking animation on all visible push-to-talk buttons (see updateTalkingAnimation)
+		 */
+		void updateTalkingAnimations();
+
+		/**
+		 * Queries Mumble for the local user's state and updates all buttons displaying it. If there
+		 * is a query running already, another one will be started after it has finished. Does nothing while
+		 * the bridge has rejected the query recently (see m_stateBackoff).
+		 *
+		 * @param allowCLIFallback Whether the CLI may be used if the bridge can't be reached directly
+		 */
+		void refreshState(bool allowCLIFallback);
+		/**
+		 * Processes the result of a state query. Must be called on the event loop's thread.
+		 *
+		 * @param state The queried state or null if the query failed
+		 * @param rejection The bridge's error response if it has rejected the query (empty otherwise)
+		 */
+		void handleStateResponse(const std::shared_ptr< const LocalUserState > &state, const std::string &rejection);
+		/**
+		 * Makes the given button display the given value of the given field. Join-channel buttons are
+		 * highlighted by an image from the image cache, all others use the states from the manifest.
+		 */
+		void displayState(ContextHandle context, MumbleStateCache::Field field, int value);
+		/**
+		 * Makes the given button display the part of the local user's state it is about (if any). Has to be
+		 * called whenever the button's settings have changed, as they may name a different channel.
+		 */
+		void updateStateSubscription(ContextHandle context, const CompiledAction &compiled);
+		/**
+		 * Queries Mumble for the number of users in every channel displayed by a button (all of them in a
+		 * single query) and updates the buttons whose count has changed. If there is a query running
+		 * already, another one will be started after it has finished. Does nothing while the bridge has rejected
+		 * the query recently (see m_userCountBackoff).
+		 *
+		 * @param allowCLIFallback Whether the CLI may be used if the bridge can't be reached directly
+		 */
+		void refreshUserCounts(bool allowCLIFallback);
+		/**
+		 * Processes the result of a user count query. Must be called on the event loop's thread.
+		 *
+		 * @param counts The queried counts or null if the query failed
+		 * @param rejection The bridge's error response if it has rejected the query (empty otherwise)
+		 */
+		void handleUserCountResponse(const std::shared_ptr< const ChannelUserCounts > &counts,
+									 const std::string &rejection);
+		/**
+		 * Makes the given join-channel button display the number of users in its channel (or stops doing so
+		 * if the button doesn't specify a channel)
+		 */
+		void updateUserCountSubscription(ContextHandle context, const CompiledAction &compiled);
+		/**
+		 * Makes sure the state and the user counts are polled regularly for as long as there are buttons
+		 * displaying them
+		 */
+		void scheduleStatePoll();
+		/**
+		 * Brings the buttons up to date after the plugin may have missed changes (only the buttons whose
+		 * displayed state has actually changed are updated)
+		 */
+		void resync();
+
+		/**
+		 * Persists the settings of the given context and reports problems with them. Called once the
+		 * settings have stopped changing.
+		 *
+		 * @param context The context whose settings shall be persisted
+		 */
+		void persistSettings(ContextHandle context);
+
+		/**
+		 * (Re-)Compiles the request for the given context from the given settings
+		 *
+		 * @param action The action of the button
+		 * @param context The context of the button the action belongs to
+		 * @param settings The button's settings
+		 * @returns The compiled action
+		 */
+		const CompiledAction &compileAction(ActionHandle action, ContextHandle context, const nlohmann::json &settings);
+
+		/**
+		 * Sends the given action JSON to the JSON bridge and returns its response. The bridge is
+		 * contacted directly, if possible. Otherwise this falls back to using the bridge's CLI. Either way,
+		 * this gives up after a fixed amount of time, so that a hanging bridge can't block the executor.
+		 *
+		 * @param action The serialized JSON describing the action that is sent to the bridge
+		 * @param recorder Records the latencies of the involved stages
+		 * @param allowCLIFallback Whether the CLI may be used if the bridge can't be reached directly
+		 * @returns The JSON response from the bridge
 		 *
 		 * @throws PluginException If anything goes wrong
 		 */
-		nlohmann::json executeAction(const nlohmann::json &action, const boost::filesystem::path &cliPath);
+		nlohmann::json executeAction(const std::string &action, const Metrics::Recorder &recorder,
+									 bool allowCLIFallback = true);
+		/**
+		 * Sends all of the given requests to the JSON bridge in a single exchange (or, if the bridge can't
+		 * be reached directly, executes them one after the other using the CLI)
+		 *
+		 * @param requests The requests to execute (in order)
+		 * @returns The outcome of every request (in the same order)
+		 */
+		std::vector< BatchedResponse > executeBatch(const std::vector< BatchedRequest > &requests);
 	};
 
 };     // namespace StreamDeckIntegration
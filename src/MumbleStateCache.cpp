@@ -0,0 +1,112 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#include "MumbleStateCache.h"
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	LocalUserState LocalUserState::fromResponse(const nlohmann::json &response) {
+		const nlohmann::json &content = response.at("response");
+
+		LocalUserState state;
+		state.muted    = content.at("muted").get< bool >();
+		state.deafened = content.at("deafened").get< bool >();
+		state.channel  = content.value("channel", "");
+
+		return state;
+	}
+
+	void MumbleStateCache::subscribe(ContextHandle context, Field field, const std::string &channel) {
+		auto it = m_subscribers.find(context);
+		if (it != m_subscribers.end() && it->second.field == field && it->second.channel == channel) {
+			return;
+		}
+
+		Subscriber &subscriber = m_subscribers[context];
+
+		subscriber.field        = field;
+		subscriber.channel      = channel;
+		subscriber.displayKnown = false;
+	}
+
+	bool MumbleStateCache::unsubscribe(ContextHandle context) { return m_subscribers.erase(context) > 0; }
+
+	bool MumbleStateCache::hasSubscribers() const { return !m_subscribers.empty(); }
+
+	void MumbleStateCache::invalidate(ContextHandle context) {
+		auto it = m_subscribers.find(context);
+
+		if (it != m_subscribers.end()) {
+			it->second.displayKnown = false;
+		}
+	}
+
+	bool MumbleStateCache::isKnown() const { return m_known; }
+
+	const LocalUserState &MumbleStateCache::state() const { return m_state; }
+
+	int MumbleStateCache::displayedValue(ContextHandle context) const {
+		auto it = m_subscribers.find(context);
+
+		return it == m_subscribers.end() ? 0 : valueOf(it->second);
+	}
+
+	std::vector< MumbleStateCache::Change > MumbleStateCache::update(const LocalUserState &state) {
+		m_state = state;
+		m_known = true;
+
+		std::vector< Change > changes;
+		for (auto &current : m_subscribers) {
+			Subscriber &subscriber = current.second;
+			const int value        = valueOf(subscriber);
+
+			if (!subscriber.displayKnown || subscriber.displayed != value) {
+				subscriber.displayKnown = true;
+				subscriber.displayed    = value;
+
+				changes.push_back({ current.first, subscriber.field, value });
+			}
+		}
+
+		return changes;
+	}
+
+	bool MumbleStateCache::beginQuery() {
+		if (m_queryRunning) {
+			m_queryAgain = true;
+
+			return false;
+		}
+
+		m_queryRunning = true;
+
+		return true;
+	}
+
+	bool MumbleStateCache::endQuery() {
+		m_queryRunning = false;
+
+		const bool again = m_queryAgain;
+		m_queryAgain     = false;
+
+		return again;
+	}
+
+	int MumbleStateCache::valueOf(const Subscriber &subscriber) const {
+		switch (subscriber.field) {
+			case Field::Muted:
+				return m_state.muted ? 1 : 0;
+			case Field::Deafened:
+				return m_state.deafened ? 1 : 0;
+			case Field::Channel:
+				return m_state.channel == subscriber.channel ? 1 : 0;
+		}
+
+		return 0;
+	}
+
+}; // namespace StreamDeckIntegration
+}; // namespace Mumble
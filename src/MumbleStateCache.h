@@ -0,0 +1,132 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#ifndef MUMBLE_STREAMDECK_INTEGRATION_MUMBLESTATECACHE_H_
+#define MUMBLE_STREAMDECK_INTEGRATION_MUMBLESTATECACHE_H_
+
+#include "IDTable.h"
+
+#include <nlohmann/json.hpp>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	/**
+	 * The state of the local user in Mumble
+	 */
+	struct LocalUserState {
+		bool muted    = false;
+		bool deafened = false;
+		std::string channel;
+
+		/**
+		 * Extracts the state from the bridge's response to a state query
+		 *
+		 * @throws nlohmann::json::exception If the response doesn't have the expected format
+		 */
+		static LocalUserState fromResponse(const nlohmann::json &response);
+	};
+
+	/**
+	 * Caches the state of the local user and keeps track of which buttons display which part of it. This
+	 * allows all buttons to be served by a single query to the bridge and only the buttons whose displayed
+	 * state actually changed to be updated.
+	 */
+	class MumbleStateCache {
+	public:
+		enum class Field {
+			Muted,
+			Deafened,
+			/// Whether the local user is in the channel given when subscribing
+			Channel
+		};
+
+		/**
+		 * A context whose displayed state has changed
+		 */
+		struct Change {
+			ContextHandle context;
+			Field field;
+			/// The state the context should display now
+			int value;
+		};
+
+		/**
+		 * Registers the given context as displaying the given field. Subscribing again with the same
+		 * parameters doesn't change anything.
+		 *
+		 * @param channel The channel the context is about (only used for Field::Channel)
+		 */
+		void subscribe(ContextHandle context, Field field, const std::string &channel = {});
+		/**
+		 * @returns Whether the given context has been subscribed
+		 */
+		bool unsubscribe(ContextHandle context);
+		bool hasSubscribers() const;
+
+		/**
+		 * Marks what the given context displays as unknown, so it will be part of the next update
+		 * (e.g. because the Stream Deck has changed its state on its own)
+		 */
+		void invalidate(ContextHandle context);
+
+		/**
+		 * @returns Whether the state has been queried successfully before
+		 */
+		bool isKnown() const;
+		const LocalUserState &state() const;
+
+		/**
+		 * @returns The Stream Deck state that represents the current value of the field the given context
+		 * 	displays (0 if it doesn't display any)
+		 */
+		int displayedValue(ContextHandle context) const;
+
+		/**
+		 * Stores the given state
+		 *
+		 * @returns The contexts whose displayed state has changed
+		 */
+		std::vector< Change > update(const LocalUserState &state);
+
+		/**
+		 * Has to be called before querying the state. Makes sure only one query is running at a time.
+		 *
+		 * @returns Whether a query should be started. If false, a query is running already and it will be
+		 * 	repeated once it has finished.
+		 */
+		bool beginQuery();
+		/**
+		 * Has to be called once a query has finished
+		 *
+		 * @returns Whether the query has to be repeated as the state has been requested again in the meantime
+		 */
+		bool endQuery();
+
+	private:
+		struct Subscriber {
+			Field field;
+			std::string channel;
+			bool displayKnown = false;
+			int displayed     = 0;
+		};
+
+		LocalUserState m_state;
+		bool m_known = false;
+		std::unordered_map< ContextHandle, Subscriber > m_subscribers;
+
+		bool m_queryRunning = false;
+		bool m_queryAgain   = false;
+
+		int valueOf(const Subscriber &subscriber) const;
+	};
+
+};     // namespace StreamDeckIntegration
+};     // namespace Mumble
+#endif // MUMBLE_STREAMDECK_INTEGRATION_MUMBLESTATECACHE_H_
@@ -0,0 +1,60 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#include "OutboundQueue.h"
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	OutboundQueue::PushResult OutboundQueue::push(ContextHandle context, Kind kind, Value value) {
+		if (!context.isValid()) {
+			return PushResult::Dropped;
+		}
+
+		if (context.value >= m_contexts.size()) {
+			m_contexts.resize(context.value + 1);
+		}
+
+		Slot &slot = m_contexts[context.value][static_cast< std::size_t >(kind)];
+
+		if (slot.pending) {
+			// The previous update hasn't been sent yet -> replace it
+			slot.pendingValue = std::move(value);
+
+			if (slot.sent && slot.pendingValue == slot.sentValue) {
+				// We are back to what the Stream Deck is displaying already
+				slot.pending = false;
+			}
+
+			return PushResult::Coalesced;
+		}
+
+		if (slot.sent && value == slot.sentValue) {
+			return PushResult::Dropped;
+		}
+
+		slot.pending      = true;
+		slot.pendingValue = std::move(value);
+
+		const bool wasEmpty = m_dirty.empty();
+		m_dirty.emplace_back(context, kind);
+
+		return wasEmpty ? PushResult::QueuedFirst : PushResult::Queued;
+	}
+
+	void OutboundQueue::forget(ContextHandle context) {
+		if (context.value < m_contexts.size()) {
+			m_contexts[context.value] = {};
+		}
+	}
+
+	void OutboundQueue::invalidate(ContextHandle context, Kind kind) {
+		if (context.value < m_contexts.size()) {
+			m_contexts[context.value][static_cast< std::size_t >(kind)].sent = false;
+		}
+	}
+
+}; // namespace StreamDeckIntegration
+}; // namespace Mumble
@@ -0,0 +1,130 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#ifndef MUMBLE_STREAMDECK_INTEGRATION_OUTBOUNDQUEUE_H_
+#define MUMBLE_STREAMDECK_INTEGRATION_OUTBOUNDQUEUE_H_
+
+#include "ESDSDKDefines.h"
+#include "IDTable.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	/**
+	 * Collects updates of the visual state of buttons (title, image, state) until they are flushed. For
+	 * every button and kind of update, only the latest value is kept. Updates that wouldn't change what has
+	 * been sent to the Stream Deck before are dropped altogether. Large values (such as images) can be compared
+	 * by their hash, so that finding out whether they have changed doesn't require comparing them in full.
+	 *
+	 * The updates are stored in a flat table indexed by the contexts' handles.
+	 */
+	class OutboundQueue {
+	public:
+		enum class Kind { Title = 0, Image, State };
+
+		struct Value {
+			ESDSDKTarget target = kESDSDKTarget_HardwareAndSoftware;
+			int state           = 0;
+			std::string text;
+			/// Shared content that is sent instead of the text (e.g. a cached image), so that it isn't copied
+			std::shared_ptr< const std::string > content;
+			/// The hash of the content. Values with content are compared by their hash instead of the content.
+			std::uint64_t contentHash = 0;
+
+			/**
+			 * @returns The content, if there is any, or the text otherwise
+			 */
+			const std::string &payload() const { return content ? *content : text; }
+
+			bool operator==(const Value &other) const {
+				if (target != other.target || state != other.state || !content != !other.content) {
+					return false;
+				}
+
+				return content ? contentHash == other.contentHash : text == other.text;
+			}
+		};
+
+		enum class PushResult {
+			/// The update has been queued
+			Queued,
+			/// The update has been queued into an empty queue (and thus a flush has to be scheduled)
+			QueuedFirst,
+			/// The update has replaced one that hasn't been sent yet
+			Coalesced,
+			/// The update has been dropped as it wouldn't change anything (or the context is invalid)
+			Dropped
+		};
+
+		/**
+		 * Queues the given update
+		 *
+		 * @param context The context of the button the update is for
+		 * @param kind The kind of update
+		 * @param value The new value
+		 * @returns What has become of the update
+		 */
+		PushResult push(ContextHandle context, Kind kind, Value value);
+
+		/**
+		 * Hands all queued updates to the given sender and remembers them as being sent
+		 *
+		 * @param send A callable taking the context, the kind and the value of an update
+		 */
+		template< typename Sender > void flush(Sender &&send) {
+			std::vector< std::pair< ContextHandle, Kind > > dirty;
+			dirty.swap(m_dirty);
+
+			for (const std::pair< ContextHandle, Kind > &current : dirty) {
+				if (current.first.value >= m_contexts.size()) {
+					continue;
+				}
+
+				Slot &slot = m_contexts[current.first.value][static_cast< std::size_t >(current.second)];
+				if (!slot.pending) {
+					continue;
+				}
+
+				slot.pending = false;
+				slot.sent    = true;
+				std::swap(slot.sentValue, slot.pendingValue);
+
+				send(current.first, current.second, slot.sentValue);
+			}
+		}
+
+		/**
+		 * Forgets everything about the given context (including what has been sent for it)
+		 */
+		void forget(ContextHandle context);
+
+		/**
+		 * Forgets what has been sent for the given context and kind, so the next update is sent no matter what
+		 */
+		void invalidate(ContextHandle context, Kind kind);
+
+	private:
+		struct Slot {
+			bool pending = false;
+			bool sent    = false;
+			Value pendingValue;
+			Value sentValue;
+		};
+
+		std::vector< std::array< Slot, 3 > > m_contexts;
+		std::vector< std::pair< ContextHandle, Kind > > m_dirty;
+	};
+
+};     // namespace StreamDeckIntegration
+};     // namespace Mumble
+#endif // MUMBLE_STREAMDECK_INTEGRATION_OUTBOUNDQUEUE_H_
@@ -0,0 +1,407 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#include "PNGEncoder.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+// SSE2 is available on every x86-64 CPU
+#	define MUMBLE_STREAMDECK_ADLER32_SSE2
+#	include <emmintrin.h>
+#endif
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	namespace {
+		constexpr unsigned char signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+		constexpr std::size_t maxStoredBlockSize = 65535;
+		constexpr std::size_t minMatchLength     = 3;
+		constexpr std::size_t maxMatchLength     = 258;
+		constexpr unsigned int endOfBlock        = 256;
+
+		constexpr std::uint16_t lengthBases[]   = { 3,  4,  5,  6,  7,  8,  9,  10,  11,  13,  15,  17,  19,  23,  27,
+													31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+		constexpr std::uint8_t lengthExtras[]   = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+													2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+		constexpr std::uint16_t distanceBases[] = { 1,    2,    3,    4,    5,    7,    9,    13,    17,    25,
+													33,   49,   65,   97,   129,  193,  257,  385,   513,   769,
+													1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+
+		/**
+		 * @returns The lowest count bits of the given value in reverse order (Huffman codes are stored starting
+		 * 	with their most significant bit, unlike everything else in deflate)
+		 */
+		std::uint32_t reverseBits(std::uint32_t value, unsigned int count) {
+			std::uint32_t reversed = 0;
+			for (unsigned int i = 0; i < count; ++i) {
+				reversed = (reversed << 1) | ((value >> i) & 1);
+			}
+
+			return reversed;
+		}
+
+		/**
+		 * A code (or a code followed by its extra bits), ready to be written
+		 */
+		struct BitString {
+			std::uint32_t bits = 0;
+			unsigned int count = 0;
+		};
+
+		struct Tables {
+			/// The CRC-32 lookup tables for processing 8 bytes at a time
+			std::array< std::array< std::uint32_t, 256 >, 8 > crc;
+			/// The fixed Huffman codes of all literals
+			std::array< BitString, 256 > literals;
+			/// The code and extra bits of every match length
+			std::array< BitString, maxMatchLength + 1 > lengths;
+		};
+
+		/**
+		 * @returns The fixed Huffman code of the given literal/length symbol
+		 */
+		BitString fixedCode(unsigned int symbol) {
+			if (symbol < 144) {
+				return { reverseBits(0x30 + symbol, 8), 8 };
+			} else if (symbol < 256) {
+				return { reverseBits(0x190 + symbol - 144, 9), 9 };
+			} else if (symbol < 280) {
+				return { reverseBits(symbol - 256, 7), 7 };
+			}
+
+			return { reverseBits(0xC0 + symbol - 280, 8), 8 };
+		}
+
+		Tables createTables() {
+			Tables tables;
+
+			for (std::uint32_t i = 0; i < 256; ++i) {
+				std::uint32_t crc = i;
+				for (int bit = 0; bit < 8; ++bit) {
+					crc = (crc & 1) ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+				}
+				tables.crc[0][i] = crc;
+			}
+			for (std::size_t slice = 1; slice < tables.crc.size(); ++slice) {
+				for (std::size_t i = 0; i < 256; ++i) {
+					const std::uint32_t previous = tables.crc[slice - 1][i];
+					tables.crc[slice][i]         = (previous >> 8) ^ tables.crc[0][previous & 0xFF];
+				}
+			}
+
+			for (unsigned int i = 0; i < tables.literals.size(); ++i) {
+				tables.literals[i] = fixedCode(i);
+			}
+
+			unsigned int symbol = 0;
+			for (std::size_t length = minMatchLength; length <= maxMatchLength; ++length) {
+				if (symbol + 1 < std::size(lengthBases) && length >= lengthBases[symbol + 1]) {
+					symbol++;
+				}
+
+				const BitString code      = fixedCode(257 + symbol);
+				const std::uint32_t extra = static_cast< std::uint32_t >(length - lengthBases[symbol]);
+
+				tables.lengths[length] = { code.bits | (extra << code.count), code.count + lengthExtras[symbol] };
+			}
+
+			return tables;
+		}
+
+		const Tables &tables() {
+			static const Tables instance = createTables();
+
+			return instance;
+		}
+
+		/**
+		 * @returns The code and extra bits of the given match distance (distances use fixed 5-bit codes)
+		 */
+		BitString distanceCode(std::size_t distance) {
+			unsigned int symbol = 0;
+			while (symbol + 1 < std::size(distanceBases) && distance >= distanceBases[symbol + 1]) {
+				symbol++;
+			}
+
+			const unsigned int extraBits = symbol < 4 ? 0 : symbol / 2 - 1;
+			const std::uint32_t extra    = static_cast< std::uint32_t >(distance - distanceBases[symbol]);
+
+			return { reverseBits(symbol, 5) | (extra << 5), 5 + extraBits };
+		}
+
+		std::uint32_t load32(const unsigned char *data) {
+			return static_cast< std::uint32_t >(data[0]) | (static_cast< std::uint32_t >(data[1]) << 8)
+				   | (static_cast< std::uint32_t >(data[2]) << 16) | (static_cast< std::uint32_t >(data[3]) << 24);
+		}
+
+		std::uint32_t crc32(const unsigned char *data, std::size_t size) {
+			const auto &table = tables().crc;
+			std::uint32_t crc = 0xFFFFFFFFu;
+
+			for (; size >= 8; size -= 8, data += 8) {
+				const std::uint32_t first  = load32(data) ^ crc;
+				const std::uint32_t second = load32(data + 4);
+
+				crc = table[7][first & 0xFF] ^ table[6][(first >> 8) & 0xFF] ^ table[5][(first >> 16) & 0xFF]
+					  ^ table[4][first >> 24] ^ table[3][second & 0xFF] ^ table[2][(second >> 8) & 0xFF]
+					  ^ table[1][(second >> 16) & 0xFF] ^ table[0][second >> 24];
+			}
+
+			for (; size > 0; --size, ++data) {
+				crc = table[0][(crc ^ *data) & 0xFF] ^ (crc >> 8);
+			}
+
+			return ~crc;
+		}
+
+		std::uint32_t adler32(const unsigned char *data, std::size_t size) {
+			// The largest number of bytes that can be summed up before the sums have to be reduced
+			constexpr std::size_t maxRun = 5552;
+
+			std::uint32_t a = 1;
+			std::uint32_t b = 0;
+
+			while (size > 0) {
+				const std::size_t run = std::min(size, maxRun);
+				std::size_t i         = 0;
+
+#ifdef MUMBLE_STREAMDECK_ADLER32_SSE2
+				// Every byte is added to b once for every byte following it in the run (and for itself). For blocks
+				// of 16 bytes, that is 16 times the sum of all bytes before the block plus the bytes of the block
+				// weighted by their distance to its end.
+				const __m128i zero          = _mm_setzero_si128();
+				const __m128i weightsFirst  = _mm_setr_epi16(16, 15, 14, 13, 12, 11, 10, 9);
+				const __m128i weightsSecond = _mm_setr_epi16(8, 7, 6, 5, 4, 3, 2, 1);
+
+				__m128i sums         = zero;
+				__m128i previousSums = zero;
+				__m128i weighted     = zero;
+				std::size_t blocks   = 0;
+				for (; i + 16 <= run; i += 16, ++blocks) {
+					const __m128i bytes = _mm_loadu_si128(reinterpret_cast< const __m128i * >(data + i));
+
+					const __m128i first  = _mm_madd_epi16(_mm_unpacklo_epi8(bytes, zero), weightsFirst);
+					const __m128i second = _mm_madd_epi16(_mm_unpackhi_epi8(bytes, zero), weightsSecond);
+
+					previousSums = _mm_add_epi32(previousSums, sums);
+					sums         = _mm_add_epi32(sums, _mm_sad_epu8(bytes, zero));
+					weighted     = _mm_add_epi32(weighted, _mm_add_epi32(first, second));
+				}
+
+				const auto sumLanes = [](__m128i vector) {
+					std::uint32_t lanes[4];
+					_mm_storeu_si128(reinterpret_cast< __m128i * >(lanes), vector);
+
+					return static_cast< std::uint64_t >(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+				};
+
+				const std::uint64_t blockB = static_cast< std::uint64_t >(blocks) * 16 * a
+											 + 16 * sumLanes(previousSums) + sumLanes(weighted);
+				b = static_cast< std::uint32_t >((b + blockB) % 65521);
+				a += static_cast< std::uint32_t >(sumLanes(sums));
+#endif
+
+				for (; i < run; ++i) {
+					a += data[i];
+					b += a;
+				}
+
+				a %= 65521;
+				b %= 65521;
+				data += run;
+				size -= run;
+			}
+
+			return (b << 16) | a;
+		}
+
+		/**
+		 * @returns For how many bytes (at most limit) the data at the given position repeats what is distance bytes
+		 * 	before it
+		 */
+		std::size_t matchLength(const unsigned char *data, std::size_t distance, std::size_t limit) {
+			std::size_t length = 0;
+
+			// Compare 8 bytes at a time for as long as possible
+			for (; length + 8 <= limit; length += 8) {
+				std::uint64_t current;
+				std::uint64_t previous;
+				std::memcpy(&current, data + length, sizeof(current));
+				std::memcpy(&previous, data + length - distance, sizeof(previous));
+
+				if (current != previous) {
+					break;
+				}
+			}
+
+			while (length < limit && data[length] == data[length - distance]) {
+				length++;
+			}
+
+			return length;
+		}
+
+		void appendBigEndian(std::string &buffer, std::uint32_t value) {
+			buffer.push_back(static_cast< char >(value >> 24));
+			buffer.push_back(static_cast< char >(value >> 16));
+			buffer.push_back(static_cast< char >(value >> 8));
+			buffer.push_back(static_cast< char >(value));
+		}
+	} // namespace
+
+	const std::string &PNGEncoder::encode(const Bitmap &bitmap, Compression compression) {
+		m_buffer.clear();
+		m_buffer.append(reinterpret_cast< const char * >(signature), sizeof(signature));
+
+		std::size_t start = m_buffer.size();
+		beginChunk("IHDR");
+		appendBigEndian(m_buffer, bitmap.width());
+		appendBigEndian(m_buffer, bitmap.height());
+		// 8 bits per channel, RGBA, deflate, no filtering and no interlacing
+		m_buffer.append({ 8, 6, 0, 0, 0 });
+		endChunk(start);
+
+		// Every row is stored as it is (filter type 0)
+		const std::size_t rowSize = bitmap.width() * Bitmap::bytesPerPixel;
+		m_scanlines.resize((rowSize + 1) * bitmap.height());
+		for (unsigned int y = 0; y < bitmap.height(); ++y) {
+			char *scanline = &m_scanlines[y * (rowSize + 1)];
+			scanline[0]    = 0;
+			std::memcpy(scanline + 1, bitmap.row(y), rowSize);
+		}
+
+		start = m_buffer.size();
+		beginChunk("IDAT");
+		// The zlib header (deflate with a 32 KiB window, compressed using the fastest algorithm)
+		m_buffer.append({ 0x78, 0x01 });
+		if (compression == Compression::Stored) {
+			writeStored();
+		} else {
+			writeRunLength(rowSize + 1);
+		}
+		appendBigEndian(m_buffer,
+						adler32(reinterpret_cast< const unsigned char * >(m_scanlines.data()), m_scanlines.size()));
+		endChunk(start);
+
+		start = m_buffer.size();
+		beginChunk("IEND");
+		endChunk(start);
+
+		return m_buffer;
+	}
+
+	void PNGEncoder::writeStored() {
+		std::size_t offset = 0;
+
+		do {
+			const std::size_t size = std::min(m_scanlines.size() - offset, maxStoredBlockSize);
+			const bool last        = offset + size == m_scanlines.size();
+
+			// Stored blocks start at a byte boundary, so their header takes up a whole byte
+			m_buffer.push_back(last ? 1 : 0);
+			m_buffer.push_back(static_cast< char >(size & 0xFF));
+			m_buffer.push_back(static_cast< char >(size >> 8));
+			m_buffer.push_back(static_cast< char >(~size & 0xFF));
+			m_buffer.push_back(static_cast< char >((~size >> 8) & 0xFF));
+			m_buffer.append(m_scanlines, offset, size);
+
+			offset += size;
+		} while (offset < m_scanlines.size());
+	}
+
+	void PNGEncoder::writeRunLength(std::size_t stride) {
+		const Tables &codes = tables();
+
+		// Only two distances are ever used: the one to the previous pixel and the one to the pixel above
+		const std::size_t distances[]   = { Bitmap::bytesPerPixel, stride };
+		const BitString distanceCodes[] = { distanceCode(distances[0]), distanceCode(distances[1]) };
+
+		const unsigned char *data = reinterpret_cast< const unsigned char * >(m_scanlines.data());
+		const std::size_t size    = m_scanlines.size();
+
+		// A single final block using the fixed Huffman codes
+		writeBits(1, 1);
+		writeBits(1, 2);
+
+		std::size_t position = 0;
+		while (position < size) {
+			const std::size_t limit = std::min(size - position, maxMatchLength);
+
+			std::size_t bestLength = 0;
+			std::size_t bestIndex  = 0;
+			for (std::size_t i = 0; i < std::size(distances); ++i) {
+				if (position >= distances[i]) {
+					const std::size_t length = matchLength(data + position, distances[i], limit);
+					if (length > bestLength) {
+						bestLength = length;
+						bestIndex  = i;
+					}
+				}
+			}
+
+			if (bestLength >= minMatchLength) {
+				writeBits(codes.lengths[bestLength].bits, codes.lengths[bestLength].count);
+				writeBits(distanceCodes[bestIndex].bits, distanceCodes[bestIndex].count);
+
+				position += bestLength;
+			} else {
+				writeBits(codes.literals[data[position]].bits, codes.literals[data[position]].count);
+
+				position++;
+			}
+		}
+
+		const BitString end = fixedCode(endOfBlock);
+		writeBits(end.bits, end.count);
+		flushBits();
+	}
+
+	void PNGEncoder::writeBits(std::uint32_t value, unsigned int count) {
+		m_bits |= static_cast< std::uint64_t >(value) << m_bitCount;
+		m_bitCount += count;
+
+		if (m_bitCount >= 32) {
+			for (int i = 0; i < 4; ++i) {
+				m_buffer.push_back(static_cast< char >(m_bits & 0xFF));
+				m_bits >>= 8;
+			}
+			m_bitCount -= 32;
+		}
+	}
+
+	void PNGEncoder::flushBits() {
+		while (m_bitCount > 0) {
+			m_buffer.push_back(static_cast< char >(m_bits & 0xFF));
+			m_bits >>= 8;
+			m_bitCount = m_bitCount > 8 ? m_bitCount - 8 : 0;
+		}
+
+		m_bits = 0;
+	}
+
+	void PNGEncoder::beginChunk(const char *type) {
+		// The chunk's length is filled in once it is known
+		m_buffer.append(4, '\0');
+		m_buffer.append(type, 4);
+	}
+
+	void PNGEncoder::endChunk(std::size_t start) {
+		const std::size_t length = m_buffer.size() - start - 8;
+		for (int i = 0; i < 4; ++i) {
+			m_buffer[start + i] = static_cast< char >(length >> (24 - 8 * i));
+		}
+
+		// The CRC covers the chunk's type and data
+		appendBigEndian(m_buffer, crc32(reinterpret_cast< const unsigned char * >(m_buffer.data()) + start + 4,
+										m_buffer.size() - start - 4));
+	}
+
+}; // namespace StreamDeckIntegration
+}; // namespace Mumble
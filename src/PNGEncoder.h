@@ -0,0 +1,64 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#ifndef MUMBLE_STREAMDECK_INTEGRATION_PNGENCODER_H_
+#define MUMBLE_STREAMDECK_INTEGRATION_PNGENCODER_H_
+
+#include "Bitmap.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	/**
+	 * Encodes bitmaps as PNG files. Instead of trying to compress as well as possible, this only does what is
+	 * cheap: images drawn by the plugin mostly consist of flat colors, so encoding runs of repeated pixels gets
+	 * most of the way already.
+	 *
+	 * The encoded image is written into an internal buffer that is reused for every image, so once it has grown
+	 * large enough, encoding an image doesn't allocate any memory.
+	 */
+	class PNGEncoder {
+	public:
+		enum class Compression {
+			/// The pixels are stored uncompressed (the fastest option, but as large as the bitmap itself)
+			Stored,
+			/// Runs of the same pixel and rows repeating the one above are compressed, everything else is stored
+			/// as it is (using deflate's fixed Huffman codes)
+			RunLength
+		};
+
+		/**
+		 * Encodes the given bitmap
+		 *
+		 * @param bitmap The bitmap to encode
+		 * @param compression How to compress the image data
+		 * @returns The PNG file (valid until the next image is encoded)
+		 */
+		const std::string &encode(const Bitmap &bitmap, Compression compression = Compression::RunLength);
+
+	private:
+		std::string m_buffer;
+		/// The rows of the image, each preceded by its filter type (as they are compressed)
+		std::string m_scanlines;
+		std::uint64_t m_bits    = 0;
+		unsigned int m_bitCount = 0;
+
+		void writeStored();
+		void writeRunLength(std::size_t stride);
+
+		void writeBits(std::uint32_t value, unsigned int count);
+		void flushBits();
+
+		void beginChunk(const char *type);
+		void endChunk(std::size_t start);
+	};
+
+};     // namespace StreamDeckIntegration
+};     // namespace Mumble
+#endif // MUMBLE_STREAMDECK_INTEGRATION_PNGENCODER_H_
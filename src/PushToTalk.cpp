@@ -0,0 +1,135 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#include "PushToTalk.h"
+
+#include <algorithm>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	PushToTalk::PushToTalk(std::string activateRequest, std::string deactivateRequest, std::string warmUpRequest,
+						   Executor executor, ErrorHandler onError, Metrics::Recorder recorder)
+		: m_activateRequest(std::move(activateRequest)), m_deactivateRequest(std::move(deactivateRequest)),
+		  m_warmUpRequest(std::move(warmUpRequest)), m_executor(std::move(executor)), m_onError(std::move(onError)),
+		  m_recorder(recorder), m_thread(&PushToTalk::run, this) {}
+
+	PushToTalk::~PushToTalk() {
+		if (!m_held.empty()) {
+			// Don't leave the microphone on
+			enqueue(Kind::Deactivate, *m_held.begin());
+			m_held.clear();
+		}
+
+		{
+			std::lock_guard< std::mutex > guard(m_jobMutex);
+			m_stop = true;
+		}
+		m_jobCondition.notify_one();
+
+		m_thread.join();
+	}
+
+	void PushToTalk::press(ContextHandle context) {
+		const bool wasIdle = m_held.empty();
+
+		if (m_held.insert(context).second && wasIdle) {
+			enqueue(Kind::Activate, context);
+		}
+	}
+
+	void PushToTalk::release(ContextHandle context) {
+		// The microphone stays active for as long as any other push-to-talk button is held down
+		if (m_held.erase(context) > 0 && m_held.empty()) {
+			enqueue(Kind::Deactivate, context);
+		}
+	}
+
+	void PushToTalk::warmUp() {
+		{
+			std::lock_guard< std::mutex > guard(m_jobMutex);
+			if (m_warmingUp) {
+				return;
+			}
+
+			m_warmingUp = true;
+		}
+
+		enqueue(Kind::WarmUp, {});
+	}
+
+	bool PushToTalk::isActive() const { return !m_held.empty(); }
+
+	void PushToTalk::enqueue(Kind kind, ContextHandle context) {
+		{
+			std::lock_guard< std::mutex > guard(m_jobMutex);
+
+			if (kind != Kind::WarmUp) {
+				// A press or release establishes the session just as well, so a warm-up that hasn't started yet
+				// would only delay it
+				const auto isWarmUp = [](const Job &job) { return job.kind == Kind::WarmUp; };
+				const auto warmUp   = std::remove_if(m_jobs.begin(), m_jobs.end(), isWarmUp);
+
+				if (warmUp != m_jobs.end()) {
+					m_jobs.erase(warmUp, m_jobs.end());
+					m_warmingUp = false;
+				}
+			}
+
+			m_jobs.push_back({ kind, context, std::chrono::steady_clock::now() });
+		}
+		m_jobCondition.notify_one();
+	}
+
+	void PushToTalk::run() {
+		std::unique_lock< std::mutex > lock(m_jobMutex);
+
+		for (;;) {
+			m_jobCondition.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+
+			if (m_jobs.empty()) {
+				// Everything (in particular every release) has been sent
+				return;
+			}
+
+			const Job job = m_jobs.front();
+			m_jobs.pop_front();
+
+			lock.unlock();
+
+			std::string error;
+			switch (job.kind) {
+				case Kind::Activate:
+					error = m_executor(m_activateRequest, true);
+
+					if (error.empty()) {
+						m_recorder.record(Metrics::Stage::PressToTransmit,
+										  std::chrono::steady_clock::now() - job.issued);
+					}
+					break;
+				case Kind::Deactivate:
+					error = m_executor(m_deactivateRequest, true);
+					break;
+				case Kind::WarmUp:
+					// Failing is fine - the bridge may not be running yet. Only the bridge itself is asked, as the CLI
+					// can't establish a session anyway and running it would only hold up the next press.
+					m_executor(m_warmUpRequest, false);
+					break;
+			}
+
+			if (!error.empty()) {
+				m_onError(job.context, error);
+			}
+
+			lock.lock();
+
+			if (job.kind == Kind::WarmUp) {
+				m_warmingUp = false;
+			}
+		}
+	}
+
+}; // namespace StreamDeckIntegration
+}; // namespace Mumble
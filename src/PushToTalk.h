@@ -0,0 +1,121 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#ifndef MUMBLE_STREAMDECK_INTEGRATION_PUSHTOTALK_H_
+#define MUMBLE_STREAMDECK_INTEGRATION_PUSHTOTALK_H_
+
+#include "IDTable.h"
+#include "Metrics.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	/**
+	 * Activates Mumble's microphone for as long as any push-to-talk button is held down. Every press and
+	 * release is sent to the bridge by a dedicated thread (instead of the executor that is shared with all
+	 * other actions), so that nothing else can delay it. As that thread handles the requests strictly in the
+	 * order they have been made, a release can never overtake the press before it and as every release is
+	 * sent (no matter whether the press succeeded), no release can get lost either.
+	 *
+	 * The requests are serialized once up front. When a push-to-talk button appears while there is no session
+	 * with the bridge, the session is established right away, so that the first press doesn't have to wait for
+	 * that. Such a warm-up only ever talks to the bridge directly (never to the CLI), at most one is pending at
+	 * a time and a press or release that comes in while it hasn't started yet replaces it.
+	 *
+	 * press, release, warmUp and isActive must only be called from the event loop's thread.
+	 */
+	class PushToTalk {
+	public:
+		/**
+		 * Sends the given request to the bridge. Called on the push-to-talk thread.
+		 *
+		 * @param allowCLIFallback Whether the CLI may be used if the bridge can't be reached directly
+		 * @returns Why the request failed (empty if it succeeded)
+		 */
+		using Executor = std::function< std::string(const std::string &request, bool allowCLIFallback) >;
+		/**
+		 * Reports that the request made for the given context failed. Called on the push-to-talk thread.
+		 */
+		using ErrorHandler = std::function< void(ContextHandle context, const std::string &error) >;
+
+		/**
+		 * @param activateRequest The request that activates the microphone
+		 * @param deactivateRequest The request that deactivates the microphone again
+		 * @param warmUpRequest A request that has no effect (used to establish the session with the bridge)
+		 * @param executor Sends requests to the bridge
+		 * @param onError Reports failed requests
+		 * @param recorder Records the time from a press until the bridge has activated the microphone
+		 */
+		PushToTalk(std::string activateRequest, std::string deactivateRequest, std::string warmUpRequest,
+				   Executor executor, ErrorHandler onError, Metrics::Recorder recorder);
+		/**
+		 * Releases the microphone (if any button is still held down) and stops the push-to-talk thread
+		 */
+		~PushToTalk();
+
+		PushToTalk(const PushToTalk &) = delete;
+		PushToTalk &operator=(const PushToTalk &) = delete;
+
+		/**
+		 * Registers that the given button has been pressed
+		 */
+		void press(ContextHandle context);
+		/**
+		 * Registers that the given button has been released (does nothing if it isn't held down)
+		 */
+		void release(ContextHandle context);
+		/**
+		 * Makes sure the session with the bridge is established (does nothing if a warm-up is pending already)
+		 */
+		void warmUp();
+
+		/**
+		 * @returns Whether any button is held down (and thus the microphone is supposed to be active)
+		 */
+		bool isActive() const;
+
+	private:
+		enum class Kind { Activate, Deactivate, WarmUp };
+
+		struct Job {
+			Kind kind;
+			ContextHandle context;
+			std::chrono::steady_clock::time_point issued;
+		};
+
+		const std::string m_activateRequest;
+		const std::string m_deactivateRequest;
+		const std::string m_warmUpRequest;
+		Executor m_executor;
+		ErrorHandler m_onError;
+		Metrics::Recorder m_recorder;
+
+		/// The buttons that are currently held down
+		std::unordered_set< ContextHandle > m_held;
+
+		std::mutex m_jobMutex;
+		std::condition_variable m_jobCondition;
+		std::deque< Job > m_jobs;
+		/// Whether a warm-up is queued or running
+		bool m_warmingUp = false;
+		bool m_stop = false;
+		std::thread m_thread;
+
+		void enqueue(Kind kind, ContextHandle context);
+		void run();
+	};
+
+};     // namespace StreamDeckIntegration
+};     // namespace Mumble
+#endif // MUMBLE_STREAMDECK_INTEGRATION_PUSHTOTALK_H_
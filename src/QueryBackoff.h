@@ -0,0 +1,59 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#ifndef MUMBLE_STREAMDECK_INTEGRATION_QUERYBACKOFF_H_
+#define MUMBLE_STREAMDECK_INTEGRATION_QUERYBACKOFF_H_
+
+#include <algorithm>
+#include <chrono>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	/**
+	 * Keeps a query that the bridge answers with an error (e.g. because it doesn't know the operation) from
+	 * being repeated every time. After every error in a row, the query is suspended for twice as long as
+	 * before (up to a limit). A successful query ends the suspension.
+	 */
+	class QueryBackoff {
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		/**
+		 * @returns Whether the query may be made now
+		 */
+		bool mayQuery(Clock::time_point now = Clock::now()) const { return now >= m_resumeAt; }
+
+		void succeeded() {
+			m_suspension = Clock::duration::zero();
+			m_resumeAt   = Clock::time_point();
+		}
+
+		/**
+		 * Records that the bridge has answered the query with an error
+		 *
+		 * @returns Whether this is the first error since the last success (which is worth reporting)
+		 */
+		bool failed(Clock::time_point now = Clock::now()) {
+			const bool first = m_suspension == Clock::duration::zero();
+
+			m_suspension = first ? Clock::duration(initialSuspension)
+								 : std::min(2 * m_suspension, Clock::duration(maxSuspension));
+			m_resumeAt   = now + m_suspension;
+
+			return first;
+		}
+
+	private:
+		static constexpr std::chrono::seconds initialSuspension{ 10 };
+		static constexpr std::chrono::minutes maxSuspension{ 5 };
+
+		Clock::duration m_suspension = Clock::duration::zero();
+		Clock::time_point m_resumeAt;
+	};
+
+};     // namespace StreamDeckIntegration
+};     // namespace Mumble
+#endif // MUMBLE_STREAMDECK_INTEGRATION_QUERYBACKOFF_H_
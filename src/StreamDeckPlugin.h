@@ -9,6 +9,9 @@
 #ifndef MUMBLE_STREAMDECK_INTEGRATION_STREAMDECKPLUGIN_H_
 #define MUMBLE_STREAMDECK_INTEGRATION_STREAMDECKPLUGIN_H_
 
+#include "IDTable.h"
+#include "InboundMessage.h"
+
 #include <string>
 
 #include <nlohmann/json.hpp>
@@ -25,25 +28,35 @@ namespace StreamDeckIntegration {
 
 		void setConnectionManager(ConnectionManager *inConnectionManager) { m_connectionManager = inConnectionManager; }
 
-		virtual void keyDownForAction(const std::string &inAction, const std::string &inContext,
-									  const nlohmann::json &inPayload, const std::string &inDeviceID) = 0;
-		virtual void keyUpForAction(const std::string &inAction, const std::string &inContext,
-									const nlohmann::json &inPayload, const std::string &inDeviceID)   = 0;
+		virtual void keyDownForAction(ActionHandle inAction, ContextHandle inContext,
+									  const LazyJSON &inPayload, DeviceHandle inDevice) = 0;
+		virtual void keyUpForAction(ActionHandle inAction, ContextHandle inContext,
+									const LazyJSON &inPayload, DeviceHandle inDevice)   = 0;
+
+		virtual void willAppearForAction(ActionHandle inAction, ContextHandle inContext,
+										 const LazyJSON &inPayload, DeviceHandle inDevice)    = 0;
+		virtual void willDisappearForAction(ActionHandle inAction, ContextHandle inContext,
+											const LazyJSON &inPayload, DeviceHandle inDevice) = 0;
 
-		virtual void willAppearForAction(const std::string &inAction, const std::string &inContext,
-										 const nlohmann::json &inPayload, const std::string &inDeviceID)    = 0;
-		virtual void willDisappearForAction(const std::string &inAction, const std::string &inContext,
-											const nlohmann::json &inPayload, const std::string &inDeviceID) = 0;
+		virtual void didReceiveSettings(ActionHandle inAction, ContextHandle inContext,
+										const LazyJSON &inPayload, DeviceHandle inDevice) = 0;
 
-		virtual void deviceDidConnect(const std::string &inDeviceID, const nlohmann::json &inDeviceInfo) = 0;
-		virtual void deviceDidDisconnect(const std::string &inDeviceID)                                  = 0;
+		virtual void propertyInspectorDidDisappear(ActionHandle inAction, ContextHandle inContext,
+												   DeviceHandle inDevice) = 0;
 
-		virtual void sendToPlugin(const std::string &inAction, const std::string &inContext,
-								  const nlohmann::json &inPayload, const std::string &inDeviceID) = 0;
+		virtual void deviceDidConnect(DeviceHandle inDevice, const LazyJSON &inDeviceInfo) = 0;
+		virtual void deviceDidDisconnect(DeviceHandle inDevice)                            = 0;
+
+		virtual void sendToPlugin(ActionHandle inAction, ContextHandle inContext,
+								  const LazyJSON &inPayload, DeviceHandle inDevice) = 0;
 
 		virtual void receivedGlobalSettings(const nlohmann::json &settings) = 0;
 
-		virtual void receivedData(const nlohmann::json &data, const std::string &context) = 0;
+		virtual void receivedData(const nlohmann::json &data, ContextHandle context) = 0;
+
+		virtual void systemDidWakeUp() = 0;
+		/// Called once the connection to the Stream Deck has been re-established after it had been lost
+		virtual void didReconnect() = 0;
 
 	protected:
 		ConnectionManager *m_connectionManager = nullptr;
@@ -17,32 +17,37 @@ namespace Mumble {
 namespace StreamDeckIntegration {
 	namespace Utils {
 
-		nlohmann::json getObjectByName(const nlohmann::json &json, const std::string &name) {
+		namespace {
+			/// Returned by reference if a value can't be found
+			const nlohmann::json nullValue;
+		} // namespace
+
+		const nlohmann::json &getObjectByName(const nlohmann::json &json, const std::string &name) {
 			// Check desired value exists
 			nlohmann::json::const_iterator iter(json.find(name));
 			if (iter == json.end()) {
-				return {};
+				return nullValue;
 			}
 
-			// Check value is an array
+			// Check value is an object
 			if (!iter->is_object()) {
-				return {};
+				return nullValue;
 			}
 
 			// Return found object
 			return *iter;
 		}
 
-		nlohmann::json getArrayByName(const nlohmann::json &json, const std::string &name) {
+		const nlohmann::json &getArrayByName(const nlohmann::json &json, const std::string &name) {
 			// Check desired value exists
 			nlohmann::json::const_iterator iter(json.find(name));
 			if (iter == json.end()) {
-				return {};
+				return nullValue;
 			}
 
 			// Check value is an array
 			if (!iter->is_array()) {
-				return {};
+				return nullValue;
 			}
 
 			// Return found array
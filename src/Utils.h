@@ -9,7 +9,9 @@
 #ifndef MUMBLE_STREAMDECK_INTEGRATION_UTILS_H_
 #define MUMBLE_STREAMDECK_INTEGRATION_UTILS_H_
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 
 #include <nlohmann/json.hpp>
 
@@ -21,18 +23,20 @@ namespace StreamDeckIntegration {
 		 *
 		 * @param json The JSON struct to operate on
 		 * @param name The name of the object that shall be extracted
-		 * @returns The found JSON object or a null object if no object of that name was found
+		 * @returns The found JSON object or a null object if no object of that name was found. The reference
+		 * 	remains valid for as long as the given JSON struct does.
 		 */
-		nlohmann::json getObjectByName(const nlohmann::json &json, const std::string &name);
+		const nlohmann::json &getObjectByName(const nlohmann::json &json, const std::string &name);
 
 		/**
 		 * Get array by name
 		 *
 		 * @param json The JSON struct to operate on
 		 * @param name The name of the array that shall be extracted
-		 * @returns The found JSON object or a null object if no object of that name was found
+		 * @returns The found JSON array or a null object if no array of that name was found. The reference
+		 * 	remains valid for as long as the given JSON struct does.
 		 */
-		nlohmann::json GetArrayByName(const nlohmann::json &json, const std::string &name);
+		const nlohmann::json &getArrayByName(const nlohmann::json &json, const std::string &name);
 
 		/**
 		 * Get string by name
@@ -95,6 +99,24 @@ namespace StreamDeckIntegration {
 		 */
 		float getFloatByName(const nlohmann::json &json, const std::string &name, float defaultValue = 0.0);
 
+		/**
+		 * Computes the FNV-1a hash of the given string. As this can be evaluated at compile time, the result
+		 * can be used to switch over strings.
+		 *
+		 * @param str The string to hash
+		 * @returns The string's hash
+		 */
+		constexpr std::uint32_t hash(std::string_view str) {
+			std::uint32_t hash = 2166136261u;
+
+			for (char c : str) {
+				hash ^= static_cast< unsigned char >(c);
+				hash *= 16777619u;
+			}
+
+			return hash;
+		}
+
 	}; // namespace Utils
 };     // namespace StreamDeckIntegration
 };     // namespace Mumble
@@ -12,6 +12,7 @@
 
 #include "MumblePlugin.h"
 
+#include <csignal>
 #include <iostream>
 #include <memory>
 
@@ -63,6 +64,12 @@ int main(int argc, const char **argv) {
 		return 1;
 	}
 
+#ifndef _WIN32
+	// Writing to a pipe whose reader has gone away (e.g. the bridge's) must result in an error instead of
+	// terminating us
+	std::signal(SIGPIPE, SIG_IGN);
+#endif
+
 	// Create the plugin
 	std::unique_ptr< MumblePlugin > plugin = std::make_unique< MumblePlugin >();
 
@@ -70,8 +77,15 @@ int main(int argc, const char **argv) {
 	std::unique_ptr< ConnectionManager > connectionManager =
 		std::make_unique< ConnectionManager >(port, pluginUUID, registerEvent, info, *plugin);
 
+	// The images are embedded into the executable (already encoded)
+	connectionManager->getImageCache().loadEmbedded();
+
 	// Connect and start the event loop
 	connectionManager->run();
 
+	// Destroy the plugin first as actions that are still running might want to talk
+	// to the connection manager
+	plugin.reset();
+
 	return 0;
 }
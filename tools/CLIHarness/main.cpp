@@ -0,0 +1,209 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+// Repeatedly invokes a JSON bridge CLI (by default the stub one) the same way the plugin does and reports
+// where the time goes: launching the process, reading its output, waiting for it to exit and parsing the
+// returned JSON.
+
+#include "LatencyStats.h"
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/process.hpp>
+
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+using namespace Mumble::StreamDeckIntegration;
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	struct Options {
+		/// The CLI to invoke (searched for in PATH, if it is not a path)
+		std::string cli = "mumble_json_bridge_cli";
+		std::string request =
+			R"({"message_type":"operation","message":{"operation":"toggle_local_user_mute"}})";
+		unsigned int iterations = 200;
+		/// Passed on to the stub CLI via its environment variables (ignored by the real CLI)
+		std::string delay;
+		std::string exitCode;
+		std::string stderrBytes;
+		std::string output;
+	};
+
+	void printUsage(const char *executable) {
+		std::cerr << "Usage: " << executable << " [options]\n"
+				  << "  --cli <path>              CLI to invoke (default: mumble_json_bridge_cli from PATH)\n"
+				  << "  --request <json>          Request to send (default: toggle mute)\n"
+				  << "  --iterations <n>          Number of invocations (default: 200)\n"
+				  << "  --delay <ms>              Stub only: time the CLI takes to answer\n"
+				  << "  --exit-code <n>           Stub only: exit code of the CLI\n"
+				  << "  --stderr-bytes <n>        Stub only: amount of output on stderr\n"
+				  << "  --output <kind>           Stub only: \"valid\", \"malformed\" or \"empty\"\n";
+	}
+
+	bool parseOptions(int argc, const char **argv, Options &options) {
+		for (int i = 1; i < argc; ++i) {
+			const std::string name = argv[i];
+
+			if (name == "--help") {
+				return false;
+			}
+
+			if (i + 1 >= argc) {
+				std::cerr << "Missing value for " << name << std::endl;
+				return false;
+			}
+
+			const std::string value = argv[++i];
+
+			if (name == "--cli") {
+				options.cli = value;
+			} else if (name == "--request") {
+				options.request = nlohmann::json::parse(value).dump();
+			} else if (name == "--iterations") {
+				options.iterations = std::stoul(value);
+			} else if (name == "--delay") {
+				options.delay = value;
+			} else if (name == "--exit-code") {
+				options.exitCode = value;
+			} else if (name == "--stderr-bytes") {
+				options.stderrBytes = value;
+			} else if (name == "--output") {
+				options.output = value;
+			} else {
+				std::cerr << "Unknown option " << name << std::endl;
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	boost::process::environment makeEnvironment(const Options &options) {
+		boost::process::environment environment = boost::this_process::environment();
+
+		const auto set = [&environment](const char *name, const std::string &value) {
+			if (!value.empty()) {
+				environment[name] = value;
+			}
+		};
+		set("STUB_BRIDGE_DELAY_MS", options.delay);
+		set("STUB_BRIDGE_EXIT_CODE", options.exitCode);
+		set("STUB_BRIDGE_STDERR_BYTES", options.stderrBytes);
+		set("STUB_BRIDGE_OUTPUT", options.output);
+
+		return environment;
+	}
+} // namespace
+
+int main(int argc, const char **argv) {
+	Options options;
+
+	try {
+		if (!parseOptions(argc, argv, options)) {
+			printUsage(argv[0]);
+			return 1;
+		}
+	} catch (const std::exception &e) {
+		std::cerr << "Invalid option value: " << e.what() << std::endl;
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	boost::filesystem::path cliPath = options.cli;
+	if (cliPath.parent_path().empty()) {
+		cliPath = boost::process::search_path(options.cli);
+	}
+	if (cliPath.empty() || !boost::filesystem::exists(cliPath)) {
+		std::cerr << "Unable to locate \"" << options.cli << "\"" << std::endl;
+		return 1;
+	}
+
+	const boost::process::environment environment = makeEnvironment(options);
+
+	LatencyStats spawn;
+	LatencyStats pipeRead;
+	LatencyStats wait;
+	LatencyStats parse;
+	LatencyStats total;
+	unsigned int launchFailures = 0;
+	unsigned int exitFailures   = 0;
+	unsigned int parseFailures  = 0;
+
+	for (unsigned int i = 0; i < options.iterations; ++i) {
+		const Clock::time_point start = Clock::now();
+
+		boost::asio::io_context ioContext;
+		boost::process::async_pipe stdoutPipe(ioContext);
+		boost::process::async_pipe stderrPipe(ioContext);
+		std::error_code launchErrorCode;
+		boost::process::child c(cliPath, "--json", options.request, boost::process::std_out > stdoutPipe,
+								boost::process::std_err > stderrPipe, boost::process::std_in.close(), environment,
+								launchErrorCode);
+
+		const Clock::time_point spawned = Clock::now();
+
+		if (launchErrorCode) {
+			++launchFailures;
+			continue;
+		}
+
+		// Like in the plugin, both outputs are drained concurrently so that large amounts of output on either
+		// of them can't stall the CLI
+		std::string stdout_content;
+		std::string stderr_content;
+		boost::asio::async_read(stdoutPipe, boost::asio::dynamic_buffer(stdout_content),
+								[](const boost::system::error_code &, std::size_t) {});
+		boost::asio::async_read(stderrPipe, boost::asio::dynamic_buffer(stderr_content),
+								[](const boost::system::error_code &, std::size_t) {});
+		ioContext.run();
+
+		const Clock::time_point read = Clock::now();
+
+		c.wait();
+
+		const Clock::time_point exited = Clock::now();
+
+		bool parsed = true;
+		try {
+			nlohmann::json response = nlohmann::json::parse(stdout_content.begin(), stdout_content.end());
+			(void) response;
+		} catch (const nlohmann::json::parse_error &) {
+			parsed = false;
+		}
+
+		const Clock::time_point end = Clock::now();
+
+		spawn.add(spawned - start);
+		pipeRead.add(read - spawned);
+		wait.add(exited - read);
+		parse.add(end - exited);
+		total.add(end - start);
+
+		if (c.exit_code() != 0) {
+			++exitFailures;
+		} else if (!parsed) {
+			++parseFailures;
+		}
+	}
+
+	LatencyStats::printHeader(std::cout);
+	spawn.print(std::cout, "spawn");
+	pipeRead.print(std::cout, "pipe read");
+	wait.print(std::cout, "wait");
+	parse.print(std::cout, "parse");
+	total.print(std::cout, "total");
+
+	std::cout << std::endl
+			  << "Launch failures: " << launchFailures << ", non-zero exit codes: " << exitFailures
+			  << ", malformed responses: " << parseFailures << std::endl;
+
+	return 0;
+}
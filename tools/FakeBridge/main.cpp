@@ -0,0 +1,565 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+// A stand-in for the JSON bridge itself (as opposed to its CLI, see StubBridgeCLI) that speaks the bridge's
+// pipe protocol: it listens on the bridge's named pipe, accepts registrations and answers every operation on
+// the registered client's response pipe. Instead of talking to Mumble, it echoes the operation's message back
+// (response type "echo").
+//
+// Responses that belong to requests which have been read in one go are sent in reverse order, so that
+// clients have to match them by their message ID. With --omit-ids, the responses don't carry the message
+// ID at all (like those of older bridges) and are sent in the order the requests have been read in.
+//
+// With --check, it runs a fake bridge of its own in a temporary directory and checks the plugin's
+// BridgeClient against it (exiting with 1 if anything is wrong).
+
+#include "BridgeClient.h"
+#include "CheckRunner.h"
+
+#include <nlohmann/json.hpp>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace Mumble::StreamDeckIntegration;
+
+namespace {
+	struct Options {
+		std::string pipePath = BridgeClient::defaultBridgePipePath();
+		/// Leave out the message IDs in the responses
+		bool omitIDs = false;
+		/// Milliseconds to wait before answering
+		unsigned int delay = 0;
+		bool check         = false;
+	};
+
+	void printUsage(const char *executable) {
+		std::cerr << "Usage: " << executable << " [options]\n"
+				  << "  --pipe <path>             Pipe to listen on (default: the bridge's default location)\n"
+				  << "  --omit-ids                Don't put the message IDs into the responses\n"
+				  << "  --delay <ms>              Time to wait before answering (default: 0)\n"
+				  << "  --check                   Check the plugin's bridge client against a fake bridge\n";
+	}
+
+	bool parseOptions(int argc, const char **argv, Options &options) {
+		for (int i = 1; i < argc; ++i) {
+			const std::string name = argv[i];
+
+			if (name == "--help") {
+				return false;
+			} else if (name == "--omit-ids") {
+				options.omitIDs = true;
+				continue;
+			} else if (name == "--check") {
+				options.check = true;
+				continue;
+			}
+
+			if (i + 1 >= argc) {
+				std::cerr << "Missing value for " << name << std::endl;
+				return false;
+			}
+
+			const std::string value = argv[++i];
+
+			if (name == "--pipe") {
+				options.pipePath = value;
+			} else if (name == "--delay") {
+				options.delay = std::stoul(value);
+			} else {
+				std::cerr << "Unknown option " << name << std::endl;
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	/**
+	 * @returns The index one past the end of the JSON object starting at the given position or std::string::npos
+	 * 	if the object is not yet complete
+	 */
+	std::size_t findObjectEnd(const std::string &buffer, std::size_t start) {
+		int depth     = 0;
+		bool inString = false;
+		bool escaped  = false;
+
+		for (std::size_t i = start; i < buffer.size(); ++i) {
+			const char c = buffer[i];
+
+			if (inString) {
+				if (escaped) {
+					escaped = false;
+				} else if (c == '\\') {
+					escaped = true;
+				} else if (c == '"') {
+					inString = false;
+				}
+			} else if (c == '"') {
+				inString = true;
+			} else if (c == '{' || c == '[') {
+				depth++;
+			} else if ((c == '}' || c == ']') && --depth == 0) {
+				return i + 1;
+			}
+		}
+
+		return std::string::npos;
+	}
+
+	class FakeBridge {
+	public:
+		FakeBridge(const Options &options) : m_options(options) {}
+		~FakeBridge() { stop(); }
+
+		FakeBridge(const FakeBridge &) = delete;
+		FakeBridge &operator=(const FakeBridge &) = delete;
+
+		/**
+		 * Creates the bridge's pipe and starts answering on a thread of its own
+		 *
+		 * @returns Whether the pipe could be created
+		 */
+		bool start() {
+			unlink(m_options.pipePath.c_str());
+
+			if (mkfifo(m_options.pipePath.c_str(), 0600) != 0) {
+				std::cerr << "Unable to create " << m_options.pipePath << ": " << std::strerror(errno) << std::endl;
+				return false;
+			}
+
+			// Opening for reading and writing keeps the pipe from reporting EOF whenever a client closes its end
+			m_pipe = open(m_options.pipePath.c_str(), O_RDWR | O_NONBLOCK);
+			if (m_pipe < 0) {
+				std::cerr << "Unable to open " << m_options.pipePath << ": " << std::strerror(errno) << std::endl;
+				unlink(m_options.pipePath.c_str());
+				return false;
+			}
+
+			m_stop   = false;
+			m_thread = std::thread(&FakeBridge::run, this);
+
+			return true;
+		}
+
+		/**
+		 * Stops answering and removes the bridge's pipe (as if the bridge had gone away)
+		 */
+		void stop() {
+			if (m_thread.joinable()) {
+				m_stop = true;
+				m_thread.join();
+			}
+
+			if (m_pipe >= 0) {
+				close(m_pipe);
+				unlink(m_options.pipePath.c_str());
+				m_pipe = -1;
+			}
+		}
+
+		/**
+		 * @returns The response pipes of all clients that have registered so far
+		 */
+		std::vector< std::string > clientPipes() const {
+			std::lock_guard< std::mutex > guard(m_clientsMutex);
+
+			std::vector< std::string > pipes;
+			for (const auto &current : m_clients) {
+				pipes.push_back(current.second.pipePath);
+			}
+
+			return pipes;
+		}
+
+	private:
+		struct Client {
+			std::string secret;
+			std::string pipePath;
+		};
+
+		Options m_options;
+		int m_pipe = -1;
+		std::thread m_thread;
+		std::atomic_bool m_stop = { false };
+
+		mutable std::mutex m_clientsMutex;
+		std::unordered_map< std::uint64_t, Client > m_clients;
+		std::uint64_t m_nextClientID = 1;
+
+		void run() {
+			std::string buffer;
+			char chunk[4096];
+
+			while (!m_stop) {
+				pollfd descriptor = { m_pipe, POLLIN, 0 };
+				if (poll(&descriptor, 1, 50) <= 0) {
+					continue;
+				}
+
+				const ssize_t readBytes = read(m_pipe, chunk, sizeof(chunk));
+				if (readBytes <= 0) {
+					continue;
+				}
+				buffer.append(chunk, static_cast< std::size_t >(readBytes));
+
+				std::vector< nlohmann::json > requests;
+				std::size_t consumed = 0;
+				while (true) {
+					const std::size_t start = buffer.find('{', consumed);
+					const std::size_t end =
+						start == std::string::npos ? std::string::npos : findObjectEnd(buffer, start);
+
+					if (end == std::string::npos) {
+						consumed = start == std::string::npos ? buffer.size() : start;
+						break;
+					}
+
+					try {
+						requests.push_back(nlohmann::json::parse(buffer.begin() + start, buffer.begin() + end));
+					} catch (const nlohmann::json::parse_error &e) {
+						std::cerr << "Received malformed message: " << e.what() << std::endl;
+					}
+
+					consumed = end;
+				}
+				buffer.erase(0, consumed);
+
+				if (!m_options.omitIDs) {
+					std::reverse(requests.begin(), requests.end());
+				}
+				for (const nlohmann::json &request : requests) {
+					handle(request);
+				}
+			}
+		}
+
+		void handle(const nlohmann::json &request) {
+			if (m_options.delay > 0) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(m_options.delay));
+			}
+
+			if (request.value("message_type", "") == "registration") {
+				const std::string pipePath = request.at("message").value("pipe_path", "");
+
+				std::uint64_t clientID;
+				std::string secret;
+				{
+					std::lock_guard< std::mutex > guard(m_clientsMutex);
+
+					clientID            = m_nextClientID++;
+					secret              = "secret-" + std::to_string(clientID);
+					m_clients[clientID] = { secret, pipePath };
+				}
+
+				// The registration's response never carries a message ID
+				send(pipePath, { { "response_type", "registration" },
+								 { "response", { { "client_id", clientID }, { "secret", secret } } } });
+				return;
+			}
+
+			Client client;
+			{
+				std::lock_guard< std::mutex > guard(m_clientsMutex);
+
+				auto it = m_clients.find(request.value("client_id", std::uint64_t(0)));
+				if (it == m_clients.end()) {
+					std::cerr << "Received a message from an unknown client: " << request.dump() << std::endl;
+					return;
+				}
+				client = it->second;
+			}
+
+			nlohmann::json response;
+			if (request.value("secret", "") != client.secret) {
+				response = { { "response_type", "error" }, { "response", { { "error_message", "Invalid secret" } } } };
+			} else {
+				response = { { "response_type", "echo" }, { "response", request.value("message", nlohmann::json()) } };
+			}
+
+			if (!m_options.omitIDs && request.contains("message_id")) {
+				response["message_id"] = request["message_id"];
+			}
+
+			send(client.pipePath, response);
+		}
+
+		void send(const std::string &pipePath, const nlohmann::json &response) {
+			int pipe = open(pipePath.c_str(), O_WRONLY | O_NONBLOCK);
+			if (pipe < 0) {
+				std::cerr << "Unable to open " << pipePath << ": " << std::strerror(errno) << std::endl;
+				return;
+			}
+
+			const std::string message = response.dump();
+			std::size_t offset        = 0;
+			while (offset < message.size()) {
+				const ssize_t written = write(pipe, message.data() + offset, message.size() - offset);
+
+				if (written >= 0) {
+					offset += static_cast< std::size_t >(written);
+				} else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+					pollfd descriptor = { pipe, POLLOUT, 0 };
+					poll(&descriptor, 1, 100);
+				} else if (errno != EINTR) {
+					std::cerr << "Unable to write to " << pipePath << ": " << std::strerror(errno) << std::endl;
+					break;
+				}
+			}
+
+			close(pipe);
+		}
+	};
+
+	/**
+	 * @param padding The number of filler characters to add (in order to make the message larger than what
+	 * 	can be written to a pipe in one go)
+	 * @returns A request for the fake bridge's echo operation that can be told apart from all others by its
+	 * 	parameter
+	 */
+	std::string echoRequest(unsigned int sender, unsigned int index, std::size_t padding = 0) {
+		return nlohmann::json({ { "message_type", "operation" },
+								{ "message",
+								  { { "operation", "echo" },
+									{ "parameter", { { "sender", sender }, { "index", index } } },
+									{ "padding", std::string(padding, '.') } } } })
+			.dump();
+	}
+
+	bool isEchoOf(const nlohmann::json &response, unsigned int sender, unsigned int index) {
+		return response.value("response_type", "") == "echo"
+			   && response["response"].value("parameter", nlohmann::json())
+					  == nlohmann::json({ { "sender", sender }, { "index", index } });
+	}
+
+	class Checks {
+	public:
+		Checks(const std::string &directory) : m_directory(directory) {}
+
+		int run() {
+			for (bool omitIDs : { false, true }) {
+				const std::string suffix =
+					omitIDs ? " (responses without message IDs)" : " (responses with message IDs)";
+
+				m_runner.run("concurrent requests" + suffix, [&]() { return concurrentRequests(omitIDs); });
+				m_runner.run("batched requests" + suffix, [&]() { return batchedRequests(omitIDs); });
+			}
+
+			m_runner.run("reconnecting after the bridge went away", [&]() { return reconnecting(); });
+			m_runner.run("private response pipe", [&]() { return privateResponsePipe(); });
+
+			return m_runner.finish();
+		}
+
+	private:
+		std::string m_directory;
+		CheckRunner m_runner;
+
+		Options bridgeOptions(bool omitIDs) const {
+			Options options;
+			options.pipePath = m_directory + "/bridge";
+			options.omitIDs  = omitIDs;
+
+			return options;
+		}
+
+		std::string concurrentRequests(bool omitIDs) {
+			constexpr unsigned int threadCount = 16;
+			constexpr unsigned int requests    = 50;
+			// Large requests and a bridge that is slow to read them fill up the bridge's pipe, so that the
+			// senders have to wait for each other
+			constexpr std::size_t padding = 16 * 1024;
+
+			Options options = bridgeOptions(omitIDs);
+			options.delay   = 1;
+
+			FakeBridge bridge(options);
+			if (!bridge.start()) {
+				return "Unable to start the fake bridge";
+			}
+
+			BridgeClient client(m_directory + "/bridge");
+			// Register up front, as concurrent requests fail right away while a registration is in progress
+			client.execute(echoRequest(0, 0));
+
+			std::mutex failureMutex;
+			std::string failure;
+			std::vector< std::thread > threads;
+
+			for (unsigned int sender = 1; sender <= threadCount; ++sender) {
+				threads.emplace_back([&, sender]() {
+					for (unsigned int index = 0; index < requests; ++index) {
+						std::string error;
+						try {
+							if (!isEchoOf(client.execute(echoRequest(sender, index, padding)), sender, index)) {
+								error = "Request " + std::to_string(index) + " of thread " + std::to_string(sender)
+										+ " received the response to another request";
+							}
+						} catch (const BridgeException &e) {
+							error = e.what();
+						}
+
+						if (!error.empty()) {
+							std::lock_guard< std::mutex > guard(failureMutex);
+							failure = error;
+							return;
+						}
+					}
+				});
+			}
+
+			for (std::thread &thread : threads) {
+				thread.join();
+			}
+
+			return failure;
+		}
+
+		std::string batchedRequests(bool omitIDs) {
+			constexpr unsigned int requests = 50;
+
+			FakeBridge bridge(bridgeOptions(omitIDs));
+			if (!bridge.start()) {
+				return "Unable to start the fake bridge";
+			}
+
+			BridgeClient client(m_directory + "/bridge");
+
+			std::vector< std::string > messages;
+			for (unsigned int index = 0; index < requests; ++index) {
+				messages.push_back(echoRequest(0, index));
+			}
+
+			const std::vector< nlohmann::json > responses = client.executeAll(messages);
+
+			for (unsigned int index = 0; index < requests; ++index) {
+				if (!isEchoOf(responses[index], 0, index)) {
+					return "Response " + std::to_string(index) + " belongs to another request";
+				}
+			}
+
+			return {};
+		}
+
+		std::string reconnecting() {
+			FakeBridge bridge(bridgeOptions(false));
+			if (!bridge.start()) {
+				return "Unable to start the fake bridge";
+			}
+
+			BridgeClient client(m_directory + "/bridge");
+			client.execute(echoRequest(0, 0));
+
+			bridge.stop();
+
+			try {
+				client.execute(echoRequest(0, 1), std::chrono::milliseconds(200));
+				return "A request succeeded although the bridge is gone";
+			} catch (const BridgeException &) {
+				// Expected
+			}
+
+			if (!bridge.start()) {
+				return "Unable to restart the fake bridge";
+			}
+
+			// Give the client's back-off after the failed attempt time to expire
+			std::this_thread::sleep_for(std::chrono::milliseconds(600));
+
+			return isEchoOf(client.execute(echoRequest(0, 2)), 0, 2) ? "" : "Wrong response after reconnecting";
+		}
+
+		std::string privateResponsePipe() {
+			FakeBridge bridge(bridgeOptions(false));
+			if (!bridge.start()) {
+				return "Unable to start the fake bridge";
+			}
+
+			std::string pipePath;
+			{
+				BridgeClient client(m_directory + "/bridge");
+				client.execute(echoRequest(0, 0));
+
+				const std::vector< std::string > pipes = bridge.clientPipes();
+				if (pipes.size() != 1) {
+					return "Expected exactly one registration";
+				}
+				pipePath = pipes.front();
+
+				const std::string directory = pipePath.substr(0, pipePath.rfind('/'));
+				struct stat info;
+				if (stat(directory.c_str(), &info) != 0 || !S_ISDIR(info.st_mode) || (info.st_mode & 0777) != 0700
+					|| info.st_uid != getuid()) {
+					return "The response pipe's directory " + directory + " isn't private";
+				}
+			}
+
+			struct stat info;
+			if (stat(pipePath.substr(0, pipePath.rfind('/')).c_str(), &info) == 0) {
+				return "The response pipe's directory is left behind after disconnecting";
+			}
+
+			return {};
+		}
+	};
+} // namespace
+
+int main(int argc, const char **argv) {
+	Options options;
+
+	try {
+		if (!parseOptions(argc, argv, options)) {
+			printUsage(argv[0]);
+			return 1;
+		}
+	} catch (const std::exception &e) {
+		std::cerr << "Invalid option value: " << e.what() << std::endl;
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	// Writing to the pipe of a client that has just gone away must not terminate us (see the plugin's main.cpp)
+	signal(SIGPIPE, SIG_IGN);
+
+	if (options.check) {
+		char directory[] = "/tmp/fake-bridge-check-XXXXXX";
+		if (!mkdtemp(directory)) {
+			std::cerr << "Unable to create a temporary directory: " << std::strerror(errno) << std::endl;
+			return 1;
+		}
+
+		const int result = Checks(directory).run();
+		rmdir(directory);
+
+		return result;
+	}
+
+	FakeBridge bridge(options);
+	if (!bridge.start()) {
+		return 1;
+	}
+
+	std::cout << "Listening on " << options.pipePath << " (press Enter to quit)" << std::endl;
+	std::cin.get();
+
+	return 0;
+}
@@ -0,0 +1,569 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+// A stand-in for the Stream Deck software. It accepts the plugin's websocket connection, checks its
+// registration and then plays a scripted scenario (devices connecting, buttons appearing, keys being
+// pressed) while measuring how long it takes for the plugin to react to each key press.
+
+#include "ESDSDKDefines.h"
+#include "LatencyStats.h"
+#include "MumbleActionIDs.h"
+#include "MumbleSettingIDs.h"
+
+#include <boost/asio/steady_timer.hpp>
+#include <boost/process.hpp>
+
+#include <websocketpp/config/asio_no_tls.hpp>
+#include <websocketpp/server.hpp>
+
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace Mumble::StreamDeckIntegration;
+
+namespace {
+	using Clock  = std::chrono::steady_clock;
+	using Server = websocketpp::server< websocketpp::config::asio >;
+
+	struct Options {
+		std::uint16_t port = 28196;
+		/// The plugin executable to launch (if empty, the plugin has to be started by hand)
+		std::string plugin;
+		std::string pluginUUID    = "0D1E2F3A4B5C6D7E8F901A2B3C4D5E6F";
+		std::string registerEvent = kESDSDKRegisterPlugin;
+		std::string action        = MUMBLE_STREAMDECK_TOGGLE_LOCAL_USER_MUTE_ACTION_UUID;
+		nlohmann::json settings   = nlohmann::json::object();
+		/// Handed to the plugin as its global CLI path setting
+		std::string cliPath;
+		unsigned int devices  = 1;
+		unsigned int contexts = 15;
+		unsigned int rounds   = 20;
+		unsigned int burst    = 1;
+		/// Milliseconds between rounds of key presses
+		unsigned int interval = 100;
+		/// Milliseconds between the buttons appearing and the first round
+		unsigned int settle = 500;
+		/// Milliseconds to wait for outstanding reactions at the end
+		unsigned int timeout = 5000;
+		bool sendToPlugin    = false;
+		/// Drop the connection after every this many rounds (0 = never)
+		unsigned int disconnectEvery = 0;
+		/// Send systemDidWakeUp after every reconnect
+		bool wakeUp = false;
+	};
+
+	void printUsage(const char *executable) {
+		std::cerr << "Usage: " << executable << " [options]\n"
+				  << "  --port <port>             Port to listen on (default: 28196)\n"
+				  << "  --plugin <path>           Plugin executable to launch (otherwise wait for it to connect)\n"
+				  << "  --plugin-uuid <uuid>      UUID the plugin has to register with\n"
+				  << "  --action <uuid>           Action of the simulated buttons (default: toggle mute)\n"
+				  << "  --settings <json>         Settings of the simulated buttons (default: {})\n"
+				  << "  --cli-path <path>         Global CLI path setting handed to the plugin\n"
+				  << "  --devices <n>             Number of simulated devices (default: 1)\n"
+				  << "  --contexts <n>            Buttons per device (default: 15)\n"
+				  << "  --rounds <n>              Number of rounds of key presses (default: 20)\n"
+				  << "  --burst <n>               Presses per button and round, i.e. key mashing (default: 1)\n"
+				  << "  --interval <ms>           Time between rounds (default: 100)\n"
+				  << "  --settle <ms>             Time between buttons appearing and the first round (default: 500)\n"
+				  << "  --timeout <ms>            Time to wait for outstanding reactions at the end (default: 5000)\n"
+				  << "  --send-to-plugin          Also send a settings change for every button in every round\n"
+				  << "  --disconnect-every <n>    Drop the connection after every n rounds and wait for the plugin\n"
+				  << "                            to reconnect (within --timeout)\n"
+				  << "  --wake-up                 Send systemDidWakeUp after every reconnect\n";
+	}
+
+	bool parseOptions(int argc, const char **argv, Options &options) {
+		for (int i = 1; i < argc; ++i) {
+			const std::string name = argv[i];
+
+			if (name == "--help") {
+				return false;
+			} else if (name == "--send-to-plugin") {
+				options.sendToPlugin = true;
+				continue;
+			} else if (name == "--wake-up") {
+				options.wakeUp = true;
+				continue;
+			}
+
+			if (i + 1 >= argc) {
+				std::cerr << "Missing value for " << name << std::endl;
+				return false;
+			}
+
+			const std::string value = argv[++i];
+
+			if (name == "--port") {
+				options.port = static_cast< std::uint16_t >(std::stoul(value));
+			} else if (name == "--plugin") {
+				options.plugin = value;
+			} else if (name == "--plugin-uuid") {
+				options.pluginUUID = value;
+			} else if (name == "--action") {
+				options.action = value;
+			} else if (name == "--settings") {
+				options.settings = nlohmann::json::parse(value);
+			} else if (name == "--cli-path") {
+				options.cliPath = value;
+			} else if (name == "--devices") {
+				options.devices = std::stoul(value);
+			} else if (name == "--contexts") {
+				options.contexts = std::stoul(value);
+			} else if (name == "--rounds") {
+				options.rounds = std::stoul(value);
+			} else if (name == "--burst") {
+				options.burst = std::stoul(value);
+			} else if (name == "--interval") {
+				options.interval = std::stoul(value);
+			} else if (name == "--settle") {
+				options.settle = std::stoul(value);
+			} else if (name == "--timeout") {
+				options.timeout = std::stoul(value);
+			} else if (name == "--disconnect-every") {
+				options.disconnectEvery = std::stoul(value);
+			} else {
+				std::cerr << "Unknown option " << name << std::endl;
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	/**
+	 * @returns A Stream Deck style ID (32 hex digits) that is unique for the given numbers
+	 */
+	std::string makeID(unsigned int kind, unsigned int index) {
+		char buffer[33];
+		std::snprintf(buffer, sizeof(buffer), "%08X%08X%016X", kind, index, 0x5D0C4u);
+
+		return buffer;
+	}
+
+	class MockStreamDeck {
+	public:
+		explicit MockStreamDeck(const Options &options) : m_options(options) {
+			m_server.clear_access_channels(websocketpp::log::alevel::all);
+			m_server.clear_error_channels(websocketpp::log::elevel::all);
+
+			m_server.init_asio(&m_ioService);
+			m_server.set_reuse_addr(true);
+
+			m_server.set_open_handler([this](websocketpp::connection_hdl hdl) { onOpen(hdl); });
+			m_server.set_close_handler([this](websocketpp::connection_hdl hdl) { onClose(hdl); });
+			m_server.set_message_handler(
+				[this](websocketpp::connection_hdl hdl, Server::message_ptr msg) { onMessage(hdl, msg); });
+
+			for (unsigned int device = 0; device < m_options.devices; ++device) {
+				m_devices.push_back(makeID(1, device));
+
+				for (unsigned int context = 0; context < m_options.contexts; ++context) {
+					Button button;
+					button.context = makeID(2, device * m_options.contexts + context);
+					button.device  = m_devices.back();
+					button.column  = context % 5;
+					button.row     = context / 5;
+
+					m_buttonIndices[button.context] = m_buttons.size();
+					m_buttons.push_back(std::move(button));
+				}
+			}
+		}
+
+		int run() {
+			websocketpp::lib::error_code ec;
+			m_server.listen(m_options.port, ec);
+			if (ec) {
+				std::cerr << "Failed to listen on port " << m_options.port << ": " << ec.message() << std::endl;
+				return 1;
+			}
+			m_server.start_accept();
+
+			std::unique_ptr< boost::process::child > plugin;
+			if (!m_options.plugin.empty()) {
+				const nlohmann::json info = {
+					{ kESDSDKApplicationInfo,
+					  { { kESDSDKApplicationInfoPlatform, kESDSDKApplicationInfoPlatformWindows },
+						{ kESDSDKApplicationInfoVersion, "5.0.0" },
+						{ kESDSDKApplicationInfoLanguage, "en" } } },
+					{ kESDSDKDevicesInfo, nlohmann::json::array() }
+				};
+
+				plugin = std::make_unique< boost::process::child >(
+					m_options.plugin, kESDSDKPortParameter, std::to_string(m_options.port), kESDSDKPluginUUIDParameter,
+					m_options.pluginUUID, kESDSDKRegisterEventParameter, m_options.registerEvent, kESDSDKInfoParameter,
+					info.dump());
+			} else {
+				std::cout << "Waiting for the plugin to connect to port " << m_options.port << std::endl;
+			}
+
+			m_ioService.run();
+
+			if (plugin) {
+				// The plugin exits once its connection has been closed
+				plugin->wait();
+			}
+
+			report();
+
+			return m_failed ? 1 : 0;
+		}
+
+	private:
+		struct Button {
+			std::string context;
+			std::string device;
+			unsigned int column = 0;
+			unsigned int row    = 0;
+			/// The points in time at which presses have been sent that the plugin hasn't reacted to yet
+			std::deque< Clock::time_point > pendingPresses;
+		};
+
+		Options m_options;
+		boost::asio::io_service m_ioService;
+		Server m_server;
+		websocketpp::connection_hdl m_connection;
+		bool m_connected  = false;
+		bool m_registered = false;
+		bool m_failed     = false;
+		bool m_finishing  = false;
+		/// Whether the connection has been dropped on purpose and the plugin is expected to reconnect
+		bool m_awaitingReconnect = false;
+		Clock::time_point m_disconnectedAt;
+
+		std::vector< std::string > m_devices;
+		std::vector< Button > m_buttons;
+		std::unordered_map< std::string, std::size_t > m_buttonIndices;
+
+		std::unique_ptr< boost::asio::steady_timer > m_timer;
+		unsigned int m_round = 0;
+
+		std::size_t m_pressCount   = 0;
+		std::size_t m_pendingCount = 0;
+		std::map< std::string, std::size_t > m_receivedEvents;
+		LatencyStats m_latency;
+		std::map< std::string, LatencyStats > m_latencyByReaction;
+
+		std::size_t m_reconnectCount = 0;
+		LatencyStats m_recovery;
+		/// Messages received after a reconnect (before the next round started), i.e. what the plugin has replayed
+		std::size_t m_resentCount = 0;
+		bool m_countingResent     = false;
+
+		void onOpen(websocketpp::connection_hdl hdl) {
+			if (m_connected) {
+				websocketpp::lib::error_code ec;
+				m_server.close(hdl, websocketpp::close::status::normal, "Only one plugin is supported", ec);
+				return;
+			}
+
+			m_connection = hdl;
+			m_connected  = true;
+		}
+
+		void onClose(websocketpp::connection_hdl hdl) {
+			if (m_connection.lock() != hdl.lock()) {
+				return;
+			}
+
+			if (m_awaitingReconnect) {
+				// We closed the connection ourselves
+				return;
+			}
+
+			if (!m_finishing) {
+				std::cerr << "The plugin closed the connection prematurely" << std::endl;
+				m_failed = true;
+			}
+
+			stop();
+		}
+
+		void onMessage(websocketpp::connection_hdl, Server::message_ptr msg) {
+			const Clock::time_point now = Clock::now();
+
+			nlohmann::json message;
+			try {
+				message = nlohmann::json::parse(msg->get_payload());
+			} catch (const nlohmann::json::parse_error &e) {
+				std::cerr << "Received malformed message: " << e.what() << std::endl;
+				m_failed = true;
+				return;
+			}
+
+			const std::string event = message.value(kESDSDKCommonEvent, "");
+
+			if (!m_registered) {
+				if (event != m_options.registerEvent
+					|| message.value(kESDSDKRegisterUUID, "") != m_options.pluginUUID) {
+					std::cerr << "Expected registration, got: " << msg->get_payload() << std::endl;
+					m_failed = true;
+					stop();
+					return;
+				}
+
+				m_registered = true;
+				if (m_awaitingReconnect) {
+					resumeScenario();
+				} else {
+					startScenario();
+				}
+				return;
+			}
+
+			m_receivedEvents[event]++;
+			if (m_countingResent) {
+				m_resentCount++;
+			}
+
+			if (event == kESDSDKEventGetGlobalSettings) {
+				send({ { kESDSDKCommonEvent, kESDSDKEventDidReceiveGlobalSettings },
+					   { kESDSDKCommonPayload,
+						 { { kESDSDKPayloadSettings,
+							 { { MUMBLE_STREAMDECK_GLOBAL_CLI_PATH_SETTING, m_options.cliPath } } } } } });
+			} else if (event == kESDSDKEventLogMessage) {
+				std::cout << "[plugin] "
+						  << message[kESDSDKCommonPayload].value(kESDSDKPayloadMessage, std::string()) << std::endl;
+			} else if (event == kESDSDKEventSetTitle || event == kESDSDKEventSetState || event == kESDSDKEventShowAlert
+					   || event == kESDSDKEventShowOK) {
+				auto it = m_buttonIndices.find(message.value(kESDSDKCommonContext, ""));
+				if (it == m_buttonIndices.end()) {
+					return;
+				}
+
+				// A single reaction may cover several presses as the plugin coalesces updates
+				Button &button = m_buttons[it->second];
+				while (!button.pendingPresses.empty()) {
+					const std::chrono::nanoseconds latency = now - button.pendingPresses.front();
+					button.pendingPresses.pop_front();
+					m_pendingCount--;
+
+					m_latency.add(latency);
+					m_latencyByReaction[event].add(latency);
+				}
+
+				if (m_finishing && m_pendingCount == 0) {
+					finish();
+				}
+			}
+		}
+
+		void send(const nlohmann::json &message) {
+			websocketpp::lib::error_code ec;
+			m_server.send(m_connection, message.dump(), websocketpp::frame::opcode::text, ec);
+
+			if (ec) {
+				std::cerr << "Failed to send message: " << ec.message() << std::endl;
+				m_failed = true;
+			}
+		}
+
+		nlohmann::json buttonEvent(const char *event, const Button &button, nlohmann::json payload) const {
+			payload[kESDSDKPayloadSettings]    = m_options.settings;
+			payload[kESDSDKPayloadCoordinates] = { { kESDSDKPayloadCoordinatesColumn, button.column },
+												   { kESDSDKPayloadCoordinatesRow, button.row } };
+			payload[kESDSDKPayloadIsInMultiAction] = false;
+
+			return { { kESDSDKCommonAction, m_options.action },
+					 { kESDSDKCommonEvent, event },
+					 { kESDSDKCommonContext, button.context },
+					 { kESDSDKCommonDevice, button.device },
+					 { kESDSDKCommonPayload, std::move(payload) } };
+		}
+
+		void startScenario() {
+			for (const std::string &device : m_devices) {
+				send({ { kESDSDKCommonEvent, kESDSDKEventDeviceDidConnect },
+					   { kESDSDKCommonDevice, device },
+					   { kESDSDKCommonDeviceInfo,
+						 { { kESDSDKDeviceInfoName, "Mock Stream Deck" },
+						   { kESDSDKDeviceInfoType, 0 },
+						   { kESDSDKDeviceInfoSize,
+							 { { kESDSDKDeviceInfoSizeColumns, 5 },
+							   { kESDSDKDeviceInfoSizeRows, (m_options.contexts + 4) / 5 } } } } } });
+			}
+
+			for (const Button &button : m_buttons) {
+				send(buttonEvent(kESDSDKEventWillAppear, button, { { kESDSDKPayloadState, 0 } }));
+			}
+
+			std::cout << "Plugin registered; " << m_buttons.size() << " buttons on " << m_devices.size()
+					  << " devices appeared" << std::endl;
+
+			m_timer = std::make_unique< boost::asio::steady_timer >(m_ioService);
+			schedule(std::chrono::milliseconds(m_options.settle), [this]() { playRound(); });
+		}
+
+		template< typename Handler > void schedule(std::chrono::milliseconds delay, Handler handler) {
+			m_timer->expires_after(delay);
+			m_timer->async_wait([handler](const boost::system::error_code &ec) {
+				if (!ec) {
+					handler();
+				}
+			});
+		}
+
+		void playRound() {
+			for (Button &button : m_buttons) {
+				for (unsigned int i = 0; i < m_options.burst; ++i) {
+					button.pendingPresses.push_back(Clock::now());
+					m_pressCount++;
+					m_pendingCount++;
+
+					send(buttonEvent(kESDSDKEventKeyDown, button,
+									 { { kESDSDKPayloadState, 0 }, { kESDSDKPayloadUserDesiredState, 1 } }));
+					send(buttonEvent(kESDSDKEventKeyUp, button, { { kESDSDKPayloadState, 1 } }));
+				}
+
+				if (m_options.sendToPlugin) {
+					send({ { kESDSDKCommonAction, m_options.action },
+						   { kESDSDKCommonEvent, kESDSDKEventSendToPlugin },
+						   { kESDSDKCommonContext, button.context },
+						   { kESDSDKCommonPayload, { { "settingsDelta", m_options.settings } } } });
+				}
+			}
+
+			if (++m_round < m_options.rounds) {
+				if (m_options.disconnectEvery > 0 && m_round % m_options.disconnectEvery == 0) {
+					// Let the plugin process the presses before pulling the plug on it
+					schedule(std::chrono::milliseconds(m_options.interval), [this]() { disconnect(); });
+				} else {
+					schedule(std::chrono::milliseconds(m_options.interval), [this]() { playRound(); });
+				}
+				return;
+			}
+
+			// Give the plugin some time to react to the last presses
+			m_finishing = true;
+			if (m_pendingCount == 0) {
+				finish();
+			} else {
+				schedule(std::chrono::milliseconds(m_options.timeout), [this]() { finish(); });
+			}
+		}
+
+		/**
+		 * Drops the connection in a way that makes the plugin reconnect (as when the Stream Deck software
+		 * restarts its websocket server)
+		 */
+		void disconnect() {
+			m_countingResent    = false;
+			m_awaitingReconnect = true;
+			m_connected         = false;
+			m_registered        = false;
+			m_disconnectedAt    = Clock::now();
+
+			websocketpp::lib::error_code ec;
+			m_server.close(m_connection, websocketpp::close::status::service_restart, "Restarting", ec);
+
+			schedule(std::chrono::milliseconds(m_options.timeout), [this]() {
+				std::cerr << "The plugin didn't reconnect" << std::endl;
+				m_failed = true;
+				stop();
+			});
+		}
+
+		void resumeScenario() {
+			m_awaitingReconnect = false;
+			m_reconnectCount++;
+			m_recovery.add(Clock::now() - m_disconnectedAt);
+
+			// The buttons are still there, so unlike on the initial connection, they don't appear again. It's up
+			// to the plugin to bring them up to date.
+			m_countingResent = true;
+			if (m_options.wakeUp) {
+				send({ { kESDSDKCommonEvent, kESDSDKEventSystemDidWakeUp } });
+			}
+
+			schedule(std::chrono::milliseconds(m_options.interval), [this]() {
+				m_countingResent = false;
+				playRound();
+			});
+		}
+
+		void finish() {
+			if (m_timer) {
+				m_timer->cancel();
+			}
+
+			for (const Button &button : m_buttons) {
+				send(buttonEvent(kESDSDKEventWillDisappear, button, { { kESDSDKPayloadState, 0 } }));
+			}
+
+			// Closing the connection makes the plugin exit
+			websocketpp::lib::error_code ec;
+			m_server.close(m_connection, websocketpp::close::status::going_away, "Done", ec);
+			stop();
+		}
+
+		void stop() {
+			websocketpp::lib::error_code ec;
+			m_server.stop_listening(ec);
+
+			// Give the close handshake a moment before stopping for good
+			if (!m_timer) {
+				m_timer = std::make_unique< boost::asio::steady_timer >(m_ioService);
+			}
+			schedule(std::chrono::milliseconds(200), [this]() { m_ioService.stop(); });
+		}
+
+		void report() const {
+			std::cout << std::endl
+					  << "Presses: " << m_pressCount << ", answered: " << m_pressCount - m_pendingCount
+					  << ", unanswered: " << m_pendingCount << std::endl;
+
+			std::cout << "Received events:";
+			for (const auto &current : m_receivedEvents) {
+				std::cout << " " << current.first << "=" << current.second;
+			}
+			std::cout << std::endl << std::endl;
+
+			LatencyStats::printHeader(std::cout);
+			m_latency.print(std::cout, "keyDown -> any reaction");
+			for (const auto &current : m_latencyByReaction) {
+				current.second.print(std::cout, "keyDown -> " + current.first);
+			}
+
+			if (m_options.disconnectEvery > 0) {
+				m_recovery.print(std::cout, "disconnect -> registered");
+
+				std::cout << std::endl
+						  << "Reconnects: " << m_reconnectCount << ", messages received right after reconnecting: "
+						  << m_resentCount << std::endl;
+			}
+		}
+	};
+} // namespace
+
+int main(int argc, const char **argv) {
+	Options options;
+
+	try {
+		if (!parseOptions(argc, argv, options)) {
+			printUsage(argv[0]);
+			return 1;
+		}
+	} catch (const std::exception &e) {
+		std::cerr << "Invalid option value: " << e.what() << std::endl;
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	MockStreamDeck streamDeck(options);
+
+	return streamDeck.run();
+}
@@ -0,0 +1,221 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+// Checks parts of the plugin that work without the Stream Deck software and without Mumble. Exits with 1 if
+// any check fails.
+
+#include "ActionExecutor.h"
+#include "CheckRunner.h"
+#include "InboundMessage.h"
+#include "MessageWriter.h"
+#include "QueryBackoff.h"
+
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Mumble::StreamDeckIntegration;
+
+namespace {
+	/**
+	 * Records the order in which jobs have run
+	 */
+	class JobLog {
+	public:
+		void add(int job) {
+			std::lock_guard< std::mutex > guard(m_mutex);
+			m_jobs.push_back(job);
+		}
+
+		std::string check(const std::vector< int > &expected) const {
+			std::lock_guard< std::mutex > guard(m_mutex);
+			if (m_jobs == expected) {
+				return {};
+			}
+
+			std::string order;
+			for (int job : m_jobs) {
+				order += (order.empty() ? "" : ", ") + std::to_string(job);
+			}
+
+			return "The jobs ran in the order " + order;
+		}
+
+	private:
+		mutable std::mutex m_mutex;
+		std::vector< int > m_jobs;
+	};
+
+	std::string releasedKeyKeepsOrder() {
+		ActionExecutor executor([](const std::string &) {});
+		JobLog log;
+
+		std::promise< void > unblock;
+		std::shared_future< void > blocked = unblock.get_future().share();
+
+		executor.execute(1, [&]() {
+			blocked.wait();
+			log.add(1);
+		});
+		executor.execute(1, [&]() { log.add(2); });
+		// As when a button disappears while its jobs are still queued and then reappears right away
+		executor.release(1);
+		executor.execute(1, [&]() { log.add(3); });
+
+		// Give the last job the chance to overtake the others (which it mustn't)
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		unblock.set_value();
+		executor.shutdown();
+
+		return log.check({ 1, 2, 3 });
+	}
+
+	std::string failingJobIsReported() {
+		std::mutex errorMutex;
+		std::vector< std::string > errors;
+
+		ActionExecutor executor([&](const std::string &error) {
+			std::lock_guard< std::mutex > guard(errorMutex);
+			errors.push_back(error);
+		});
+		JobLog log;
+
+		executor.execute(1, []() { throw std::runtime_error("Failing on purpose"); });
+		executor.execute(1, [&]() { log.add(1); });
+		executor.execute(1, []() { throw 42; });
+		executor.release(1);
+		executor.execute(1, [&]() { log.add(2); });
+		executor.shutdown();
+
+		if (errors != std::vector< std::string >{ "Failing on purpose", "Unknown error" }) {
+			return "The failures haven't been reported as expected";
+		}
+
+		return log.check({ 1, 2 });
+	}
+
+	std::string malformedMessagesAreRejected() {
+		const char *malformed[] = {
+			// Members without a value
+			R"({"event": })",
+			R"({"event":,})",
+			R"({"event":,"context":"ABC"})",
+			// Broken syntax
+			R"({"event":"keyDown",})",
+			R"({"event" "keyDown"})",
+			// Truncated
+			R"({"event":"keyDown")",
+			R"({"event":"key)",
+			// Not an object
+			R"(["keyDown"])",
+			"",
+		};
+
+		for (const char *message : malformed) {
+			// Copied, so that reading past the end of the message is caught by ASan builds
+			const std::string buffer(message);
+
+			try {
+				InboundMessage parsed(buffer);
+
+				return std::string("Accepted ") + message;
+			} catch (const InboundMessageException &) {
+				// Expected
+			}
+		}
+
+		const std::string valid = R"({"event":"keyDown","context":"A\"B","payload":{"settings":{}}})";
+		InboundMessage parsed(valid);
+		if (parsed.event() != "keyDown" || parsed.context() != "A\"B" || !parsed.payload().get().is_object()) {
+			return "A valid message isn't parsed correctly";
+		}
+
+		return {};
+	}
+
+	std::string stringsAreEscapedLikeNlohmannJSON() {
+		std::vector< std::string > strings = {
+			"plain",
+			"quote \" backslash \\ controls \b\f\n\r\t\x01\x1f",
+			std::string("nul \0 byte", 10),
+			"valid: \xC3\xA4 \xE2\x82\xAC \xF0\x9F\x8E\xA4",
+			"overlong: \xC0\xAF \xE0\x80\xAF",
+			"surrogate: \xED\xA0\x80",
+			"too large: \xF4\x90\x80\x80 \xF5\x80",
+			"stray continuation: \x80\xBF",
+			"truncated: \xE2\x82",
+			"truncated at the end: \xF0\x9F\x8E",
+		};
+
+		// Random strings that are mostly made up of non-ASCII bytes
+		std::mt19937 random(42);
+		std::uniform_int_distribution< int > length(0, 12);
+		std::uniform_int_distribution< int > byte(0x70, 0xFF);
+		for (int i = 0; i < 20000; ++i) {
+			std::string str(static_cast< std::size_t >(length(random)), ' ');
+			for (char &c : str) {
+				c = static_cast< char >(byte(random));
+			}
+			strings.push_back(std::move(str));
+		}
+
+		for (const std::string &str : strings) {
+			std::string written;
+			MessageWriter::appendString(written, str);
+
+			const std::string expected =
+				nlohmann::json(str).dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+
+			if (written != expected) {
+				return "Wrote " + written + " instead of " + expected;
+			}
+		}
+
+		return {};
+	}
+
+	std::string rejectedQueryIsSuspended() {
+		QueryBackoff backoff;
+		const QueryBackoff::Clock::time_point start;
+
+		if (!backoff.failed(start) || backoff.failed(start + std::chrono::seconds(10))) {
+			return "Only the first error in a row should be worth reporting";
+		}
+		// Suspended for 10 s after the first error and for 20 s after the second one
+		if (backoff.mayQuery(start + std::chrono::seconds(29))
+			|| !backoff.mayQuery(start + std::chrono::seconds(30))) {
+			return "The suspension doesn't grow";
+		}
+
+		for (int i = 0; i < 20; ++i) {
+			backoff.failed(start);
+		}
+		if (!backoff.mayQuery(start + std::chrono::minutes(5))) {
+			return "The suspension isn't limited";
+		}
+
+		backoff.succeeded();
+
+		return backoff.mayQuery(start) ? "" : "A success doesn't end the suspension";
+	}
+} // namespace
+
+int main() {
+	CheckRunner runner;
+
+	runner.run("a released key's queued jobs keep their order", releasedKeyKeepsOrder);
+	runner.run("a failing job is reported and its key carries on", failingJobIsReported);
+	runner.run("malformed Stream Deck messages are rejected", malformedMessagesAreRejected);
+	runner.run("strings are escaped like nlohmann::json does (replacing invalid UTF-8)",
+			   stringsAreEscapedLikeNlohmannJSON);
+	runner.run("a query rejected by the bridge is suspended for longer and longer", rejectedQueryIsSuspended);
+
+	return runner.finish();
+}
@@ -0,0 +1,146 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+// A stand-in for the JSON bridge's CLI (mumble_json_bridge_cli) that answers with canned responses
+// instead of talking to Mumble. As the plugin invokes the CLI as "<cli> --json <request>", the stub's
+// behavior is configured through environment variables (which the plugin passes on to it):
+//
+// STUB_BRIDGE_DELAY_MS      Time to wait before answering (default: 0)
+// STUB_BRIDGE_EXIT_CODE     The exit code to use (default: 0)
+// STUB_BRIDGE_STDERR_BYTES  Amount of (junk) output to write to stderr (default: 0)
+// STUB_BRIDGE_OUTPUT        "valid" (default), "malformed" (truncated JSON) or "empty"
+// STUB_BRIDGE_STATE_FILE    File to keep the local user's state in across invocations (default: none,
+//                           i.e. the state never changes). Its "channel_users" object holds the number of
+//                           other users in every channel that exists.
+
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace {
+	std::string getEnv(const char *name, const std::string &defaultValue = "") {
+		const char *value = std::getenv(name);
+
+		return value ? value : defaultValue;
+	}
+
+	unsigned long getEnvNumber(const char *name) { return std::stoul(getEnv(name, "0")); }
+
+	nlohmann::json loadState(const std::string &stateFile) {
+		nlohmann::json state = { { "muted", false },
+								 { "deafened", false },
+								 { "channel", "Root" },
+								 { "channel_users", { { "Root", 0 } } } };
+
+		if (!stateFile.empty()) {
+			std::ifstream stream(stateFile);
+			if (stream) {
+				try {
+					state.update(nlohmann::json::parse(stream));
+				} catch (const nlohmann::json::parse_error &) {
+					// Start over
+				}
+			}
+		}
+
+		return state;
+	}
+
+	void storeState(const std::string &stateFile, const nlohmann::json &state) {
+		if (!stateFile.empty()) {
+			std::ofstream(stateFile) << state.dump();
+		}
+	}
+
+	nlohmann::json answer(const nlohmann::json &request) {
+		const std::string stateFile = getEnv("STUB_BRIDGE_STATE_FILE");
+		const std::string operation = request.at("message").at("operation").get< std::string >();
+
+		nlohmann::json state = loadState(stateFile);
+
+		if (operation == "get_local_user_state") {
+			nlohmann::json localUser = state;
+			localUser.erase("channel_users");
+
+			return { { "response_type", "local_user_state" }, { "response", localUser } };
+		}
+
+		if (operation == "get_channel_user_counts") {
+			const nlohmann::json &otherUsers = state["channel_users"];
+
+			nlohmann::json counts = nlohmann::json::object();
+			for (const nlohmann::json &channel : request["message"]["parameter"]["channels"]) {
+				const std::string name = channel.get< std::string >();
+				const bool isLocal     = name == state["channel"].get< std::string >();
+
+				if (otherUsers.contains(name) || isLocal) {
+					counts[name] = otherUsers.value(name, 0) + (isLocal ? 1 : 0);
+				}
+			}
+
+			return { { "response_type", "channel_user_counts" }, { "response", { { "channels", counts } } } };
+		}
+
+		if (operation == "toggle_local_user_mute") {
+			state["muted"] = !state["muted"].get< bool >();
+			if (!state["muted"].get< bool >()) {
+				// Unmuting also undeafens (as in Mumble)
+				state["deafened"] = false;
+			}
+		} else if (operation == "toggle_local_user_deaf") {
+			state["deafened"] = !state["deafened"].get< bool >();
+			state["muted"]    = state["deafened"].get< bool >() || state["muted"].get< bool >();
+		} else if (operation == "move_local_user") {
+			state["channel"] = request["message"]["parameter"].value("channel", "");
+		} else if (operation == "request_microphone_activation_overwrite") {
+			// Doesn't change any state that could be queried
+		} else {
+			return { { "response_type", "error" },
+					 { "response", { { "error_message", "Unknown operation \"" + operation + "\"" } } } };
+		}
+
+		storeState(stateFile, state);
+
+		return { { "response_type", "operation_result" }, { "response", { { "success", true } } } };
+	}
+} // namespace
+
+int main(int argc, const char **argv) {
+	if (argc != 3 || std::string(argv[1]) != "--json") {
+		std::cerr << "Usage: " << argv[0] << " --json <request>" << std::endl;
+		return 1;
+	}
+
+	try {
+		std::this_thread::sleep_for(std::chrono::milliseconds(getEnvNumber("STUB_BRIDGE_DELAY_MS")));
+
+		const std::string output = getEnv("STUB_BRIDGE_OUTPUT", "valid");
+		if (output == "valid") {
+			std::cout << answer(nlohmann::json::parse(argv[2])).dump() << std::endl;
+		} else if (output == "malformed") {
+			std::cout << R"({"response_type":"operation_result","response":{"succ)" << std::endl;
+		}
+
+		const unsigned long stderrBytes = getEnvNumber("STUB_BRIDGE_STDERR_BYTES");
+		if (stderrBytes > 0) {
+			// Lines of 64 characters (including the newline)
+			const std::string line(63, 'E');
+			for (unsigned long written = 0; written < stderrBytes; written += line.size() + 1) {
+				std::cerr << line << '\n';
+			}
+			std::cerr.flush();
+		}
+
+		return static_cast< int >(getEnvNumber("STUB_BRIDGE_EXIT_CODE"));
+	} catch (const std::exception &e) {
+		std::cerr << "Stub bridge CLI failed: " << e.what() << std::endl;
+		return 1;
+	}
+}
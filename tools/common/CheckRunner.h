@@ -0,0 +1,59 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#ifndef MUMBLE_STREAMDECK_INTEGRATION_TOOLS_CHECKRUNNER_H_
+#define MUMBLE_STREAMDECK_INTEGRATION_TOOLS_CHECKRUNNER_H_
+
+#include <exception>
+#include <iostream>
+#include <string>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	/**
+	 * Runs named checks and reports whether they have passed
+	 */
+	class CheckRunner {
+	public:
+		/**
+		 * Runs the given check, which returns why it has failed (or an empty string if it has passed). An
+		 * exception thrown by the check counts as a failure.
+		 */
+		template< typename Check > void run(const std::string &name, Check check) {
+			std::string failure;
+			try {
+				failure = check();
+			} catch (const std::exception &e) {
+				failure = e.what();
+			}
+
+			if (failure.empty()) {
+				std::cout << "[PASS] " << name << std::endl;
+			} else {
+				std::cout << "[FAIL] " << name << ": " << failure << std::endl;
+				m_failures++;
+			}
+		}
+
+		/**
+		 * Reports the overall result
+		 *
+		 * @returns The exit code to use (1 if any check has failed)
+		 */
+		int finish() const {
+			std::cout << (m_failures == 0 ? "All checks passed" : std::to_string(m_failures) + " check(s) failed")
+					  << std::endl;
+
+			return m_failures == 0 ? 0 : 1;
+		}
+
+	private:
+		unsigned int m_failures = 0;
+	};
+
+};     // namespace StreamDeckIntegration
+};     // namespace Mumble
+#endif // MUMBLE_STREAMDECK_INTEGRATION_TOOLS_CHECKRUNNER_H_
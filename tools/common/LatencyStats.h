@@ -0,0 +1,77 @@
+// Copyright 2021 The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// source tree.
+
+#ifndef MUMBLE_STREAMDECK_INTEGRATION_TOOLS_LATENCYSTATS_H_
+#define MUMBLE_STREAMDECK_INTEGRATION_TOOLS_LATENCYSTATS_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Mumble {
+namespace StreamDeckIntegration {
+
+	/**
+	 * Collects latency samples and reports their distribution
+	 */
+	class LatencyStats {
+	public:
+		void add(std::chrono::nanoseconds latency) {
+			m_samples.push_back(latency.count());
+			m_sorted = false;
+		}
+
+		std::size_t count() const { return m_samples.size(); }
+
+		/**
+		 * @param percentile The percentile to compute (0 - 100)
+		 * @returns The latency below which the given percentage of samples lie
+		 */
+		std::chrono::nanoseconds percentile(double percentile) const {
+			if (m_samples.empty()) {
+				return std::chrono::nanoseconds(0);
+			}
+
+			if (!m_sorted) {
+				std::sort(m_samples.begin(), m_samples.end());
+				m_sorted = true;
+			}
+
+			const std::size_t index =
+				std::min(m_samples.size() - 1, static_cast< std::size_t >(percentile / 100 * m_samples.size()));
+
+			return std::chrono::nanoseconds(m_samples[index]);
+		}
+
+		static void printHeader(std::ostream &stream) {
+			stream << std::left << std::setw(32) << "" << std::right << std::setw(10) << "count" << std::setw(12)
+				   << "p50 us" << std::setw(12) << "p90 us" << std::setw(12) << "p99 us" << std::setw(12) << "max us"
+				   << std::endl;
+		}
+
+		void print(std::ostream &stream, const std::string &name) const {
+			stream << std::left << std::setw(32) << name << std::right << std::setw(10) << count() << std::fixed
+				   << std::setprecision(1) << std::setw(12) << toMicroseconds(percentile(50)) << std::setw(12)
+				   << toMicroseconds(percentile(90)) << std::setw(12) << toMicroseconds(percentile(99))
+				   << std::setw(12) << toMicroseconds(percentile(100)) << std::endl;
+		}
+
+	private:
+		mutable std::vector< std::int64_t > m_samples;
+		mutable bool m_sorted = true;
+
+		static double toMicroseconds(std::chrono::nanoseconds duration) {
+			return std::chrono::duration< double, std::micro >(duration).count();
+		}
+	};
+
+};     // namespace StreamDeckIntegration
+};     // namespace Mumble
+#endif // MUMBLE_STREAMDECK_INTEGRATION_TOOLS_LATENCYSTATS_H_